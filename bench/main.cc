@@ -0,0 +1,703 @@
+/**
+ * @file main.cc
+ * @brief An open-loop load generator built on the Muelsyse plugin.
+ *
+ * Every function listed in the configuration file is driven at a fixed
+ * request rate, once per call style, and the throughput and latency
+ * percentiles of each style are reported.
+ *
+ * Usage:
+ *
+ *     MuelsyseBench [config.yaml] [--rate 1000] [--duration 10] [--loops 4]
+ *                   [--workers 64] [--style sync,callback,future]
+ *                   [--function name] [--args '["_", 1]'] [--void]
+ *     MuelsyseBench [config.yaml] --routes 50000
+ *
+ * Functions whose url starts with `inproc://bench` are answered in process,
+ * their numbers are the overhead of the plugin alone. `inproc://bench/users`
+ * returns a large list, to compare the JSON parsers of the plugin.
+ *
+ * With --routes, nothing is sent: a function_list of that many generated
+ * functions is loaded instead, and the time it takes, the memory it uses and
+ * the cost of preparing a call are reported.
+ *
+ * Command line options override the `custom_config.bench` section of the
+ * configuration file.
+ */
+
+#include <drogon/drogon.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "../src/Muelsyse.h"
+
+using namespace drogon;
+using namespace std::chrono;
+using namespace tl::rest;
+
+namespace
+{
+
+struct BenchCall
+{
+    std::string function;
+    std::vector<Argument> args;
+    bool isVoid{false};
+};
+
+struct BenchOptions
+{
+    double rate{1000};
+    double duration{10};
+    size_t loops{4};
+    /// Threads that make the sync and future calls, so many of them can be
+    /// in flight at once.
+    size_t workers{64};
+    std::vector<std::string> styles{"sync", "callback", "future"};
+    std::vector<BenchCall> calls;
+    /// Measure a function table of this size instead, if not 0.
+    size_t routes{0};
+};
+
+/**
+ * @brief The shared state of one run.
+ *
+ * Callbacks may outlive the run when the upstream is too slow to drain, so
+ * the state is reference counted instead of living on the stack.
+ */
+struct RunState
+{
+    RunState(size_t total, double rate)
+        : total(total),
+          interval(1e9 / rate),
+          start(steady_clock::now() + milliseconds(100)),
+          latencies(total, -1)
+    {
+    }
+
+    /// The moment the i-th request is scheduled to be sent.
+    steady_clock::time_point intendedTime(size_t i) const
+    {
+        return start + duration_cast<steady_clock::duration>(interval * i);
+    }
+
+    /// Latency is measured from the intended send time rather than the actual
+    /// one, so a stalled upstream shows up in the percentiles instead of
+    /// silently lowering the offered load (coordinated omission).
+    void record(size_t i, bool ok)
+    {
+        auto latency =
+            duration_cast<microseconds>(steady_clock::now() - intendedTime(i))
+                .count();
+        std::lock_guard<std::mutex> lock(mutex);
+        // Too late for the report, which is being read
+        if (closed)
+        {
+            return;
+        }
+        latencies[i] = latency;
+        if (!ok)
+        {
+            ++errors;
+        }
+        ++completed;
+    }
+
+    /// Stop recording, the results can be read once this returns.
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+
+    const size_t total;
+    const duration<double, std::nano> interval;
+    const steady_clock::time_point start;
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    bool closed{false};
+    /// Guarded by mutex until closed.
+    std::vector<int64_t> latencies;
+    std::atomic<size_t> completed{0};
+    std::atomic<size_t> errors{0};
+};
+
+/**
+ * @brief Threads that make the calls of the blocking styles in the order they
+ * are pushed, so that the loops keeping the schedule never wait for a
+ * response.
+ */
+class Workers
+{
+  public:
+    Workers(size_t count, std::function<void(size_t)> work)
+    {
+        threads_.reserve(count);
+        for (size_t n = 0; n < count; ++n)
+        {
+            threads_.emplace_back([this, work]() {
+                for (;;)
+                {
+                    size_t i;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        cv_.wait(lock, [this]() {
+                            return done_ || !queue_.empty();
+                        });
+                        if (queue_.empty())
+                        {
+                            return;
+                        }
+                        i = queue_.front();
+                        queue_.pop_front();
+                    }
+                    work(i);
+                }
+            });
+        }
+    }
+
+    void push(size_t i)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(i);
+        }
+        cv_.notify_one();
+    }
+
+    /// Finish the calls pushed so far, then stop the threads.
+    void join()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        cv_.notify_all();
+        for (auto &thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<size_t> queue_;
+    bool done_{false};
+    std::vector<std::thread> threads_;
+};
+
+struct BenchResult
+{
+    size_t sent{0};
+    size_t completed{0};
+    size_t errors{0};
+    double seconds{0};
+    std::vector<int64_t> latencies;
+};
+
+void issue(const std::string &style,
+           const BenchCall &call,
+           const std::shared_ptr<RunState> &state,
+           size_t i)
+{
+    auto restCaller = app().getPlugin<Muelsyse>();
+    if (style == "sync")
+    {
+        if (call.isVoid)
+        {
+            restCaller->restCallSync<void>(call.function, call.args);
+        }
+        else
+        {
+            restCaller->restCallSync<Json::Value>(call.function, call.args);
+        }
+        state->record(i, true);
+    }
+    else if (style == "future")
+    {
+        if (call.isVoid)
+        {
+            restCaller->restCallFuture<void>(call.function, call.args).get();
+        }
+        else
+        {
+            restCaller->restCallFuture<Json::Value>(call.function, call.args)
+                .get();
+        }
+        state->record(i, true);
+    }
+    else if (call.isVoid)
+    {
+        restCaller->restCallAsync(
+            call.function,
+            call.args,
+            [state, i]() { state->record(i, true); },
+            [state, i](const std::exception &) { state->record(i, false); });
+    }
+    else
+    {
+        restCaller->restCallAsync<Json::Value>(
+            call.function,
+            call.args,
+            [state, i](Json::Value) { state->record(i, true); },
+            [state, i](const std::exception &) { state->record(i, false); });
+    }
+}
+
+BenchResult run(const std::string &style,
+                const BenchCall &call,
+                const BenchOptions &options)
+{
+    auto total = static_cast<size_t>(options.rate * options.duration);
+    auto state = std::make_shared<RunState>(total, options.rate);
+    auto issueAt = [&style, &call, state](size_t i) {
+        try
+        {
+            issue(style, call, state, i);
+        }
+        catch (const std::exception &e)
+        {
+            state->record(i, false);
+        }
+    };
+    // The sync and future styles wait for each response, they are handed to
+    // the workers as their time comes
+    std::unique_ptr<Workers> workers;
+    if (style != "callback")
+    {
+        workers = std::make_unique<Workers>(options.workers, issueAt);
+    }
+
+    // Each loop takes the next free slot of the global schedule, so a slow
+    // response in one loop never delays the slots that other loops can serve.
+    std::vector<std::thread> loops;
+    for (size_t n = 0; n < options.loops; ++n)
+    {
+        loops.emplace_back([&issueAt, &workers, state]() {
+            for (size_t i = state->next++; i < state->total;
+                 i = state->next++)
+            {
+                std::this_thread::sleep_until(state->intendedTime(i));
+                if (workers)
+                {
+                    workers->push(i);
+                }
+                else
+                {
+                    issueAt(i);
+                }
+            }
+        });
+    }
+    for (auto &loop : loops)
+    {
+        loop.join();
+    }
+    if (workers)
+    {
+        workers->join();
+    }
+
+    // Callbacks that have not come by then are left out
+    auto drainDeadline = steady_clock::now() + seconds(10);
+    while (state->completed < state->total &&
+           steady_clock::now() < drainDeadline)
+    {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    state->close();
+
+    BenchResult result;
+    result.sent = total;
+    result.completed = state->completed;
+    result.errors = state->errors;
+    result.seconds =
+        duration<double>(steady_clock::now() - state->start).count();
+    for (size_t i = 0; i < total; ++i)
+    {
+        if (state->latencies[i] >= 0)
+        {
+            result.latencies.push_back(state->latencies[i]);
+        }
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+double percentile(const std::vector<int64_t> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    auto index = std::min(sorted.size() - 1,
+                          static_cast<size_t>(p * sorted.size()));
+    return sorted[index] / 1000.0;
+}
+
+void report(const std::string &function,
+            const std::string &style,
+            const BenchResult &result)
+{
+    printf("%-32s %-9s %9zu %9zu %7zu %10.1f %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+           function.c_str(),
+           style.c_str(),
+           result.sent,
+           result.completed,
+           result.errors,
+           result.completed / result.seconds,
+           percentile(result.latencies, 0.5),
+           percentile(result.latencies, 0.9),
+           percentile(result.latencies, 0.99),
+           percentile(result.latencies, 0.999),
+           result.latencies.empty() ? 0 : result.latencies.back() / 1000.0);
+}
+
+BenchCall parseCall(const Json::Value &json)
+{
+    BenchCall call;
+    call.function = json.get("function", "").asString();
+    call.isVoid = json.get("void", false).asBool();
+    for (const auto &arg : json["args"])
+    {
+        call.args.emplace_back(arg);
+    }
+    return call;
+}
+
+Json::Value parseJson(const std::string &text)
+{
+    Json::Value json;
+    std::string errs;
+    Json::CharReaderBuilder builder;
+    std::istringstream in(text);
+    if (!Json::parseFromStream(builder, in, &json, &errs))
+    {
+        throw std::invalid_argument("invalid --args: " + errs);
+    }
+    return json;
+}
+
+std::vector<std::string> splitStyles(const std::string &text)
+{
+    std::vector<std::string> styles;
+    std::istringstream in(text);
+    std::string style;
+    while (std::getline(in, style, ','))
+    {
+        styles.push_back(style);
+    }
+    return styles;
+}
+
+BenchOptions parseOptions(int first,
+                          int argc,
+                          char *argv[],
+                          const Json::Value &config)
+{
+    BenchOptions options;
+    options.rate = config.get("rate", options.rate).asDouble();
+    options.duration = config.get("duration", options.duration).asDouble();
+    options.loops = config.get("loops", (Json::UInt)options.loops).asUInt();
+    options.workers =
+        config.get("workers", (Json::UInt)options.workers).asUInt();
+    options.routes = config.get("routes", (Json::UInt)options.routes).asUInt();
+    if (config.isMember("styles"))
+    {
+        options.styles.clear();
+        for (const auto &style : config["styles"])
+        {
+            options.styles.push_back(style.asString());
+        }
+    }
+    for (const auto &call : config["calls"])
+    {
+        options.calls.push_back(parseCall(call));
+    }
+
+    Json::Value single;
+    for (int i = first; i < argc; ++i)
+    {
+        std::string opt = argv[i];
+        if (opt == "--void")
+        {
+            single["void"] = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("missing value of " + opt);
+        }
+        std::string value = argv[++i];
+        if (opt == "--rate")
+        {
+            options.rate = std::stod(value);
+        }
+        else if (opt == "--duration")
+        {
+            options.duration = std::stod(value);
+        }
+        else if (opt == "--loops")
+        {
+            options.loops = std::stoul(value);
+        }
+        else if (opt == "--workers")
+        {
+            options.workers = std::stoul(value);
+        }
+        else if (opt == "--style")
+        {
+            options.styles = splitStyles(value);
+        }
+        else if (opt == "--function")
+        {
+            single["function"] = value;
+        }
+        else if (opt == "--args")
+        {
+            single["args"] = parseJson(value);
+        }
+        else if (opt == "--routes")
+        {
+            options.routes = std::stoul(value);
+        }
+        else
+        {
+            throw std::invalid_argument("unknown option " + opt);
+        }
+    }
+    if (single.isMember("function"))
+    {
+        options.calls = {parseCall(single)};
+    }
+    if (options.rate <= 0 || options.duration <= 0 || options.loops == 0 ||
+        options.workers == 0)
+    {
+        throw std::invalid_argument(
+            "rate, duration, loops and workers must be positive");
+    }
+    return options;
+}
+
+/// Exposes prepare(), to look functions up without sending anything.
+class RouteBench : public Muelsyse
+{
+  public:
+    using Muelsyse::prepare;
+};
+
+/// The resident set size of the process, in bytes.
+size_t residentBytes()
+{
+    size_t pages = 0;
+    size_t resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+/**
+ * @brief Load count functions spread over 64 hosts, as generated from API
+ * specs, then prepare calls to random ones.
+ */
+void benchRoutes(size_t count)
+{
+    Json::Value config;
+    auto &functions = config["function_list"];
+    functions.resize(static_cast<Json::ArrayIndex>(count));
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto &function = functions[static_cast<Json::ArrayIndex>(i)];
+        auto id = std::to_string(i);
+        function["name"] = "api::v1::operation" + id;
+        function["url"] = "http://service" + std::to_string(i % 64) +
+                          ".internal:8080/api/v1/resource" + id + "/{id}";
+        function["http_method"] = i % 2 == 0 ? "get" : "post";
+    }
+
+    RouteBench bench;
+    auto before = residentBytes();
+    auto start = steady_clock::now();
+    bench.initAndStart(config);
+    auto loaded = duration<double, std::milli>(steady_clock::now() - start);
+    auto memory = residentBytes() - std::min(before, residentBytes());
+    start = steady_clock::now();
+    bench.reload(config);
+    auto reloaded = duration<double, std::milli>(steady_clock::now() - start);
+
+    // Create the clients of every host before timing
+    for (size_t i = 0; i < std::min<size_t>(count, 64); ++i)
+    {
+        bench.prepare("api::v1::operation" + std::to_string(i), {"_", 1});
+    }
+    std::mt19937 random(42);
+    std::vector<std::string> names;
+    for (int i = 0; i < 100000; ++i)
+    {
+        names.push_back("api::v1::operation" +
+                        std::to_string(random() % std::max<size_t>(count, 1)));
+    }
+    start = steady_clock::now();
+    for (const auto &name : names)
+    {
+        bench.prepare(name, {"_", 1});
+    }
+    auto prepared = duration<double, std::nano>(steady_clock::now() - start);
+
+    printf("routes:        %zu\n", count);
+    printf("initAndStart:  %.1f ms\n", loaded.count());
+    printf("reload:        %.1f ms\n", reloaded.count());
+    printf("memory:        %.1f MB (%.0f bytes per route)\n",
+           memory / 1048576.0,
+           count ? static_cast<double>(memory) / count : 0.0);
+    printf("prepare:       %.0f ns per call\n",
+           prepared.count() / names.size());
+    bench.shutdown();
+}
+
+/**
+ * @brief A list of users, large enough for parsing to dominate the cost of a
+ * call. The body is serialized once, only the client side is measured.
+ */
+HttpResponsePtr usersResponse()
+{
+    static const std::string body = []() {
+        Json::Value users(Json::arrayValue);
+        for (int i = 0; i < 200; ++i)
+        {
+            auto &user = users.append(Json::objectValue);
+            user["id"] = i;
+            user["username"] = "tanglong3bf";
+            user["email"] = "tanglong3bf@example.com";
+            user["score"] = i * 1.5;
+            user["active"] = i % 2 == 0;
+            user["tags"].append("rest");
+            user["tags"].append("drogon");
+        }
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        return Json::writeString(builder, users);
+    }();
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setContentTypeCode(CT_APPLICATION_JSON);
+    resp->setBody(body);
+    return resp;
+}
+
+/**
+ * @brief Answer `inproc://bench` like test/server does, so that functions
+ * pointing there measure the plugin without the network.
+ */
+void registerInprocServer()
+{
+    registerInprocHandler(
+        "bench",
+        [](const HttpRequestPtr &req,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            if (req->path() == "/users")
+            {
+                callback(usersResponse());
+                return;
+            }
+            if (!req->path().starts_with("/user/"))
+            {
+                callback(HttpResponse::newHttpResponse());
+                return;
+            }
+            Json::Value json;
+            json["id"] = 1;
+            json["username"] = "tanglong3bf";
+            json["password"] = "123456";
+            callback(HttpResponse::newHttpJsonResponse(json));
+        });
+}
+
+/// Drive each call in each style, and report them as a table.
+void runCalls(const BenchOptions &options)
+{
+    printf("%-32s %-9s %9s %9s %7s %10s %9s %9s %9s %9s %9s\n",
+           "function",
+           "style",
+           "sent",
+           "completed",
+           "errors",
+           "req/s",
+           "p50(ms)",
+           "p90(ms)",
+           "p99(ms)",
+           "p99.9(ms)",
+           "max(ms)");
+    for (const auto &call : options.calls)
+    {
+        for (const auto &style : options.styles)
+        {
+            if (style != "sync" && style != "callback" && style != "future")
+            {
+                std::cerr << "unsupported call style: " << style << std::endl;
+                continue;
+            }
+            report(call.function, style, run(style, call, options));
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string configFile = "config.yaml";
+    int first = 1;
+    if (argc > 1 && !std::string(argv[1]).starts_with("--"))
+    {
+        configFile = argv[1];
+        first = 2;
+    }
+
+    registerInprocServer();
+
+    std::promise<void> started;
+    std::thread thr([&]() {
+        app().loadConfigFile(configFile);
+        app().getLoop()->queueInLoop([&started]() { started.set_value(); });
+        app().run();
+    });
+    started.get_future().get();
+
+    int status = 0;
+    try
+    {
+        auto options =
+            parseOptions(first, argc, argv, app().getCustomConfig()["bench"]);
+        if (options.routes > 0)
+        {
+            benchRoutes(options.routes);
+        }
+        else
+        {
+            runCalls(options);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        status = 1;
+    }
+
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return status;
+}
@@ -0,0 +1,1034 @@
+#include "BodyCodec.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef MUELSYSE_WITH_YYJSON
+#include <yyjson.h>
+#endif
+
+using namespace std;
+using namespace tl::rest;
+
+namespace
+{
+
+/// Deeper documents are rejected instead of exhausting the stack.
+constexpr size_t kMaxDepth = 512;
+
+mutex &codecMutex()
+{
+    static mutex mtx;
+    return mtx;
+}
+
+unordered_map<string, shared_ptr<const BodyCodec>> &codecMap()
+{
+    static unordered_map<string, shared_ptr<const BodyCodec>> codecs{
+        {"json", make_shared<JsonCodec>()},
+        {"msgpack", make_shared<MsgPackCodec>()},
+        {"cbor", make_shared<CborCodec>()},
+    };
+    return codecs;
+}
+
+void putBigEndian(string &out, uint64_t value, int bytes)
+{
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8)
+    {
+        out.push_back(static_cast<char>((value >> shift) & 0xff));
+    }
+}
+
+uint64_t doubleBits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+string_view stringOf(const Json::Value &json)
+{
+    const char *begin{nullptr};
+    const char *end{nullptr};
+    json.getString(&begin, &end);
+    return {begin, static_cast<size_t>(end - begin)};
+}
+
+/// Non-negative integers are parsed as Int64 like Json::Reader does.
+Json::Value unsignedValue(uint64_t value)
+{
+    if (value <= static_cast<uint64_t>(numeric_limits<Json::Int64>::max()))
+    {
+        return Json::Int64(value);
+    }
+    return Json::UInt64(value);
+}
+
+/// Object keys of binary formats may be numbers or booleans.
+bool keyOf(const Json::Value &key, string &name)
+{
+    if (!key.isString() && !key.isNumeric() && !key.isBool())
+    {
+        return false;
+    }
+    name = key.asString();
+    return true;
+}
+
+class ByteReader
+{
+  public:
+    explicit ByteReader(string_view data) : data_(data)
+    {
+    }
+
+    bool read(uint8_t &byte)
+    {
+        if (pos_ >= data_.size())
+        {
+            return false;
+        }
+        byte = static_cast<uint8_t>(data_[pos_++]);
+        return true;
+    }
+
+    bool peek(uint8_t &byte) const
+    {
+        if (pos_ >= data_.size())
+        {
+            return false;
+        }
+        byte = static_cast<uint8_t>(data_[pos_]);
+        return true;
+    }
+
+    bool readBigEndian(int bytes, uint64_t &value)
+    {
+        if (data_.size() - pos_ < static_cast<size_t>(bytes))
+        {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            value = (value << 8) | static_cast<uint8_t>(data_[pos_++]);
+        }
+        return true;
+    }
+
+    bool readBytes(uint64_t size, string_view &bytes)
+    {
+        if (data_.size() - pos_ < size)
+        {
+            return false;
+        }
+        bytes = data_.substr(pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool atEnd() const
+    {
+        return pos_ == data_.size();
+    }
+
+  private:
+    string_view data_;
+    size_t pos_{0};
+};
+
+void jsonString(string &out, string_view text)
+{
+    static constexpr char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    size_t from = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        auto c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+        out.append(text.data() + from, i - from);
+        from = i + 1;
+        out.push_back('\\');
+        switch (c)
+        {
+            case '"':
+            case '\\':
+                out.push_back(c);
+                break;
+            case '\b':
+                out.push_back('b');
+                break;
+            case '\f':
+                out.push_back('f');
+                break;
+            case '\n':
+                out.push_back('n');
+                break;
+            case '\r':
+                out.push_back('r');
+                break;
+            case '\t':
+                out.push_back('t');
+                break;
+            default:
+                out.append("u00");
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0xf]);
+                break;
+        }
+    }
+    out.append(text.data() + from, text.size() - from);
+    out.push_back('"');
+}
+
+template <typename T>
+void jsonNumber(string &out, T value)
+{
+    char buf[32];
+    auto end = to_chars(buf, buf + sizeof(buf), value).ptr;
+    out.append(buf, end);
+}
+
+void jsonReal(string &out, double value)
+{
+    // The same as Json::writeString without useSpecialFloats
+    if (std::isnan(value))
+    {
+        out.append("null");
+        return;
+    }
+    if (std::isinf(value))
+    {
+        out.append(value < 0 ? "-1e+9999" : "1e+9999");
+        return;
+    }
+    auto size = out.size();
+    jsonNumber(out, value);
+    // Keep it a real number when it is read back
+    if (out.find_first_of(".e", size) == string::npos)
+    {
+        out.append(".0");
+    }
+}
+
+/// Write compact JSON straight into out, without an intermediate stream.
+void jsonEncode(const Json::Value &json, string &out, size_t depth)
+{
+    if (depth > kMaxDepth)
+    {
+        throw invalid_argument("JSON value nested too deeply.");
+    }
+    switch (json.type())
+    {
+        case Json::nullValue:
+            out.append("null");
+            break;
+        case Json::booleanValue:
+            out.append(json.asBool() ? "true" : "false");
+            break;
+        case Json::intValue:
+            jsonNumber(out, json.asInt64());
+            break;
+        case Json::uintValue:
+            jsonNumber(out, json.asUInt64());
+            break;
+        case Json::realValue:
+            jsonReal(out, json.asDouble());
+            break;
+        case Json::stringValue:
+            jsonString(out, stringOf(json));
+            break;
+        case Json::arrayValue:
+        {
+            out.push_back('[');
+            bool first = true;
+            for (const auto &item : json)
+            {
+                if (!first)
+                {
+                    out.push_back(',');
+                }
+                first = false;
+                jsonEncode(item, out, depth + 1);
+            }
+            out.push_back(']');
+            break;
+        }
+        case Json::objectValue:
+        {
+            out.push_back('{');
+            for (auto iter = json.begin(); iter != json.end(); ++iter)
+            {
+                if (iter != json.begin())
+                {
+                    out.push_back(',');
+                }
+                const char *end{nullptr};
+                const char *name = iter.memberName(&end);
+                jsonString(out, string_view(name, end - name));
+                out.push_back(':');
+                jsonEncode(*iter, out, depth + 1);
+            }
+            out.push_back('}');
+            break;
+        }
+    }
+}
+
+// MessagePack
+
+void msgpackUnsigned(string &out, uint64_t value)
+{
+    if (value < 0x80)
+    {
+        out.push_back(static_cast<char>(value));
+    }
+    else if (value <= 0xff)
+    {
+        out.push_back('\xcc');
+        putBigEndian(out, value, 1);
+    }
+    else if (value <= 0xffff)
+    {
+        out.push_back('\xcd');
+        putBigEndian(out, value, 2);
+    }
+    else if (value <= 0xffffffff)
+    {
+        out.push_back('\xce');
+        putBigEndian(out, value, 4);
+    }
+    else
+    {
+        out.push_back('\xcf');
+        putBigEndian(out, value, 8);
+    }
+}
+
+void msgpackSigned(string &out, int64_t value)
+{
+    if (value >= 0)
+    {
+        msgpackUnsigned(out, value);
+    }
+    else if (value >= -32)
+    {
+        out.push_back(static_cast<char>(value));
+    }
+    else if (value >= numeric_limits<int8_t>::min())
+    {
+        out.push_back('\xd0');
+        putBigEndian(out, static_cast<uint64_t>(value), 1);
+    }
+    else if (value >= numeric_limits<int16_t>::min())
+    {
+        out.push_back('\xd1');
+        putBigEndian(out, static_cast<uint64_t>(value), 2);
+    }
+    else if (value >= numeric_limits<int32_t>::min())
+    {
+        out.push_back('\xd2');
+        putBigEndian(out, static_cast<uint64_t>(value), 4);
+    }
+    else
+    {
+        out.push_back('\xd3');
+        putBigEndian(out, static_cast<uint64_t>(value), 8);
+    }
+}
+
+/// Header of str, array and map, whose fix/16/32 variants share a layout.
+void msgpackHead(string &out,
+                 size_t size,
+                 uint8_t fixType,
+                 size_t fixLimit,
+                 uint8_t type16,
+                 uint8_t type32)
+{
+    if (size < fixLimit)
+    {
+        out.push_back(static_cast<char>(fixType | size));
+    }
+    else if (size <= 0xffff)
+    {
+        out.push_back(static_cast<char>(type16));
+        putBigEndian(out, size, 2);
+    }
+    else if (size <= 0xffffffff)
+    {
+        out.push_back(static_cast<char>(type32));
+        putBigEndian(out, size, 4);
+    }
+    else
+    {
+        throw invalid_argument("JSON value too large for MessagePack.");
+    }
+}
+
+void msgpackString(string &out, string_view str)
+{
+    if (str.size() >= 32 && str.size() <= 0xff)
+    {
+        out.push_back('\xd9');
+        putBigEndian(out, str.size(), 1);
+    }
+    else
+    {
+        msgpackHead(out, str.size(), 0xa0, 32, 0xda, 0xdb);
+    }
+    out.append(str);
+}
+
+void msgpackEncode(const Json::Value &json, string &out, size_t depth)
+{
+    if (depth > kMaxDepth)
+    {
+        throw invalid_argument("JSON value nested too deeply.");
+    }
+    switch (json.type())
+    {
+        case Json::nullValue:
+            out.push_back('\xc0');
+            break;
+        case Json::booleanValue:
+            out.push_back(json.asBool() ? '\xc3' : '\xc2');
+            break;
+        case Json::intValue:
+            msgpackSigned(out, json.asInt64());
+            break;
+        case Json::uintValue:
+            msgpackUnsigned(out, json.asUInt64());
+            break;
+        case Json::realValue:
+            out.push_back('\xcb');
+            putBigEndian(out, doubleBits(json.asDouble()), 8);
+            break;
+        case Json::stringValue:
+            msgpackString(out, stringOf(json));
+            break;
+        case Json::arrayValue:
+            msgpackHead(out, json.size(), 0x90, 16, 0xdc, 0xdd);
+            for (const auto &item : json)
+            {
+                msgpackEncode(item, out, depth + 1);
+            }
+            break;
+        case Json::objectValue:
+            msgpackHead(out, json.size(), 0x80, 16, 0xde, 0xdf);
+            for (auto iter = json.begin(); iter != json.end(); ++iter)
+            {
+                msgpackString(out, iter.name());
+                msgpackEncode(*iter, out, depth + 1);
+            }
+            break;
+    }
+}
+
+bool msgpackDecode(ByteReader &in, Json::Value &json, size_t depth);
+
+bool msgpackArray(ByteReader &in,
+                  Json::Value &json,
+                  uint64_t size,
+                  size_t depth)
+{
+    json = Json::Value(Json::arrayValue);
+    for (uint64_t i = 0; i < size; ++i)
+    {
+        Json::Value item;
+        if (!msgpackDecode(in, item, depth + 1))
+        {
+            return false;
+        }
+        json.append(std::move(item));
+    }
+    return true;
+}
+
+bool msgpackMap(ByteReader &in,
+                Json::Value &json,
+                uint64_t size,
+                size_t depth)
+{
+    json = Json::Value(Json::objectValue);
+    for (uint64_t i = 0; i < size; ++i)
+    {
+        Json::Value key;
+        string name;
+        if (!msgpackDecode(in, key, depth + 1) || !keyOf(key, name) ||
+            !msgpackDecode(in, json[name], depth + 1))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool msgpackDecode(ByteReader &in, Json::Value &json, size_t depth)
+{
+    uint8_t type;
+    if (depth > kMaxDepth || !in.read(type))
+    {
+        return false;
+    }
+    uint64_t value{0};
+    string_view bytes;
+    if (type <= 0x7f)
+    {
+        json = Json::Int64(type);
+        return true;
+    }
+    if (type >= 0xe0)
+    {
+        json = Json::Int64(static_cast<int8_t>(type));
+        return true;
+    }
+    if ((type & 0xf0) == 0x80)
+    {
+        return msgpackMap(in, json, type & 0x0f, depth);
+    }
+    if ((type & 0xf0) == 0x90)
+    {
+        return msgpackArray(in, json, type & 0x0f, depth);
+    }
+    if ((type & 0xe0) == 0xa0)
+    {
+        if (!in.readBytes(type & 0x1f, bytes))
+        {
+            return false;
+        }
+        json = Json::Value(bytes.data(), bytes.data() + bytes.size());
+        return true;
+    }
+    switch (type)
+    {
+        case 0xc0:
+            json = Json::Value();
+            return true;
+        case 0xc2:
+        case 0xc3:
+            json = (type == 0xc3);
+            return true;
+        // bin 8/16/32 and str 8/16/32 are both mapped to strings
+        case 0xc4:
+        case 0xc5:
+        case 0xc6:
+        case 0xd9:
+        case 0xda:
+        case 0xdb:
+        {
+            int lengthBytes = type >= 0xd9 ? 1 << (type - 0xd9)
+                                           : 1 << (type - 0xc4);
+            if (!in.readBigEndian(lengthBytes, value) ||
+                !in.readBytes(value, bytes))
+            {
+                return false;
+            }
+            json = Json::Value(bytes.data(), bytes.data() + bytes.size());
+            return true;
+        }
+        case 0xca:
+        {
+            if (!in.readBigEndian(4, value))
+            {
+                return false;
+            }
+            auto bits = static_cast<uint32_t>(value);
+            float number;
+            memcpy(&number, &bits, sizeof(number));
+            json = static_cast<double>(number);
+            return true;
+        }
+        case 0xcb:
+        {
+            if (!in.readBigEndian(8, value))
+            {
+                return false;
+            }
+            double number;
+            memcpy(&number, &value, sizeof(number));
+            json = number;
+            return true;
+        }
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+            if (!in.readBigEndian(1 << (type - 0xcc), value))
+            {
+                return false;
+            }
+            json = unsignedValue(value);
+            return true;
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3:
+        {
+            int bytesCount = 1 << (type - 0xd0);
+            if (!in.readBigEndian(bytesCount, value))
+            {
+                return false;
+            }
+            // sign-extend
+            int shift = 64 - bytesCount * 8;
+            json = Json::Int64(static_cast<int64_t>(value << shift) >> shift);
+            return true;
+        }
+        case 0xdc:
+        case 0xdd:
+            return in.readBigEndian(type == 0xdc ? 2 : 4, value) &&
+                   msgpackArray(in, json, value, depth);
+        case 0xde:
+        case 0xdf:
+            return in.readBigEndian(type == 0xde ? 2 : 4, value) &&
+                   msgpackMap(in, json, value, depth);
+        default:  // ext types have no JSON counterpart
+            return false;
+    }
+}
+
+// CBOR
+
+void cborHead(string &out, uint8_t major, uint64_t value)
+{
+    major <<= 5;
+    if (value < 24)
+    {
+        out.push_back(static_cast<char>(major | value));
+    }
+    else if (value <= 0xff)
+    {
+        out.push_back(static_cast<char>(major | 24));
+        putBigEndian(out, value, 1);
+    }
+    else if (value <= 0xffff)
+    {
+        out.push_back(static_cast<char>(major | 25));
+        putBigEndian(out, value, 2);
+    }
+    else if (value <= 0xffffffff)
+    {
+        out.push_back(static_cast<char>(major | 26));
+        putBigEndian(out, value, 4);
+    }
+    else
+    {
+        out.push_back(static_cast<char>(major | 27));
+        putBigEndian(out, value, 8);
+    }
+}
+
+void cborEncode(const Json::Value &json, string &out, size_t depth)
+{
+    if (depth > kMaxDepth)
+    {
+        throw invalid_argument("JSON value nested too deeply.");
+    }
+    switch (json.type())
+    {
+        case Json::nullValue:
+            out.push_back('\xf6');
+            break;
+        case Json::booleanValue:
+            out.push_back(json.asBool() ? '\xf5' : '\xf4');
+            break;
+        case Json::intValue:
+        {
+            auto value = json.asInt64();
+            if (value >= 0)
+            {
+                cborHead(out, 0, value);
+            }
+            else
+            {
+                cborHead(out, 1, static_cast<uint64_t>(-(value + 1)));
+            }
+            break;
+        }
+        case Json::uintValue:
+            cborHead(out, 0, json.asUInt64());
+            break;
+        case Json::realValue:
+            out.push_back('\xfb');
+            putBigEndian(out, doubleBits(json.asDouble()), 8);
+            break;
+        case Json::stringValue:
+        {
+            auto str = stringOf(json);
+            cborHead(out, 3, str.size());
+            out.append(str);
+            break;
+        }
+        case Json::arrayValue:
+            cborHead(out, 4, json.size());
+            for (const auto &item : json)
+            {
+                cborEncode(item, out, depth + 1);
+            }
+            break;
+        case Json::objectValue:
+            cborHead(out, 5, json.size());
+            for (auto iter = json.begin(); iter != json.end(); ++iter)
+            {
+                auto name = iter.name();
+                cborHead(out, 3, name.size());
+                out.append(name);
+                cborEncode(*iter, out, depth + 1);
+            }
+            break;
+    }
+}
+
+/// RFC 8949, Appendix D
+double halfToDouble(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double value;
+    if (exponent == 0)
+    {
+        value = ldexp(mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        value = ldexp(mantissa + 1024, exponent - 25);
+    }
+    else
+    {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+/// The break code that ends an item of indefinite length.
+bool cborBreak(ByteReader &in)
+{
+    uint8_t byte;
+    if (in.peek(byte) && byte == 0xff)
+    {
+        in.read(byte);
+        return true;
+    }
+    return false;
+}
+
+bool cborDecode(ByteReader &in, Json::Value &json, size_t depth);
+
+bool cborString(ByteReader &in,
+                uint8_t major,
+                uint64_t size,
+                bool indefinite,
+                Json::Value &json)
+{
+    string_view bytes;
+    if (!indefinite)
+    {
+        if (!in.readBytes(size, bytes))
+        {
+            return false;
+        }
+        json = Json::Value(bytes.data(), bytes.data() + bytes.size());
+        return true;
+    }
+    // Chunks of definite length, all of the same major type
+    string result;
+    while (!cborBreak(in))
+    {
+        uint8_t initial;
+        uint64_t chunkSize;
+        if (!in.read(initial) || (initial >> 5) != major)
+        {
+            return false;
+        }
+        uint8_t info = initial & 0x1f;
+        if (info < 24)
+        {
+            chunkSize = info;
+        }
+        else if (info > 27 || !in.readBigEndian(1 << (info - 24), chunkSize))
+        {
+            return false;
+        }
+        if (!in.readBytes(chunkSize, bytes))
+        {
+            return false;
+        }
+        result.append(bytes);
+    }
+    json = Json::Value(result.data(), result.data() + result.size());
+    return true;
+}
+
+bool cborSimple(ByteReader &in, uint8_t info, Json::Value &json)
+{
+    uint64_t bits;
+    switch (info)
+    {
+        case 20:
+        case 21:
+            json = (info == 21);
+            return true;
+        case 22:
+        case 23:  // null and undefined
+            json = Json::Value();
+            return true;
+        case 25:
+            if (!in.readBigEndian(2, bits))
+            {
+                return false;
+            }
+            json = halfToDouble(static_cast<uint16_t>(bits));
+            return true;
+        case 26:
+        {
+            if (!in.readBigEndian(4, bits))
+            {
+                return false;
+            }
+            auto bits32 = static_cast<uint32_t>(bits);
+            float number;
+            memcpy(&number, &bits32, sizeof(number));
+            json = static_cast<double>(number);
+            return true;
+        }
+        case 27:
+        {
+            if (!in.readBigEndian(8, bits))
+            {
+                return false;
+            }
+            double number;
+            memcpy(&number, &bits, sizeof(number));
+            json = number;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool cborDecode(ByteReader &in, Json::Value &json, size_t depth)
+{
+    uint8_t initial;
+    if (depth > kMaxDepth || !in.read(initial))
+    {
+        return false;
+    }
+    uint8_t major = initial >> 5;
+    uint8_t info = initial & 0x1f;
+    if (major == 7)
+    {
+        return cborSimple(in, info, json);
+    }
+
+    uint64_t value{0};
+    bool indefinite{false};
+    if (info < 24)
+    {
+        value = info;
+    }
+    else if (info <= 27)
+    {
+        if (!in.readBigEndian(1 << (info - 24), value))
+        {
+            return false;
+        }
+    }
+    else if (info == 31 && major >= 2 && major <= 5)
+    {
+        indefinite = true;
+    }
+    else
+    {
+        return false;
+    }
+
+    switch (major)
+    {
+        case 0:
+            json = unsignedValue(value);
+            return true;
+        case 1:
+            if (value > static_cast<uint64_t>(numeric_limits<int64_t>::max()))
+            {
+                return false;
+            }
+            json = Json::Int64(-1 - static_cast<int64_t>(value));
+            return true;
+        case 2:
+        case 3:
+            return cborString(in, major, value, indefinite, json);
+        case 4:
+            json = Json::Value(Json::arrayValue);
+            for (uint64_t i = 0; indefinite ? !cborBreak(in) : i < value; ++i)
+            {
+                Json::Value item;
+                if (!cborDecode(in, item, depth + 1))
+                {
+                    return false;
+                }
+                json.append(std::move(item));
+            }
+            return true;
+        case 5:
+            json = Json::Value(Json::objectValue);
+            for (uint64_t i = 0; indefinite ? !cborBreak(in) : i < value; ++i)
+            {
+                Json::Value key;
+                string name;
+                if (!cborDecode(in, key, depth + 1) || !keyOf(key, name) ||
+                    !cborDecode(in, json[name], depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        default:  // 6: tags carry no meaning for Json::Value
+            return cborDecode(in, json, depth + 1);
+    }
+}
+
+#ifdef MUELSYSE_WITH_YYJSON
+/// Copy the document of yyjson into json, with the types Json::Reader gives.
+bool fromYyjson(yyjson_val *val, Json::Value &json, size_t depth)
+{
+    if (depth > kMaxDepth)
+    {
+        return false;
+    }
+    switch (yyjson_get_type(val))
+    {
+        case YYJSON_TYPE_NULL:
+            json = Json::nullValue;
+            return true;
+        case YYJSON_TYPE_BOOL:
+            json = yyjson_get_bool(val);
+            return true;
+        case YYJSON_TYPE_NUM:
+            if (yyjson_is_uint(val))
+            {
+                json = unsignedValue(yyjson_get_uint(val));
+            }
+            else if (yyjson_is_sint(val))
+            {
+                json = Json::Int64(yyjson_get_sint(val));
+            }
+            else
+            {
+                json = yyjson_get_real(val);
+            }
+            return true;
+        case YYJSON_TYPE_STR:
+        {
+            auto str = yyjson_get_str(val);
+            json = Json::Value(str, str + yyjson_get_len(val));
+            return true;
+        }
+        case YYJSON_TYPE_ARR:
+        {
+            json = Json::Value(Json::arrayValue);
+            json.resize(static_cast<Json::ArrayIndex>(yyjson_arr_size(val)));
+            size_t idx, max;
+            yyjson_val *item;
+            yyjson_arr_foreach(val, idx, max, item)
+            {
+                if (!fromYyjson(item,
+                                json[static_cast<Json::ArrayIndex>(idx)],
+                                depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case YYJSON_TYPE_OBJ:
+        {
+            json = Json::Value(Json::objectValue);
+            size_t idx, max;
+            yyjson_val *key, *item;
+            yyjson_obj_foreach(val, idx, max, key, item)
+            {
+                auto &member =
+                    json[string(yyjson_get_str(key), yyjson_get_len(key))];
+                if (!fromYyjson(item, member, depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+#endif
+
+}  // namespace
+
+void BodyCodec::registerCodec(const string &name,
+                              shared_ptr<const BodyCodec> codec)
+{
+    lock_guard<mutex> lock(codecMutex());
+    codecMap()[name] = std::move(codec);
+}
+
+shared_ptr<const BodyCodec> BodyCodec::get(const string &name)
+{
+    lock_guard<mutex> lock(codecMutex());
+    auto &codecs = codecMap();
+    auto iter = codecs.find(name);
+    return iter == codecs.end() ? nullptr : iter->second;
+}
+
+void JsonCodec::encode(const Json::Value &json, string &out) const
+{
+    jsonEncode(json, out, 0);
+}
+
+bool JsonCodec::decode(string_view body, Json::Value &json) const
+{
+#ifdef MUELSYSE_WITH_YYJSON
+    unique_ptr<yyjson_doc, decltype(&yyjson_doc_free)> doc(
+        yyjson_read(body.data(), body.size(), YYJSON_READ_NOFLAG),
+        yyjson_doc_free);
+    return doc != nullptr &&
+           fromYyjson(yyjson_doc_get_root(doc.get()), json, 0);
+#else
+    // A reader is costly to build, and is not shared between threads
+    thread_local unique_ptr<Json::CharReader> reader(
+        Json::CharReaderBuilder().newCharReader());
+    return reader->parse(
+        body.data(), body.data() + body.size(), &json, nullptr);
+#endif
+}
+
+void MsgPackCodec::encode(const Json::Value &json, string &out) const
+{
+    msgpackEncode(json, out, 0);
+}
+
+bool MsgPackCodec::decode(string_view body, Json::Value &json) const
+{
+    ByteReader in(body);
+    return msgpackDecode(in, json, 0) && in.atEnd();
+}
+
+void CborCodec::encode(const Json::Value &json, string &out) const
+{
+    cborEncode(json, out, 0);
+}
+
+bool CborCodec::decode(string_view body, Json::Value &json) const
+{
+    ByteReader in(body);
+    return cborDecode(in, json, 0) && in.atEnd();
+}
@@ -0,0 +1,115 @@
+/**
+ * @file BodyCodec.h
+ * @brief Codecs used to put Json::Value on the wire.
+ *
+ * Requests and responses are always built from and parsed into Json::Value,
+ * so the `toJson()`/`setByJson()` contract of user types does not depend on
+ * the format that is actually sent. Besides JSON, MessagePack and CBOR are
+ * supported out of the box, others can be added with BodyCodec::registerCodec.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <json/json.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace tl::rest
+{
+
+/**
+ * @brief Convert between Json::Value and the body of a request or response.
+ *
+ * Implementations must be stateless, a single instance is shared by every
+ * thread.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class BodyCodec
+{
+  public:
+    virtual ~BodyCodec() = default;
+
+    /// The value of the Content-Type header, such as `application/msgpack`.
+    virtual std::string_view contentType() const = 0;
+
+    /**
+     * @brief Serialize json and append it to out.
+     *
+     * @throw std::invalid_argument If json cannot be represented.
+     */
+    virtual void encode(const Json::Value &json, std::string &out) const = 0;
+
+    /**
+     * @brief Parse body into json.
+     *
+     * @return false if body is malformed.
+     */
+    virtual bool decode(std::string_view body, Json::Value &json) const = 0;
+
+    /**
+     * @brief Register a codec, it can then be selected with `codec: <name>`
+     * in function_list.
+     *
+     * Built-in codecs: `json`, `msgpack`, `cbor`.
+     *
+     * @attention
+     * Codecs must be registered before the plugin is initialized.
+     */
+    static void registerCodec(const std::string &name,
+                              std::shared_ptr<const BodyCodec> codec);
+
+    /**
+     * @brief Find a codec by name.
+     *
+     * @return The codec, or nullptr if the name is unknown.
+     */
+    static std::shared_ptr<const BodyCodec> get(const std::string &name);
+};
+
+/// Text JSON, compatible with drogon's newHttpJsonRequest.
+class JsonCodec : public BodyCodec
+{
+  public:
+    std::string_view contentType() const override
+    {
+        return "application/json";
+    }
+
+    void encode(const Json::Value &json, std::string &out) const override;
+    bool decode(std::string_view body, Json::Value &json) const override;
+};
+
+/// MessagePack, https://msgpack.org
+class MsgPackCodec : public BodyCodec
+{
+  public:
+    std::string_view contentType() const override
+    {
+        return "application/msgpack";
+    }
+
+    void encode(const Json::Value &json, std::string &out) const override;
+    bool decode(std::string_view body, Json::Value &json) const override;
+};
+
+/// CBOR, RFC 8949
+class CborCodec : public BodyCodec
+{
+  public:
+    std::string_view contentType() const override
+    {
+        return "application/cbor";
+    }
+
+    void encode(const Json::Value &json, std::string &out) const override;
+    bool decode(std::string_view body, Json::Value &json) const override;
+};
+
+}  // namespace tl::rest
@@ -0,0 +1,109 @@
+#include "CallScheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace std::chrono;
+using namespace tl::rest;
+
+Priority tl::rest::priorityFromString(const string &priority) noexcept(false)
+{
+    string lower = priority;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) {
+        return std::tolower(static_cast<unsigned char>(c));
+    });
+    if (lower == "low")
+    {
+        return Priority::Low;
+    }
+    if (lower == "normal")
+    {
+        return Priority::Normal;
+    }
+    if (lower == "high")
+    {
+        return Priority::High;
+    }
+    throw invalid_argument("Unsupported priority: " + priority);
+}
+
+CallScheduler::CallScheduler(size_t maxConcurrency, milliseconds maxWait)
+    : maxConcurrency_(std::max<size_t>(maxConcurrency, 1)), maxWait_(maxWait)
+{
+}
+
+void CallScheduler::submit(Priority priority, function<void()> start)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (inFlight_ >= maxConcurrency_)
+        {
+            queues_[static_cast<size_t>(priority)].push_back(
+                {std::move(start), steady_clock::now()});
+            ++queued_;
+            return;
+        }
+        ++inFlight_;
+    }
+    start();
+}
+
+void CallScheduler::release()
+{
+    function<void()> start;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        start = next();
+        if (!start)
+        {
+            --inFlight_;
+            return;
+        }
+    }
+    // The slot passes to the next call
+    start();
+}
+
+size_t CallScheduler::queued() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_;
+}
+
+size_t CallScheduler::inFlight() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return inFlight_;
+}
+
+function<void()> CallScheduler::next()
+{
+    if (queued_ == 0)
+    {
+        return nullptr;
+    }
+    // The call that has waited the longest, if it has waited too long
+    deque<Waiting> *chosen = nullptr;
+    auto starvedBefore = steady_clock::now() - maxWait_;
+    for (auto &queue : queues_)
+    {
+        if (!queue.empty() && queue.front().since <= starvedBefore &&
+            (chosen == nullptr || queue.front().since < chosen->front().since))
+        {
+            chosen = &queue;
+        }
+    }
+    // Otherwise the highest priority
+    for (auto iter = queues_.rbegin(); chosen == nullptr; ++iter)
+    {
+        if (!iter->empty())
+        {
+            chosen = &*iter;
+        }
+    }
+    auto start = std::move(chosen->front().start);
+    chosen->pop_front();
+    --queued_;
+    return start;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file CallScheduler.h
+ * @brief Limit the calls in flight to a host and pick the next one by
+ * priority.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace tl::rest
+{
+
+/**
+ * @brief How urgent a call is when the connections to its host are busy.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+enum class Priority
+{
+    Low,
+    Normal,
+    High
+};
+
+/**
+ * @brief Parse "low", "normal" or "high".
+ *
+ * @throw std::invalid_argument For any other value.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+Priority priorityFromString(const std::string &priority) noexcept(false);
+
+/**
+ * @brief Runs at most maxConcurrency calls of a host at once.
+ *
+ * The other calls wait in one queue per priority. When a call completes, the
+ * next one comes from the highest priority that has calls waiting, unless a
+ * call of a lower priority has waited for maxWait already: the call that
+ * has waited the longest among those goes first, so a steady stream of
+ * urgent calls cannot starve the others.
+ *
+ * Calls are started on the thread that submits them or on the thread that
+ * releases a slot, outside the lock, so starting one must not block.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class CallScheduler
+{
+  public:
+    /**
+     * @param maxConcurrency The number of calls in flight at most, at
+     * least 1.
+     * @param maxWait How long a call waits before it is served ahead of the
+     * calls of higher priorities.
+     */
+    CallScheduler(size_t maxConcurrency, std::chrono::milliseconds maxWait);
+
+    CallScheduler(const CallScheduler &) = delete;
+    CallScheduler &operator=(const CallScheduler &) = delete;
+
+    /**
+     * @brief Start the call now if a slot is free, or queue it.
+     *
+     * @param start Sends the request, release() must be called once its
+     * response or error is received.
+     */
+    void submit(Priority priority, std::function<void()> start);
+
+    /// Free the slot of a completed call and start the next one, if any.
+    void release();
+
+    /// The number of calls waiting for a slot.
+    size_t queued() const;
+
+    /// The number of calls in flight.
+    size_t inFlight() const;
+
+  private:
+    struct Waiting
+    {
+        std::function<void()> start;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    /// Remove the next call to start from the queues, the lock is held.
+    std::function<void()> next();
+
+    const size_t maxConcurrency_;
+    const std::chrono::milliseconds maxWait_;
+
+    mutable std::mutex mutex_;
+    size_t inFlight_{0};
+    size_t queued_{0};
+    /// Indexed by Priority.
+    std::array<std::deque<Waiting>, 3> queues_;
+};
+
+}  // namespace tl::rest
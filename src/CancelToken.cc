@@ -0,0 +1,64 @@
+#include "CancelToken.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+using namespace std;
+using namespace tl::rest;
+
+struct CancelToken::State
+{
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    uint64_t nextId{1};
+    std::map<uint64_t, function<void()>> callbacks;
+};
+
+CancelToken::CancelToken() : state_(make_shared<State>())
+{
+}
+
+void CancelToken::cancel() const
+{
+    std::map<uint64_t, function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->cancelled.exchange(true))
+        {
+            return;
+        }
+        callbacks.swap(state_->callbacks);
+    }
+    // Outside the lock, the callbacks may remove themselves
+    for (auto &[id, callback] : callbacks)
+    {
+        callback();
+    }
+}
+
+bool CancelToken::isCancelled() const
+{
+    return state_->cancelled;
+}
+
+uint64_t CancelToken::onCancel(function<void()> callback) const
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (!state_->cancelled)
+        {
+            auto id = state_->nextId++;
+            state_->callbacks.emplace(id, std::move(callback));
+            return id;
+        }
+    }
+    callback();
+    return 0;
+}
+
+void CancelToken::removeCallback(uint64_t id) const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->callbacks.erase(id);
+}
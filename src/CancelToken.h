@@ -0,0 +1,64 @@
+/**
+ * @file CancelToken.h
+ * @brief Abandon calls whose result is no longer wanted.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace tl::rest
+{
+
+/**
+ * @brief A flag shared by its copies, set once by cancel().
+ *
+ * Give a token to calls through CallScope. Cancelling it fails the calls that
+ * are still waiting for their response with CallCancelled: queued calls are
+ * never sent, and the responses of calls in flight are dropped unparsed.
+ *
+ * @code
+ * tl::rest::CancelToken token;
+ * {
+ *     tl::rest::CallScope scope({.cancelToken = token});
+ *     future = exportUsers();
+ * }
+ * ...
+ * token.cancel();
+ * @endcode
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class CancelToken
+{
+  public:
+    CancelToken();
+
+    /// Set the flag and run the callbacks, only the first call does.
+    void cancel() const;
+
+    bool isCancelled() const;
+
+    /**
+     * @brief Run callback when the token is cancelled, at once if it already
+     * is.
+     *
+     * @return An id for removeCallback.
+     */
+    uint64_t onCancel(std::function<void()> callback) const;
+
+    /// Forget a callback that has not run yet.
+    void removeCallback(uint64_t id) const;
+
+  private:
+    struct State;
+    std::shared_ptr<State> state_;
+};
+
+}  // namespace tl::rest
@@ -0,0 +1,66 @@
+#include "DeadlineFilter.h"
+
+#include <charconv>
+
+using namespace std;
+using namespace std::chrono;
+using namespace drogon;
+using namespace tl::rest;
+
+/// The attribute of the request that holds its deadline.
+static const string deadlineAttribute = "tl::rest::deadline";
+
+void DeadlineFilter::doFilter(const HttpRequestPtr &req,
+                              FilterCallback &&fcb,
+                              FilterChainCallback &&fccb)
+{
+    auto muelsyse = app().getPlugin<Muelsyse>();
+    if (muelsyse == nullptr)
+    {
+        fccb();
+        return;
+    }
+    auto now = steady_clock::now();
+    std::optional<steady_clock::time_point> deadline;
+    const auto &header = muelsyse->deadlineHeader();
+    const auto &value = header.empty() ? string() : req->getHeader(header);
+    int64_t ms = 0;
+    auto [end, ec] =
+        std::from_chars(value.data(), value.data() + value.size(), ms);
+    if (!value.empty() && ec == std::errc() &&
+        end == value.data() + value.size())
+    {
+        if (ms <= 0)
+        {
+            // The caller has already given up
+            fcb(HttpResponse::newHttpResponse(k504GatewayTimeout, CT_NONE));
+            return;
+        }
+        deadline = now + milliseconds(ms);
+    }
+    else if (muelsyse->defaultDeadline() > 0)
+    {
+        deadline = now + duration_cast<steady_clock::duration>(
+                             duration<double>(muelsyse->defaultDeadline()));
+    }
+    if (!deadline)
+    {
+        fccb();
+        return;
+    }
+    req->attributes()->insert(deadlineAttribute, *deadline);
+    CallScope scope({.deadline = deadline});
+    fccb();
+}
+
+CallOptions DeadlineFilter::optionsOf(const HttpRequestPtr &req)
+{
+    CallOptions options;
+    if (req->attributes()->find(deadlineAttribute))
+    {
+        options.deadline =
+            req->attributes()->get<steady_clock::time_point>(
+                deadlineAttribute);
+    }
+    return options;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file DeadlineFilter.h
+ * @brief Carry the deadline of an inbound request over to the calls made
+ * while handling it.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <drogon/HttpFilter.h>
+
+#include "Muelsyse.h"
+
+namespace tl::rest
+{
+
+/**
+ * @brief A drogon filter that gives the handler a CallScope with the
+ * deadline of the request.
+ *
+ * The deadline is read from Muelsyse::deadlineHeader(), the time left in
+ * milliseconds as sent by an upstream Muelsyse, or else set to
+ * Muelsyse::defaultDeadline() from now. A request that arrives with no time
+ * left is answered with 504 at once.
+ *
+ * The scope only covers the code that runs before the handler returns. Code
+ * that runs later, in callbacks, opens its own scope with optionsOf():
+ *
+ * @code
+ * tl::rest::CallScope scope(tl::rest::DeadlineFilter::optionsOf(req));
+ * @endcode
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class DeadlineFilter : public drogon::HttpFilter<DeadlineFilter>
+{
+  public:
+    void doFilter(const drogon::HttpRequestPtr &req,
+                  drogon::FilterCallback &&fcb,
+                  drogon::FilterChainCallback &&fccb) override;
+
+    /**
+     * @brief The options set by the filter for req, empty if it has no
+     * deadline.
+     */
+    static CallOptions optionsOf(const drogon::HttpRequestPtr &req);
+};
+
+}  // namespace tl::rest
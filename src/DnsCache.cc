@@ -0,0 +1,379 @@
+#include "DnsCache.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+using namespace std::chrono;
+using namespace tl::rest;
+
+namespace
+{
+
+constexpr auto defaultAttemptDelay = milliseconds(250);
+/// RFC 8305, section 5: shorter delays would only add congestion.
+constexpr auto minAttemptDelay = milliseconds(100);
+
+struct Candidate
+{
+    sockaddr_storage addr;
+    socklen_t len;
+    string address;
+    /// How long the next attempt waits for this one.
+    milliseconds delay{defaultAttemptDelay};
+};
+
+string toString(const sockaddr_storage &addr)
+{
+    char buf[INET6_ADDRSTRLEN]{};
+    if (addr.ss_family == AF_INET6)
+    {
+        auto addr6 = reinterpret_cast<const sockaddr_in6 *>(&addr);
+        inet_ntop(AF_INET6, &addr6->sin6_addr, buf, sizeof(buf));
+    }
+    else
+    {
+        auto addr4 = reinterpret_cast<const sockaddr_in *>(&addr);
+        inet_ntop(AF_INET, &addr4->sin_addr, buf, sizeof(buf));
+    }
+    return buf;
+}
+
+/**
+ * @brief Try the addresses that connected fastest first, and those that
+ * failed last, with attempt delays of twice their connect time (RFC 8305,
+ * sections 4 and 5). The order is kept otherwise.
+ */
+void sortByRtt(vector<Candidate> &candidates, const DnsCache::Rtts &rtts)
+{
+    // Unmeasured addresses go after the measured ones, before the failed
+    constexpr auto unknown = microseconds::max() - microseconds(1);
+    auto rttOf = [&rtts](const Candidate &candidate) {
+        auto iter = rtts.find(candidate.address);
+        return iter == rtts.end() ? unknown : iter->second;
+    };
+    std::stable_sort(candidates.begin(),
+                     candidates.end(),
+                     [&rttOf](const Candidate &a, const Candidate &b) {
+                         return rttOf(a) < rttOf(b);
+                     });
+    for (auto &candidate : candidates)
+    {
+        auto rtt = rttOf(candidate);
+        if (rtt < unknown)
+        {
+            candidate.delay =
+                std::clamp(duration_cast<milliseconds>(rtt * 2),
+                           minAttemptDelay,
+                           defaultAttemptDelay);
+        }
+    }
+}
+
+/**
+ * @brief Connect to the candidates in order, starting the next attempt when
+ * the previous one has not succeeded within its delay or has failed.
+ *
+ * drogon's clients open connections of their own, so the winning one is
+ * closed too; what is kept is how long it took, and which attempts failed.
+ *
+ * @return The index of the first candidate that accepted, or -1.
+ */
+int race(const vector<Candidate> &candidates, DnsCache::Rtts &rtts)
+{
+    constexpr auto timeout = seconds(5);
+
+    struct Attempt
+    {
+        size_t index;
+        steady_clock::time_point startedAt;
+    };
+    vector<pollfd> fds;
+    vector<Attempt> attempts;
+    auto start = steady_clock::now();
+    auto nextStart = start;
+    size_t next = 0;
+    int winner = -1;
+    while (winner < 0)
+    {
+        auto now = steady_clock::now();
+        if (now - start >= timeout ||
+            (fds.empty() && next >= candidates.size()))
+        {
+            break;
+        }
+        if (next < candidates.size() && now >= nextStart)
+        {
+            const auto &candidate = candidates[next];
+            nextStart = now + candidate.delay;
+            int fd = socket(candidate.addr.ss_family,
+                            SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                            0);
+            if (fd >= 0 &&
+                connect(fd,
+                        reinterpret_cast<const sockaddr *>(&candidate.addr),
+                        candidate.len) == 0)
+            {
+                winner = next;
+                rtts[candidate.address] = duration_cast<microseconds>(
+                    steady_clock::now() - now);
+                close(fd);
+                break;
+            }
+            if (fd >= 0 && errno == EINPROGRESS)
+            {
+                fds.push_back({fd, POLLOUT, 0});
+                attempts.push_back({next, now});
+            }
+            else
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+                rtts[candidate.address] = microseconds::max();
+                nextStart = now;
+            }
+            ++next;
+            continue;
+        }
+
+        auto until = start + timeout;
+        if (next < candidates.size())
+        {
+            until = std::min(until, nextStart);
+        }
+        auto wait = duration_cast<milliseconds>(until - now).count();
+        if (poll(fds.data(), fds.size(), std::max<long>(wait, 0)) <= 0)
+        {
+            continue;
+        }
+        auto answeredAt = steady_clock::now();
+        for (size_t i = 0; i < fds.size();)
+        {
+            if (fds[i].revents == 0)
+            {
+                ++i;
+                continue;
+            }
+            const auto &address = candidates[attempts[i].index].address;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err == 0 && (fds[i].revents & POLLOUT))
+            {
+                winner = attempts[i].index;
+                rtts[address] = duration_cast<microseconds>(
+                    answeredAt - attempts[i].startedAt);
+                break;
+            }
+            rtts[address] = microseconds::max();
+            close(fds[i].fd);
+            fds.erase(fds.begin() + i);
+            attempts.erase(attempts.begin() + i);
+            // Do not wait for the delay once an attempt has failed
+            nextStart = answeredAt;
+        }
+    }
+    for (const auto &pfd : fds)
+    {
+        close(pfd.fd);
+    }
+    return winner;
+}
+
+}  // namespace
+
+DnsCache::DnsCache(double ttl,
+                   bool happyEyeballs,
+                   unordered_map<string, string> staticHosts,
+                   ChangeCallback onChange)
+    : ttl_(static_cast<long>(ttl * 1000)),
+      happyEyeballs_(happyEyeballs),
+      staticHosts_(std::move(staticHosts)),
+      onChange_(std::move(onChange))
+{
+    thread_ = std::thread([this]() { run(); });
+}
+
+DnsCache::~DnsCache()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+string DnsCache::lookup(const string &key, const string &host, uint16_t port)
+{
+    auto staticHost = staticHosts_.find(host);
+    if (staticHost != staticHosts_.end())
+    {
+        return staticHost->second;
+    }
+    lock_guard<mutex> lock(mutex_);
+    auto [iter, inserted] = entries_.try_emplace(key);
+    if (inserted)
+    {
+        iter->second.host = host;
+        iter->second.port = port;
+        iter->second.pending = true;
+        cv_.notify_one();
+    }
+    return iter->second.address;
+}
+
+string DnsCache::resolve(const string &host,
+                        uint16_t port,
+                        bool happyEyeballs,
+                        Rtts *rtts)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result{nullptr};
+    int err =
+        getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &result);
+    if (err != 0 || result == nullptr)
+    {
+        LOG_WARN << "failed to resolve " << host << ": " << gai_strerror(err);
+        return "";
+    }
+    vector<Candidate> v6;
+    vector<Candidate> v4;
+    for (auto ai = result; ai != nullptr; ai = ai->ai_next)
+    {
+        Candidate candidate{};
+        memcpy(&candidate.addr, ai->ai_addr, ai->ai_addrlen);
+        candidate.len = ai->ai_addrlen;
+        candidate.address = toString(candidate.addr);
+        candidate.delay = defaultAttemptDelay;
+        (ai->ai_family == AF_INET6 ? v6 : v4).push_back(std::move(candidate));
+    }
+    freeaddrinfo(result);
+
+    // Interleave the families, IPv6 first (RFC 8305, section 4)
+    vector<Candidate> candidates;
+    for (size_t i = 0; i < std::max(v6.size(), v4.size()); ++i)
+    {
+        if (i < v6.size())
+        {
+            candidates.push_back(v6[i]);
+        }
+        if (i < v4.size())
+        {
+            candidates.push_back(v4[i]);
+        }
+    }
+    if (candidates.empty())
+    {
+        return "";
+    }
+    // Only the addresses the host still has are remembered
+    Rtts measured;
+    if (rtts != nullptr)
+    {
+        sortByRtt(candidates, *rtts);
+        for (const auto &candidate : candidates)
+        {
+            auto iter = rtts->find(candidate.address);
+            if (iter != rtts->end())
+            {
+                measured.insert(*iter);
+            }
+        }
+    }
+    int chosen = 0;
+    if (happyEyeballs && candidates.size() > 1)
+    {
+        // If nothing answers, let the HttpClient report the error later
+        chosen = std::max(race(candidates, measured), 0);
+    }
+    if (rtts != nullptr)
+    {
+        *rtts = std::move(measured);
+    }
+    return candidates[chosen].address;
+}
+
+void DnsCache::run()
+{
+    unique_lock<mutex> lock(mutex_);
+    while (!stop_)
+    {
+        // Entries are refreshed when three quarters of the ttl have passed,
+        // so a pinned address never has to be resolved on the request path.
+        auto now = steady_clock::now();
+        auto wakeUp = now + ttl_;
+        vector<pair<string, Entry>> due;
+        for (auto &[key, entry] : entries_)
+        {
+            if (entry.pending || entry.refreshAt <= now)
+            {
+                entry.pending = true;
+                due.emplace_back(key, entry);
+            }
+            else
+            {
+                wakeUp = std::min(wakeUp, entry.refreshAt);
+            }
+        }
+        if (due.empty())
+        {
+            cv_.wait_until(lock, wakeUp);
+            continue;
+        }
+
+        lock.unlock();
+        for (auto &[key, entry] : due)
+        {
+            auto address =
+                resolve(entry.host, entry.port, happyEyeballs_, &entry.rtts);
+            update(key, address, std::move(entry.rtts));
+        }
+        lock.lock();
+    }
+}
+
+void DnsCache::update(const string &key, const string &address, Rtts &&rtts)
+{
+    bool changed{false};
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto &entry = entries_[key];
+        entry.pending = false;
+        entry.rtts = std::move(rtts);
+        if (address.empty())
+        {
+            // Keep the stale address and retry soon
+            entry.refreshAt =
+                steady_clock::now() + std::min<milliseconds>(ttl_, seconds(5));
+        }
+        else
+        {
+            entry.refreshAt = steady_clock::now() + ttl_ * 3 / 4;
+            changed = entry.address != address;
+            entry.address = address;
+        }
+    }
+    if (changed)
+    {
+        LOG_DEBUG << key << " is pinned to " << address;
+        if (onChange_)
+        {
+            onChange_(key);
+        }
+    }
+}
@@ -0,0 +1,120 @@
+/**
+ * @file DnsCache.h
+ * @brief Resolve upstream hosts once and pin the result for a while.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace tl::rest
+{
+
+/**
+ * @brief A resolver cache with static overrides and background refresh.
+ *
+ * Each entry pins one address of a `host:port`. When a host has several
+ * addresses, the address is picked by racing connections as Happy Eyeballs
+ * (RFC 8305) does: the next address is tried whenever the previous one has
+ * not answered within its attempt delay. The first race interleaves the
+ * families, IPv6 first, with a delay of 250ms. The connect times it measures
+ * order the addresses of the next races, fastest first and unreachable last,
+ * and shorten the delays, so that a refresh usually makes a single attempt.
+ *
+ * Lookups never block: a miss starts a resolution on the background thread
+ * and returns an empty string. Entries are refreshed before they expire, and
+ * the change callback is called, on the background thread, whenever the
+ * pinned address of an entry is set or changes.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class DnsCache
+{
+  public:
+    using ChangeCallback = std::function<void(const std::string &key)>;
+
+    /// Connect times by address, max() for the addresses that failed.
+    using Rtts = std::unordered_map<std::string, std::chrono::microseconds>;
+
+    /**
+     * @param ttl How long a resolved address is used, in seconds.
+     * @param happyEyeballs Race connections to pick the address, otherwise
+     * the first address returned by the resolver is used.
+     * @param staticHosts Host to address overrides, never resolved.
+     * @param onChange Called with the key of an entry whose address changes.
+     */
+    DnsCache(double ttl,
+             bool happyEyeballs,
+             std::unordered_map<std::string, std::string> staticHosts,
+             ChangeCallback onChange);
+    ~DnsCache();
+
+    DnsCache(const DnsCache &) = delete;
+    DnsCache &operator=(const DnsCache &) = delete;
+
+    /**
+     * @brief Get the pinned address of host:port.
+     *
+     * A miss is resolved on the background thread, so looking up the known
+     * hosts at start resolves them before the first calls.
+     *
+     * @param key Identifies the entry in the change callback.
+     * @return The numeric address, or an empty string if it is not resolved
+     * yet.
+     */
+    std::string lookup(const std::string &key,
+                       const std::string &host,
+                       uint16_t port);
+
+    /**
+     * @brief Resolve host and pick the address to connect to.
+     *
+     * @param rtts The connect times measured by the previous races of host,
+     * replaced by those of the addresses it has now.
+     * @return The numeric address, or an empty string on failure.
+     */
+    static std::string resolve(const std::string &host,
+                               uint16_t port,
+                               bool happyEyeballs,
+                               Rtts *rtts = nullptr);
+
+  private:
+    struct Entry
+    {
+        std::string host;
+        uint16_t port{0};
+        std::string address;
+        std::chrono::steady_clock::time_point refreshAt;
+        bool pending{false};
+        Rtts rtts;
+    };
+
+    void run();
+    void update(const std::string &key,
+                const std::string &address,
+                Rtts &&rtts);
+
+    const std::chrono::milliseconds ttl_;
+    const bool happyEyeballs_;
+    const std::unordered_map<std::string, std::string> staticHosts_;
+    const ChangeCallback onChange_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, Entry> entries_;
+    bool stop_{false};
+    std::thread thread_;
+};
+
+}  // namespace tl::rest
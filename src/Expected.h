@@ -0,0 +1,215 @@
+/**
+ * @file Expected.h
+ * @brief std::expected, or a small stand-in where the standard library does
+ * not provide it yet.
+ *
+ * The project is built as C++20, std::expected is part of C++23. The
+ * stand-in only has the members used by Muelsyse and its users:
+ * has_value(), operator bool, value(), error(), operator*, operator-> and
+ * value_or().
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <version>
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+
+#include <expected>
+
+namespace tl::rest
+{
+
+template <typename T, typename E>
+using Expected = std::expected<T, E>;
+
+template <typename E>
+using Unexpected = std::unexpected<E>;
+
+}  // namespace tl::rest
+
+#else
+
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+
+namespace tl::rest
+{
+
+/// Holds the error used to build an Expected.
+template <typename E>
+class Unexpected
+{
+  public:
+    explicit Unexpected(E error) : error_(std::move(error))
+    {
+    }
+
+    const E &error() const &
+    {
+        return error_;
+    }
+
+    E &&error() &&
+    {
+        return std::move(error_);
+    }
+
+  private:
+    E error_;
+};
+
+/// Thrown by value() when there is no value.
+class BadExpectedAccess : public std::logic_error
+{
+  public:
+    BadExpectedAccess() : std::logic_error("bad expected access")
+    {
+    }
+};
+
+/// Either a value of T or an error of E.
+template <typename T, typename E>
+class Expected
+{
+  public:
+    Expected() : data_(std::in_place_index<0>)
+    {
+    }
+
+    Expected(T value) : data_(std::in_place_index<0>, std::move(value))
+    {
+    }
+
+    Expected(Unexpected<E> error)
+        : data_(std::in_place_index<1>, std::move(error).error())
+    {
+    }
+
+    bool has_value() const noexcept
+    {
+        return data_.index() == 0;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return has_value();
+    }
+
+    T &value() &
+    {
+        check();
+        return std::get<0>(data_);
+    }
+
+    const T &value() const &
+    {
+        check();
+        return std::get<0>(data_);
+    }
+
+    T &&value() &&
+    {
+        check();
+        return std::get<0>(std::move(data_));
+    }
+
+    const E &error() const &
+    {
+        return std::get<1>(data_);
+    }
+
+    E &&error() &&
+    {
+        return std::get<1>(std::move(data_));
+    }
+
+    T &operator*() &
+    {
+        return std::get<0>(data_);
+    }
+
+    const T &operator*() const &
+    {
+        return std::get<0>(data_);
+    }
+
+    T *operator->()
+    {
+        return &std::get<0>(data_);
+    }
+
+    const T *operator->() const
+    {
+        return &std::get<0>(data_);
+    }
+
+    template <typename U>
+    T value_or(U &&other) const &
+    {
+        return has_value() ? **this : static_cast<T>(std::forward<U>(other));
+    }
+
+  private:
+    void check() const
+    {
+        if (!has_value())
+        {
+            throw BadExpectedAccess();
+        }
+    }
+
+    std::variant<T, E> data_;
+};
+
+/// Expected without a value, only success or an error.
+template <typename E>
+class Expected<void, E>
+{
+  public:
+    Expected() = default;
+
+    Expected(Unexpected<E> error) : error_(std::move(error).error())
+    {
+    }
+
+    bool has_value() const noexcept
+    {
+        return !error_.has_value();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return has_value();
+    }
+
+    void value() const
+    {
+        if (!has_value())
+        {
+            throw BadExpectedAccess();
+        }
+    }
+
+    const E &error() const &
+    {
+        return *error_;
+    }
+
+    E &&error() &&
+    {
+        return *std::move(error_);
+    }
+
+  private:
+    std::optional<E> error_;
+};
+
+}  // namespace tl::rest
+
+#endif
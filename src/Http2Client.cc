@@ -0,0 +1,249 @@
+#ifdef MUELSYSE_WITH_NGHTTP2
+
+#include "Http2Client.h"
+
+#include <drogon/utils/Utilities.h>
+#include <trantor/net/EventLoopThread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace drogon;
+using namespace tl::rest;
+
+namespace
+{
+
+/**
+ * @brief The threads the callbacks are called on, started on first use and
+ * handed out to the clients in turn. Nothing blocks on them.
+ */
+trantor::EventLoop *nextLoop()
+{
+    static std::vector<unique_ptr<trantor::EventLoopThread>> threads;
+    static std::once_flag started;
+    static std::atomic<size_t> next{0};
+    std::call_once(started, []() {
+        auto count = std::max(2u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < count; ++i)
+        {
+            threads.push_back(make_unique<trantor::EventLoopThread>("h2"));
+            threads.back()->run();
+        }
+    });
+    return threads[next++ % threads.size()]->getLoop();
+}
+
+/// Whether field only makes sense for an HTTP/1.1 connection, HTTP/2 does
+/// not allow it.
+bool isConnectionHeader(const string &field)
+{
+    return field == "connection" || field == "keep-alive" ||
+           field == "proxy-connection" || field == "transfer-encoding" ||
+           field == "upgrade" || field == "te";
+}
+
+/// The request of req, encoded like drogon's client does.
+Http2Request toHttp2Request(const HttpRequest &req, const string &authority)
+{
+    Http2Request request;
+    request.method = req.methodString();
+    request.authority = authority;
+    request.path = utils::urlEncode(req.path());
+    if (!req.query().empty())
+    {
+        request.path.append("?").append(req.query());
+    }
+    const auto &headers = req.headers();
+    request.headers.reserve(headers.size() + 2);
+    for (const auto &[field, value] : headers)
+    {
+        if (field == "host")
+        {
+            request.authority = value;
+        }
+        else if (!isConnectionHeader(field))
+        {
+            request.headers.emplace_back(field, value);
+        }
+    }
+    if (headers.find("content-type") == headers.end() &&
+        req.contentType() == CT_APPLICATION_JSON)
+    {
+        request.headers.emplace_back("content-type", "application/json");
+    }
+    request.body = req.body();
+    if (!request.body.empty())
+    {
+        request.headers.emplace_back("content-length",
+                                     std::to_string(request.body.size()));
+    }
+    return request;
+}
+
+/// Build a response from what was received, as drogon's client would.
+HttpResponsePtr toResponse(Http2Response &&response)
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(static_cast<HttpStatusCode>(response.status));
+    for (auto &[field, value] : response.headers)
+    {
+        // The body has its length already
+        if (field != "content-length")
+        {
+            resp->addHeader(std::move(field), std::move(value));
+        }
+    }
+    resp->setBody(std::move(response.body));
+    return resp;
+}
+
+ReqResult toReqResult(Http2Result result)
+{
+    switch (result)
+    {
+        case Http2Result::Ok:
+            return ReqResult::Ok;
+        case Http2Result::BadServerAddress:
+            return ReqResult::BadServerAddress;
+        case Http2Result::Timeout:
+            return ReqResult::Timeout;
+        default:
+            return ReqResult::NetworkFailure;
+    }
+}
+
+}  // namespace
+
+Http2Client::Http2Client(const string &url, bool validateCert)
+    : loop_(nextLoop())
+{
+    target_.tls = url.starts_with("https://");
+    target_.port = target_.tls ? 443 : 80;
+    target_.validateCert = validateCert;
+    auto schemeEnd = url.find("://");
+    authority_ = schemeEnd == string::npos ? url : url.substr(schemeEnd + 3);
+    string_view host = authority_;
+    size_t portStart = string::npos;
+    if (host.starts_with('['))
+    {
+        auto close = host.find(']');
+        if (close != string::npos && close + 1 < host.size() &&
+            host[close + 1] == ':')
+        {
+            portStart = close + 2;
+        }
+        host = host.substr(1, close - 1);
+    }
+    else if (auto colon = host.rfind(':'); colon != string::npos)
+    {
+        portStart = colon + 1;
+        host = host.substr(0, colon);
+    }
+    if (portStart != string::npos)
+    {
+        target_.port =
+            static_cast<uint16_t>(std::stoul(authority_.substr(portStart)));
+    }
+    target_.host = host;
+}
+
+Http2Client::~Http2Client()
+{
+    // In-flight requests are completed, then the thread stops
+    if (connection_)
+    {
+        connection_->close();
+    }
+}
+
+Http2Connection &Http2Client::connection()
+{
+    std::call_once(startOnce_, [this]() {
+        connection_ = Http2Connection::create(target_);
+        connection_->setSocketCallback(std::move(sockOptCallback_));
+        started_ = connection_.get();
+    });
+    return *connection_;
+}
+
+trantor::EventLoop *Http2Client::getLoop()
+{
+    return loop_;
+}
+
+size_t Http2Client::bytesSent() const
+{
+    auto *connection = started_.load();
+    return connection == nullptr ? 0 : connection->bytesSent();
+}
+
+size_t Http2Client::bytesReceived() const
+{
+    auto *connection = started_.load();
+    return connection == nullptr ? 0 : connection->bytesReceived();
+}
+
+size_t Http2Client::fullHandshakes() const
+{
+    auto *connection = started_.load();
+    return connection == nullptr ? 0 : connection->fullHandshakes();
+}
+
+size_t Http2Client::resumedHandshakes() const
+{
+    auto *connection = started_.load();
+    return connection == nullptr ? 0 : connection->resumedHandshakes();
+}
+
+void Http2Client::setCertPath(const string &cert, const string &key)
+{
+    target_.certFile = cert;
+    target_.keyFile = key;
+}
+
+void Http2Client::addSSLConfigs(
+    const std::vector<std::pair<string, string>> &sslConfs)
+{
+    target_.sslConfigs.insert(
+        target_.sslConfigs.end(), sslConfs.begin(), sslConfs.end());
+}
+
+void Http2Client::setSockOptCallback(function<void(int)> callback)
+{
+    sockOptCallback_ = std::move(callback);
+}
+
+void Http2Client::sendRequest(const HttpRequestPtr &req,
+                              const HttpReqCallback &callback,
+                              double timeout)
+{
+    sendRequest(req, HttpReqCallback(callback), timeout);
+}
+
+void Http2Client::sendRequest(const HttpRequestPtr &req,
+                              HttpReqCallback &&callback,
+                              double timeout)
+{
+    connection().submit(
+        toHttp2Request(*req, authority_),
+        timeout,
+        [loop = loop_, callback = std::move(callback)](
+            Http2Result result, Http2Response &&response) mutable {
+            HttpResponsePtr resp;
+            if (result == Http2Result::Ok)
+            {
+                resp = toResponse(std::move(response));
+            }
+            loop->queueInLoop([callback = std::move(callback),
+                               result = toReqResult(result),
+                               resp = std::move(resp)]() {
+                callback(result, resp);
+            });
+        });
+}
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * @file Http2Client.h
+ * @brief Call hosts over HTTP/2, configured with `protocol: h2`.
+ *
+ * Many concurrent calls share one connection as streams of their own, so a
+ * slow response does not hold up the others. Only built with
+ * MUELSYSE_WITH_NGHTTP2.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include "Http2Connection.h"
+
+#include <drogon/HttpClient.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace tl::rest
+{
+
+/**
+ * @brief An HttpClient that multiplexes its requests over one HTTP/2
+ * connection.
+ *
+ * http:// urls speak h2c with prior knowledge, https:// urls negotiate h2
+ * with ALPN and fail against servers that only speak HTTP/1.1. Several
+ * clients of the same host give several connections, see
+ * connections_per_host.
+ *
+ * The connection runs on a thread of its own, the callbacks are called on
+ * getLoop(). As with drogon's client, the TLS settings and the socket
+ * callback are set before the first request, and the timeout covers the
+ * whole call. Cookies are not kept.
+ *
+ * The Content-Type sent is the Content-Type header of the request if it has
+ * one, otherwise application/json for JSON bodies.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class Http2Client : public drogon::HttpClient
+{
+  public:
+    /// url is scheme://host[:port], like drogon's newHttpClient takes.
+    explicit Http2Client(const std::string &url, bool validateCert = true);
+    ~Http2Client() override;
+
+    void sendRequest(const drogon::HttpRequestPtr &req,
+                     const drogon::HttpReqCallback &callback,
+                     double timeout = 0) override;
+    void sendRequest(const drogon::HttpRequestPtr &req,
+                     drogon::HttpReqCallback &&callback,
+                     double timeout = 0) override;
+
+    /// Requests never wait for each other, each is a stream.
+    void setPipeliningDepth(size_t) override
+    {
+    }
+
+    void enableCookies(bool = true) override
+    {
+    }
+
+    void addCookie(const std::string &, const std::string &) override
+    {
+    }
+
+    void addCookie(const drogon::Cookie &) override
+    {
+    }
+
+    void setUserAgent(const std::string &) override
+    {
+    }
+
+    trantor::EventLoop *getLoop() override;
+
+    size_t bytesSent() const override;
+    size_t bytesReceived() const override;
+
+    /// See Http2Connection::fullHandshakes().
+    size_t fullHandshakes() const;
+    /// See Http2Connection::resumedHandshakes().
+    size_t resumedHandshakes() const;
+
+    std::string host() const override
+    {
+        return target_.host;
+    }
+
+    uint16_t port() const override
+    {
+        return target_.port;
+    }
+
+    bool secure() const override
+    {
+        return target_.tls;
+    }
+
+    void setCertPath(const std::string &cert, const std::string &key) override;
+    void addSSLConfigs(
+        const std::vector<std::pair<std::string, std::string>> &sslConfs)
+        override;
+
+    /// Called with each new socket.
+    void setSockOptCallback(std::function<void(int)> callback) override;
+
+  private:
+    /// The connection, started by the first request.
+    Http2Connection &connection();
+
+    Http2Target target_;
+    /// Sent as :authority when the request has no Host header.
+    std::string authority_;
+    std::function<void(int)> sockOptCallback_;
+    trantor::EventLoop *loop_;
+    std::once_flag startOnce_;
+    std::shared_ptr<Http2Connection> connection_;
+    /// connection_ once it is set, for the counters.
+    std::atomic<Http2Connection *> started_{nullptr};
+};
+
+}  // namespace tl::rest
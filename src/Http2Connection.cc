@@ -0,0 +1,931 @@
+#ifdef MUELSYSE_WITH_NGHTTP2
+
+#include "Http2Connection.h"
+
+#include <trantor/utils/Logger.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <nghttp2/nghttp2.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+using namespace tl::rest;
+
+/// The receive windows, nghttp2 sends WINDOW_UPDATE as the data is consumed.
+static constexpr int32_t kStreamWindow = 1 << 20;
+static constexpr int32_t kConnectionWindow = 1 << 24;
+/// How many times an unprocessed request is sent before it fails.
+static constexpr int kMaxAttempts = 3;
+/// How much is serialized before it is written.
+static constexpr size_t kOutputChunk = 64 * 1024;
+
+struct Http2Connection::Stream
+{
+    Http2Request request;
+    Http2Callback callback;
+    Clock::time_point deadline{Clock::time_point::max()};
+    Http2Response response;
+    size_t bodyOffset{0};
+    /// Its HEADERS frame has been serialized, the server may have it.
+    bool sent{false};
+    int attempts{0};
+};
+
+namespace tl::rest
+{
+
+struct Http2Callbacks
+{
+    static Http2Connection::Stream *find(void *self, int32_t id)
+    {
+        auto &streams = static_cast<Http2Connection *>(self)->streams_;
+        auto iter = streams.find(id);
+        return iter == streams.end() ? nullptr : iter->second.get();
+    }
+
+    static int onHeader(nghttp2_session *,
+                        const nghttp2_frame *frame,
+                        const uint8_t *name,
+                        size_t nameLength,
+                        const uint8_t *value,
+                        size_t valueLength,
+                        uint8_t,
+                        void *self)
+    {
+        auto *stream = find(self, frame->hd.stream_id);
+        if (frame->hd.type != NGHTTP2_HEADERS || stream == nullptr)
+        {
+            return 0;
+        }
+        string_view field(reinterpret_cast<const char *>(name), nameLength);
+        string_view text(reinterpret_cast<const char *>(value), valueLength);
+        auto &response = stream->response;
+        if (field == ":status")
+        {
+            // A final status replaces the headers of interim responses
+            std::from_chars(
+                text.data(), text.data() + text.size(), response.status);
+            response.headers.clear();
+        }
+        else if (!field.starts_with(':'))
+        {
+            response.headers.emplace_back(field, text);
+        }
+        return 0;
+    }
+
+    static int onData(nghttp2_session *,
+                      uint8_t,
+                      int32_t id,
+                      const uint8_t *data,
+                      size_t length,
+                      void *self)
+    {
+        if (auto *stream = find(self, id))
+        {
+            stream->response.body.append(reinterpret_cast<const char *>(data),
+                                         length);
+        }
+        return 0;
+    }
+
+    static int onFrameSend(nghttp2_session *,
+                           const nghttp2_frame *frame,
+                           void *self)
+    {
+        auto *stream = find(self, frame->hd.stream_id);
+        if (frame->hd.type == NGHTTP2_HEADERS && stream != nullptr)
+        {
+            stream->sent = true;
+        }
+        return 0;
+    }
+
+    static int onStreamClose(nghttp2_session *,
+                             int32_t id,
+                             uint32_t errorCode,
+                             void *self)
+    {
+        auto *connection = static_cast<Http2Connection *>(self);
+        auto iter = connection->streams_.find(id);
+        // Streams that timed out are gone already
+        if (iter == connection->streams_.end())
+        {
+            return 0;
+        }
+        auto stream = std::move(iter->second);
+        connection->streams_.erase(iter);
+        if (errorCode == NGHTTP2_NO_ERROR && stream->response.status != 0)
+        {
+            connection->complete(std::move(stream), Http2Result::Ok);
+            return 0;
+        }
+        // The streams after the last one of a GOAWAY are refused as well
+        bool unprocessed =
+            !stream->sent || errorCode == NGHTTP2_REFUSED_STREAM;
+        connection->retryOrFail(std::move(stream), unprocessed);
+        return 0;
+    }
+
+    static ssize_t readBody(nghttp2_session *,
+                            int32_t id,
+                            uint8_t *buffer,
+                            size_t length,
+                            uint32_t *flags,
+                            nghttp2_data_source *,
+                            void *self)
+    {
+        auto *stream = find(self, id);
+        if (stream == nullptr)
+        {
+            return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
+        }
+        const auto &body = stream->request.body;
+        auto size = std::min(length, body.size() - stream->bodyOffset);
+        memcpy(buffer, body.data() + stream->bodyOffset, size);
+        stream->bodyOffset += size;
+        if (stream->bodyOffset == body.size())
+        {
+            *flags |= NGHTTP2_DATA_FLAG_EOF;
+        }
+        return static_cast<ssize_t>(size);
+    }
+};
+
+}  // namespace tl::rest
+
+/**
+ * @brief Wait until fd is ready for events, or the deadline.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static bool waitFor(int fd,
+                    short events,
+                    std::chrono::steady_clock::time_point deadline)
+{
+    while (true)
+    {
+        int timeout = -1;
+        if (deadline != std::chrono::steady_clock::time_point::max())
+        {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
+            {
+                return false;
+            }
+            timeout = static_cast<int>(left.count());
+        }
+        pollfd ready{fd, events, 0};
+        auto count = ::poll(&ready, 1, timeout);
+        if (count > 0)
+        {
+            return true;
+        }
+        if (count == 0 || errno != EINTR)
+        {
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief The last TLS session of each target, which new connections to it
+ * resume instead of making a full handshake. Shared by the connections of
+ * a host, and never destroyed, since their threads may outlive main.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class SessionCache
+{
+  public:
+    static SessionCache &instance()
+    {
+        static auto *cache = new SessionCache;
+        return *cache;
+    }
+
+    /// The session to resume for key, or nullptr; the caller frees it.
+    SSL_SESSION *get(const string &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = sessions_.find(key);
+        if (iter == sessions_.end())
+        {
+            return nullptr;
+        }
+        SSL_SESSION_up_ref(iter->second);
+        return iter->second;
+    }
+
+    /// Keep session for key in place of the previous one, taking its
+    /// reference.
+    void put(const string &key, SSL_SESSION *session)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &stored = sessions_[key];
+        if (stored != nullptr)
+        {
+            SSL_SESSION_free(stored);
+        }
+        stored = session;
+    }
+
+  private:
+    std::mutex mutex_;
+    std::unordered_map<string, SSL_SESSION *> sessions_;
+};
+
+/**
+ * @brief The key of the sessions of target: a session is only resumed with
+ * the same host and the same settings.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static string sessionKey(const Http2Target &target)
+{
+    auto key = target.host + ":" + std::to_string(target.port) + "|" +
+               (target.validateCert ? "1" : "0") + "|" + target.certFile +
+               "|" + target.keyFile;
+    for (const auto &[command, value] : target.sslConfigs)
+    {
+        key.append("|").append(command).append("=").append(value);
+    }
+    return key;
+}
+
+/**
+ * @brief Called by OpenSSL with each session the server hands out, after
+ * the handshake with TLS 1.3. The key of the connection is the app data of
+ * ssl.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static int onNewSession(SSL *ssl, SSL_SESSION *session)
+{
+    const auto *key = static_cast<const string *>(SSL_get_app_data(ssl));
+    if (key == nullptr || !SSL_SESSION_is_resumable(session))
+    {
+        return 0;
+    }
+    SessionCache::instance().put(*key, session);
+    // The cache holds the reference now
+    return 1;
+}
+
+/**
+ * @brief The TLS settings of target, offering h2 only.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static SSL_CTX *newSslContext(const Http2Target &target)
+{
+    auto *context = SSL_CTX_new(TLS_client_method());
+    if (context == nullptr)
+    {
+        return nullptr;
+    }
+    // HTTP/2 forbids older versions
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    SSL_CTX_set_mode(context,
+                     SSL_MODE_ENABLE_PARTIAL_WRITE |
+                         SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    static const unsigned char protocols[] = {2, 'h', '2'};
+    SSL_CTX_set_alpn_protos(context, protocols, sizeof(protocols));
+    // The sessions go to SessionCache, OpenSSL does not resume on its own
+    SSL_CTX_set_session_cache_mode(
+        context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(context, &onNewSession);
+    if (target.validateCert)
+    {
+        SSL_CTX_set_default_verify_paths(context);
+        SSL_CTX_set_verify(context, SSL_VERIFY_PEER, nullptr);
+    }
+    if (!target.certFile.empty() &&
+        (SSL_CTX_use_certificate_chain_file(context,
+                                            target.certFile.c_str()) != 1 ||
+         SSL_CTX_use_PrivateKey_file(context,
+                                     target.keyFile.c_str(),
+                                     SSL_FILETYPE_PEM) != 1))
+    {
+        LOG_ERROR << "cannot load the client certificate " << target.certFile;
+        SSL_CTX_free(context);
+        return nullptr;
+    }
+    if (!target.sslConfigs.empty())
+    {
+        auto *commands = SSL_CONF_CTX_new();
+        SSL_CONF_CTX_set_flags(commands,
+                               SSL_CONF_FLAG_FILE | SSL_CONF_FLAG_CLIENT |
+                                   SSL_CONF_FLAG_CERTIFICATE);
+        SSL_CONF_CTX_set_ssl_ctx(commands, context);
+        for (const auto &[command, value] : target.sslConfigs)
+        {
+            if (SSL_CONF_cmd(commands, command.c_str(), value.c_str()) <= 0)
+            {
+                LOG_ERROR << "cannot apply the ssl config " << command;
+            }
+        }
+        SSL_CONF_CTX_finish(commands);
+        SSL_CONF_CTX_free(commands);
+    }
+    return context;
+}
+
+shared_ptr<Http2Connection> Http2Connection::create(Http2Target target)
+{
+    shared_ptr<Http2Connection> connection(
+        new Http2Connection(std::move(target)));
+    std::thread([connection]() { connection->run(); }).detach();
+    return connection;
+}
+
+Http2Connection::Http2Connection(Http2Target target)
+    : target_(std::move(target)),
+      sessionKey_(target_.tls ? sessionKey(target_) : string())
+{
+    if (::pipe2(wakeFds_, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "pipe2");
+    }
+}
+
+Http2Connection::~Http2Connection()
+{
+    disconnect();
+    if (sslContext_ != nullptr)
+    {
+        SSL_CTX_free(sslContext_);
+    }
+    ::close(wakeFds_[0]);
+    ::close(wakeFds_[1]);
+}
+
+void Http2Connection::setSocketCallback(function<void(int)> callback)
+{
+    socketCallback_ = std::move(callback);
+}
+
+void Http2Connection::submit(Http2Request &&request,
+                             double timeout,
+                             Http2Callback &&callback)
+{
+    auto stream = make_unique<Stream>();
+    stream->request = std::move(request);
+    stream->callback = std::move(callback);
+    if (timeout > 0)
+    {
+        stream->deadline =
+            Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double>(timeout));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.push_back(std::move(stream));
+    }
+    if (!woken_.exchange(true))
+    {
+        char byte = 0;
+        [[maybe_unused]] auto written = ::write(wakeFds_[1], &byte, 1);
+    }
+}
+
+void Http2Connection::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    if (!woken_.exchange(true))
+    {
+        char byte = 0;
+        [[maybe_unused]] auto written = ::write(wakeFds_[1], &byte, 1);
+    }
+}
+
+void Http2Connection::run()
+{
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &stream : queued_)
+            {
+                waiting_.push_back(std::move(stream));
+            }
+            queued_.clear();
+            if (closing_ && waiting_.empty() && streams_.empty())
+            {
+                break;
+            }
+        }
+        auto deadline = expire();
+        if (session_ == nullptr && !waiting_.empty() && !connect())
+        {
+            for (auto &stream : waiting_)
+            {
+                complete(std::move(stream), Http2Result::BadServerAddress);
+            }
+            waiting_.clear();
+        }
+        if (session_ != nullptr)
+        {
+            submitWaiting();
+            if (!flush())
+            {
+                disconnect();
+            }
+            else if (!nghttp2_session_want_read(session_) &&
+                     !nghttp2_session_want_write(session_) &&
+                     outputOffset_ == output_.size())
+            {
+                // Done with GOAWAY, what waits goes on a new connection
+                disconnect();
+            }
+        }
+        runCallbacks();
+        if (session_ == nullptr && !waiting_.empty())
+        {
+            continue;
+        }
+
+        pollfd fds[2]{{wakeFds_[0], POLLIN, 0}, {fd_, POLLIN, 0}};
+        nfds_t count = session_ == nullptr ? 1 : 2;
+        if (outputOffset_ < output_.size() || sslWantsWrite_)
+        {
+            fds[1].events |= POLLOUT;
+        }
+        int timeout = -1;
+        if (deadline != Clock::time_point::max())
+        {
+            timeout = static_cast<int>(std::max<int64_t>(
+                0,
+                std::chrono::ceil<std::chrono::milliseconds>(deadline -
+                                                             Clock::now())
+                    .count()));
+        }
+        if (::poll(fds, count, timeout) < 0)
+        {
+            continue;
+        }
+        if (fds[0].revents != 0)
+        {
+            woken_ = false;
+            char buffer[64];
+            while (::read(wakeFds_[0], buffer, sizeof(buffer)) > 0)
+            {
+            }
+        }
+        if (count == 2 && fds[1].revents != 0 && !receive())
+        {
+            disconnect();
+        }
+        runCallbacks();
+    }
+    disconnect();
+    runCallbacks();
+}
+
+bool Http2Connection::connect()
+{
+    auto deadline = Clock::time_point::max();
+    for (const auto &stream : waiting_)
+    {
+        deadline = std::min(deadline, stream->deadline);
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    auto port = std::to_string(target_.port);
+    auto error =
+        getaddrinfo(target_.host.c_str(), port.c_str(), &hints, &addresses);
+    if (error != 0)
+    {
+        LOG_DEBUG << "cannot resolve " << target_.host << ": "
+                  << gai_strerror(error);
+        return false;
+    }
+    for (auto *address = addresses; address != nullptr && fd_ < 0;
+         address = address->ai_next)
+    {
+        fd_ = ::socket(address->ai_family,
+                       SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                       0);
+        if (fd_ < 0)
+        {
+            continue;
+        }
+        if (socketCallback_)
+        {
+            socketCallback_(fd_);
+        }
+        int on = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        int result = ::connect(fd_, address->ai_addr, address->ai_addrlen);
+        if (result != 0 && errno == EINPROGRESS &&
+            waitFor(fd_, POLLOUT, deadline))
+        {
+            socklen_t length = sizeof(result);
+            getsockopt(fd_, SOL_SOCKET, SO_ERROR, &result, &length);
+        }
+        if (result != 0)
+        {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd_ < 0)
+    {
+        LOG_DEBUG << "cannot connect to " << target_.host << ":"
+                  << target_.port;
+        return false;
+    }
+    if ((target_.tls && !handshake(deadline)) || !startSession())
+    {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+bool Http2Connection::handshake(Clock::time_point deadline)
+{
+    if (sslContext_ == nullptr)
+    {
+        sslContext_ = newSslContext(target_);
+        if (sslContext_ == nullptr)
+        {
+            return false;
+        }
+    }
+    ssl_ = SSL_new(sslContext_);
+    if (ssl_ == nullptr)
+    {
+        return false;
+    }
+    SSL_set_fd(ssl_, fd_);
+    SSL_set_app_data(ssl_, &sessionKey_);
+    if (auto *session = SessionCache::instance().get(sessionKey_))
+    {
+        SSL_set_session(ssl_, session);
+        SSL_SESSION_free(session);
+    }
+    in6_addr address;
+    bool literal = inet_pton(AF_INET, target_.host.c_str(), &address) == 1 ||
+                   inet_pton(AF_INET6, target_.host.c_str(), &address) == 1;
+    if (!literal)
+    {
+        SSL_set_tlsext_host_name(ssl_, target_.host.c_str());
+    }
+    if (target_.validateCert)
+    {
+        if (literal)
+        {
+            X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl_),
+                                          target_.host.c_str());
+        }
+        else
+        {
+            SSL_set1_host(ssl_, target_.host.c_str());
+        }
+    }
+    while (true)
+    {
+        auto result = SSL_connect(ssl_);
+        if (result == 1)
+        {
+            break;
+        }
+        auto error = SSL_get_error(ssl_, result);
+        if ((error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) ||
+            !waitFor(fd_,
+                     error == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT,
+                     deadline))
+        {
+            LOG_DEBUG << "tls handshake with " << target_.host << " failed";
+            return false;
+        }
+    }
+    if (SSL_session_reused(ssl_))
+    {
+        ++resumedHandshakes_;
+    }
+    else
+    {
+        ++fullHandshakes_;
+    }
+    const unsigned char *protocol = nullptr;
+    unsigned length = 0;
+    SSL_get0_alpn_selected(ssl_, &protocol, &length);
+    if (length != 2 || memcmp(protocol, "h2", 2) != 0)
+    {
+        LOG_WARN << target_.host << ":" << target_.port
+                 << " does not speak h2";
+        return false;
+    }
+    return true;
+}
+
+bool Http2Connection::startSession()
+{
+    nghttp2_session_callbacks *callbacks;
+    if (nghttp2_session_callbacks_new(&callbacks) != 0)
+    {
+        return false;
+    }
+    nghttp2_session_callbacks_set_on_header_callback(callbacks,
+                                                     &Http2Callbacks::onHeader);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(
+        callbacks, &Http2Callbacks::onData);
+    nghttp2_session_callbacks_set_on_frame_send_callback(
+        callbacks, &Http2Callbacks::onFrameSend);
+    nghttp2_session_callbacks_set_on_stream_close_callback(
+        callbacks, &Http2Callbacks::onStreamClose);
+    auto result = nghttp2_session_client_new(&session_, callbacks, this);
+    nghttp2_session_callbacks_del(callbacks);
+    if (result != 0)
+    {
+        session_ = nullptr;
+        return false;
+    }
+    nghttp2_settings_entry settings[] = {
+        {NGHTTP2_SETTINGS_ENABLE_PUSH, 0},
+        {NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, kStreamWindow},
+    };
+    nghttp2_submit_settings(
+        session_, NGHTTP2_FLAG_NONE, settings, std::size(settings));
+    nghttp2_session_set_local_window_size(
+        session_, NGHTTP2_FLAG_NONE, 0, kConnectionWindow);
+    return true;
+}
+
+void Http2Connection::disconnect()
+{
+    for (auto &[id, stream] : streams_)
+    {
+        bool unprocessed = !stream->sent;
+        retryOrFail(std::move(stream), unprocessed);
+    }
+    streams_.clear();
+    if (session_ != nullptr)
+    {
+        nghttp2_session_del(session_);
+        session_ = nullptr;
+    }
+    if (ssl_ != nullptr)
+    {
+        SSL_free(ssl_);
+        ssl_ = nullptr;
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    output_.clear();
+    outputOffset_ = 0;
+    sslWantsWrite_ = false;
+}
+
+void Http2Connection::submitWaiting()
+{
+    string_view scheme = target_.tls ? "https" : "http";
+    std::vector<nghttp2_nv> headers;
+    // Nothing is sent after a GOAWAY, those wait for the next connection
+    while (!waiting_.empty() && nghttp2_session_check_request_allowed(session_))
+    {
+        auto stream = std::move(waiting_.front());
+        waiting_.pop_front();
+        const auto &request = stream->request;
+        headers.clear();
+        auto add = [&headers](string_view name, string_view value) {
+            headers.push_back(
+                {reinterpret_cast<uint8_t *>(const_cast<char *>(name.data())),
+                 reinterpret_cast<uint8_t *>(const_cast<char *>(value.data())),
+                 name.size(),
+                 value.size(),
+                 NGHTTP2_NV_FLAG_NONE});
+        };
+        add(":method", request.method);
+        add(":scheme", scheme);
+        add(":authority", request.authority);
+        add(":path", request.path);
+        for (const auto &[name, value] : request.headers)
+        {
+            add(name, value);
+        }
+        nghttp2_data_provider body{};
+        body.read_callback = &Http2Callbacks::readBody;
+        auto id = nghttp2_submit_request(session_,
+                                         nullptr,
+                                         headers.data(),
+                                         headers.size(),
+                                         request.body.empty() ? nullptr
+                                                              : &body,
+                                         nullptr);
+        if (id < 0)
+        {
+            LOG_DEBUG << "cannot submit a request to " << target_.host << ": "
+                      << nghttp2_strerror(id);
+            complete(std::move(stream), Http2Result::NetworkFailure);
+            continue;
+        }
+        streams_.emplace(id, std::move(stream));
+    }
+}
+
+bool Http2Connection::flush()
+{
+    while (true)
+    {
+        if (outputOffset_ == output_.size())
+        {
+            output_.clear();
+            outputOffset_ = 0;
+            // Small frames are written together
+            while (output_.size() < kOutputChunk)
+            {
+                const uint8_t *data;
+                auto size = nghttp2_session_mem_send(session_, &data);
+                if (size < 0)
+                {
+                    LOG_DEBUG << "http2 session with " << target_.host
+                              << " failed: " << nghttp2_strerror(size);
+                    return false;
+                }
+                if (size == 0)
+                {
+                    break;
+                }
+                output_.append(reinterpret_cast<const char *>(data), size);
+            }
+            if (output_.empty())
+            {
+                return true;
+            }
+        }
+        auto written = writeSome(
+            reinterpret_cast<const uint8_t *>(output_.data()) + outputOffset_,
+            output_.size() - outputOffset_);
+        if (written <= 0)
+        {
+            return written == 0;
+        }
+        outputOffset_ += written;
+        bytesSent_ += written;
+    }
+}
+
+bool Http2Connection::receive()
+{
+    sslWantsWrite_ = false;
+    uint8_t buffer[16 * 1024];
+    while (true)
+    {
+        auto size = readSome(buffer, sizeof(buffer));
+        if (size <= 0)
+        {
+            return size == 0;
+        }
+        bytesReceived_ += size;
+        auto result = nghttp2_session_mem_recv(session_, buffer, size);
+        if (result < 0)
+        {
+            LOG_DEBUG << "http2 session with " << target_.host
+                      << " failed: " << nghttp2_strerror(result);
+            return false;
+        }
+    }
+}
+
+Http2Connection::Clock::time_point Http2Connection::expire()
+{
+    auto now = Clock::now();
+    auto next = Clock::time_point::max();
+    for (auto iter = waiting_.begin(); iter != waiting_.end();)
+    {
+        if ((*iter)->deadline <= now)
+        {
+            complete(std::move(*iter), Http2Result::Timeout);
+            iter = waiting_.erase(iter);
+            continue;
+        }
+        next = std::min(next, (*iter)->deadline);
+        ++iter;
+    }
+    for (auto iter = streams_.begin(); iter != streams_.end();)
+    {
+        if (iter->second->deadline <= now)
+        {
+            nghttp2_submit_rst_stream(
+                session_, NGHTTP2_FLAG_NONE, iter->first, NGHTTP2_CANCEL);
+            complete(std::move(iter->second), Http2Result::Timeout);
+            iter = streams_.erase(iter);
+            continue;
+        }
+        next = std::min(next, iter->second->deadline);
+        ++iter;
+    }
+    return next;
+}
+
+long Http2Connection::readSome(uint8_t *data, size_t size)
+{
+    if (ssl_ != nullptr)
+    {
+        auto result = SSL_read(ssl_, data, static_cast<int>(size));
+        if (result > 0)
+        {
+            return result;
+        }
+        auto error = SSL_get_error(ssl_, result);
+        sslWantsWrite_ = error == SSL_ERROR_WANT_WRITE;
+        return error == SSL_ERROR_WANT_READ || sslWantsWrite_ ? 0 : -1;
+    }
+    auto result = ::recv(fd_, data, size, 0);
+    if (result > 0)
+    {
+        return result;
+    }
+    return result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                          errno == EINTR)
+               ? 0
+               : -1;
+}
+
+long Http2Connection::writeSome(const uint8_t *data, size_t size)
+{
+    if (ssl_ != nullptr)
+    {
+        auto result = SSL_write(ssl_, data, static_cast<int>(size));
+        if (result > 0)
+        {
+            return result;
+        }
+        auto error = SSL_get_error(ssl_, result);
+        return error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE
+                   ? 0
+                   : -1;
+    }
+    auto result = ::send(fd_, data, size, MSG_NOSIGNAL);
+    if (result >= 0)
+    {
+        return result;
+    }
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+}
+
+void Http2Connection::retryOrFail(unique_ptr<Stream> stream, bool unprocessed)
+{
+    if (unprocessed && ++stream->attempts < kMaxAttempts)
+    {
+        stream->response = {};
+        stream->bodyOffset = 0;
+        stream->sent = false;
+        waiting_.push_front(std::move(stream));
+        return;
+    }
+    complete(std::move(stream), Http2Result::NetworkFailure);
+}
+
+void Http2Connection::complete(unique_ptr<Stream> stream, Http2Result result)
+{
+    completed_.emplace_back(std::move(stream), result);
+}
+
+void Http2Connection::runCallbacks()
+{
+    auto completed = std::move(completed_);
+    completed_.clear();
+    for (auto &[stream, result] : completed)
+    {
+        stream->callback(result, std::move(stream->response));
+    }
+}
+
+#endif
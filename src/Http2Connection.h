@@ -0,0 +1,256 @@
+/**
+ * @file Http2Connection.h
+ * @brief An HTTP/2 client connection, on nghttp2, that carries many requests
+ * at once.
+ *
+ * Only built with MUELSYSE_WITH_NGHTTP2.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct nghttp2_session;
+struct ssl_ctx_st;
+struct ssl_st;
+
+namespace tl::rest
+{
+
+/**
+ * @brief Where an Http2Connection connects to, and how.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct Http2Target
+{
+    /// A host name or an address, without brackets.
+    std::string host;
+    uint16_t port{80};
+    /// h2 over TLS, negotiated with ALPN. Otherwise h2c with prior
+    /// knowledge: the connection starts with HTTP/2, without an upgrade.
+    bool tls{false};
+    /// Verify the certificate chain and the host name of the server.
+    bool validateCert{true};
+    /// The client certificate and its key, for mutual TLS.
+    std::string certFile;
+    std::string keyFile;
+    /// OpenSSL SSL_CONF commands, such as `{"VerifyCAFile", "ca.pem"}`.
+    std::vector<std::pair<std::string, std::string>> sslConfigs;
+};
+
+/**
+ * @brief A request, with the :authority and :path pseudo-headers.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct Http2Request
+{
+    std::string method;
+    std::string authority;
+    /// The path with its query, encoded.
+    std::string path;
+    /// Lower case names, without the headers of HTTP/1.1 connections.
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+};
+
+/**
+ * @brief A complete response.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct Http2Response
+{
+    int status{0};
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+};
+
+/**
+ * @brief How a request ended.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+enum class Http2Result
+{
+    Ok,
+    /// No connection could be made.
+    BadServerAddress,
+    NetworkFailure,
+    Timeout,
+};
+
+/**
+ * @brief Called once per request, on the thread of the connection.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+using Http2Callback = std::function<void(Http2Result, Http2Response &&)>;
+
+/**
+ * @brief One HTTP/2 connection to a host, which every request is a stream
+ * of.
+ *
+ * A thread of its own connects on the first request, sends and receives
+ * without blocking, and connects again on the next request once the
+ * connection is lost or the server has sent GOAWAY. Header compression and
+ * flow control are left to nghttp2.
+ *
+ * A TLS connection resumes the last session handed out for its host and
+ * settings, by any connection, so that only the first one makes a full
+ * handshake.
+ *
+ * A request is sent again on a new connection only when it was certainly not
+ * processed: when it never left, or the server refused its stream. Any other
+ * request on a lost connection fails with NetworkFailure.
+ *
+ * The timeout of a request covers the whole of it, connecting included. A
+ * request that times out has its stream reset.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class Http2Connection : public std::enable_shared_from_this<Http2Connection>
+{
+  public:
+    /// Start the thread of a connection to target.
+    static std::shared_ptr<Http2Connection> create(Http2Target target);
+
+    Http2Connection(const Http2Connection &) = delete;
+    Http2Connection &operator=(const Http2Connection &) = delete;
+    ~Http2Connection();
+
+    /// Send request, a timeout of 0 waits for the response as long as it
+    /// takes.
+    void submit(Http2Request &&request,
+                double timeout,
+                Http2Callback &&callback);
+
+    /**
+     * @brief Let the thread finish the requests submitted so far, then close
+     * the connection and stop.
+     *
+     * The thread holds the connection, so it is released only then.
+     */
+    void close();
+
+    /// Called with each new socket, set it before the first request.
+    void setSocketCallback(std::function<void(int)> callback);
+
+    size_t bytesSent() const
+    {
+        return bytesSent_;
+    }
+
+    size_t bytesReceived() const
+    {
+        return bytesReceived_;
+    }
+
+    /// TLS handshakes that resumed no session.
+    size_t fullHandshakes() const
+    {
+        return fullHandshakes_;
+    }
+
+    /// TLS handshakes that resumed the session of an earlier connection to
+    /// the host.
+    size_t resumedHandshakes() const
+    {
+        return resumedHandshakes_;
+    }
+
+  private:
+    struct Stream;
+    using Clock = std::chrono::steady_clock;
+
+    explicit Http2Connection(Http2Target target);
+
+    void run();
+
+    /// Connect, within the deadline of the earliest waiting request.
+    bool connect();
+    bool handshake(Clock::time_point deadline);
+    bool startSession();
+    /// Complete or requeue the requests in flight and drop the connection.
+    void disconnect();
+
+    /// Move the waiting requests into streams, while the server takes them.
+    void submitWaiting();
+    /// Write what nghttp2 has to send, until the socket would block.
+    bool flush();
+    /// Read and process what the server has sent, until the socket would
+    /// block.
+    bool receive();
+    /// Fail the requests past their deadline, and return the earliest
+    /// deadline of the others.
+    Clock::time_point expire();
+
+    /// Bytes read, 0 when nothing is available yet, -1 when the connection
+    /// is closed or broken.
+    long readSome(uint8_t *data, size_t size);
+    long writeSome(const uint8_t *data, size_t size);
+
+    /// Send stream again on the next connection if it is certainly
+    /// unprocessed, or fail it.
+    void retryOrFail(std::unique_ptr<Stream> stream, bool unprocessed);
+    void complete(std::unique_ptr<Stream> stream, Http2Result result);
+    /// Call the callbacks of the completed requests, outside of nghttp2.
+    void runCallbacks();
+
+    /// The callbacks of nghttp2.
+    friend struct Http2Callbacks;
+
+    Http2Target target_;
+    /// The sessions of TLS connections are shared under this key.
+    const std::string sessionKey_;
+    std::function<void(int)> socketCallback_;
+    std::atomic<size_t> bytesSent_{0};
+    std::atomic<size_t> bytesReceived_{0};
+    std::atomic<size_t> fullHandshakes_{0};
+    std::atomic<size_t> resumedHandshakes_{0};
+
+    /// Guards queued_ and closing_.
+    std::mutex mutex_;
+    std::deque<std::unique_ptr<Stream>> queued_;
+    bool closing_{false};
+    /// The thread is woken through this pipe, written once until it reads.
+    int wakeFds_[2]{-1, -1};
+    std::atomic<bool> woken_{false};
+
+    // Only used on the thread
+    /// Requests to send as soon as there is a connection and a free stream.
+    std::deque<std::unique_ptr<Stream>> waiting_;
+    std::unordered_map<int32_t, std::unique_ptr<Stream>> streams_;
+    std::vector<std::pair<std::unique_ptr<Stream>, Http2Result>> completed_;
+    int fd_{-1};
+    ssl_ctx_st *sslContext_{nullptr};
+    ssl_st *ssl_{nullptr};
+    /// TLS needs to write before it can read on.
+    bool sslWantsWrite_{false};
+    nghttp2_session *session_{nullptr};
+    /// Frames serialized by nghttp2 that the socket has not taken yet.
+    std::string output_;
+    size_t outputOffset_{0};
+};
+
+}  // namespace tl::rest
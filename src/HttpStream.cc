@@ -0,0 +1,587 @@
+#include "HttpStream.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+using namespace tl::rest;
+
+namespace
+{
+
+/// The longest status, header or chunk size line that is accepted.
+constexpr size_t maxLineSize = 64 * 1024;
+
+[[noreturn]] void throwErrno(const string &what)
+{
+    throw runtime_error(what + ": " + strerror(errno));
+}
+
+string toLower(string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](char c) {
+        return std::tolower(static_cast<unsigned char>(c));
+    });
+    return text;
+}
+
+string trim(const string &text)
+{
+    auto begin = text.find_first_not_of(" \t");
+    if (begin == string::npos)
+    {
+        return "";
+    }
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+/// Parse a Content-Length, or a chunk size when base is 16.
+size_t parseSize(const string &text, int base, const char *what)
+{
+    auto digits = trim(text);
+    size_t size = 0;
+    auto end = digits.data() + digits.size();
+    auto [ptr, ec] = std::from_chars(digits.data(), end, size, base);
+    if (digits.empty() || ec != std::errc() || ptr != end)
+    {
+        throw runtime_error(string("malformed ") + what + ": " + text);
+    }
+    return size;
+}
+
+void setSocketTimeout(int fd, double timeout)
+{
+    timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout);
+    tv.tv_usec = static_cast<suseconds_t>((timeout - tv.tv_sec) * 1e6);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * @brief Connect fd within timeout, then switch it back to blocking mode.
+ */
+bool connectWithin(int fd, const sockaddr *addr, socklen_t len, double timeout)
+{
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    if (connect(fd, addr, len) != 0)
+    {
+        if (errno != EINPROGRESS)
+        {
+            return false;
+        }
+        pollfd pfd{fd, POLLOUT, 0};
+        if (poll(&pfd, 1, static_cast<int>(timeout * 1000)) <= 0)
+        {
+            return false;
+        }
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen);
+        if (err != 0)
+        {
+            return false;
+        }
+    }
+    fcntl(fd, F_SETFL, flags);
+    return true;
+}
+
+/// The state of jsonArraySink, shared by the copies of the sink.
+struct ArrayParser
+{
+    bool feed(string_view chunk);
+    bool emit();
+
+    std::function<bool(Json::Value &&)> visitor;
+    size_t maxElementSize;
+    bool started{false};
+    bool finished{false};
+    bool inString{false};
+    bool escape{false};
+    int depth{0};
+    string element;
+    unique_ptr<Json::CharReader> reader{
+        Json::CharReaderBuilder().newCharReader()};
+};
+
+bool ArrayParser::feed(string_view chunk)
+{
+    // The end of the body
+    if (chunk.empty())
+    {
+        if (!finished)
+        {
+            throw runtime_error("response body ended inside the json array.");
+        }
+        return true;
+    }
+    size_t from = 0;
+    for (size_t i = 0; i < chunk.size(); ++i)
+    {
+        char c = chunk[i];
+        if (!started || finished)
+        {
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                continue;
+            }
+            if (finished || c != '[')
+            {
+                throw runtime_error("response body is not a json array.");
+            }
+            started = true;
+            from = i + 1;
+            continue;
+        }
+        if (inString)
+        {
+            if (escape)
+            {
+                escape = false;
+            }
+            else if (c == '\\')
+            {
+                escape = true;
+            }
+            else if (c == '"')
+            {
+                inString = false;
+            }
+            continue;
+        }
+        switch (c)
+        {
+            case '"':
+                inString = true;
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (depth > 0)
+                {
+                    --depth;
+                    break;
+                }
+                // The end of the array
+                element.append(chunk.substr(from, i - from));
+                finished = true;
+                if (element.find_first_not_of(" \t\r\n") != string::npos &&
+                    !emit())
+                {
+                    return false;
+                }
+                break;
+            case ',':
+                if (depth == 0)
+                {
+                    element.append(chunk.substr(from, i - from));
+                    from = i + 1;
+                    if (!emit())
+                    {
+                        return false;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        if (element.size() + (i + 1 - from) > maxElementSize)
+        {
+            throw runtime_error("json array element is too large.");
+        }
+    }
+    if (started && !finished)
+    {
+        element.append(chunk.substr(from));
+    }
+    return true;
+}
+
+bool ArrayParser::emit()
+{
+    Json::Value value;
+    string errs;
+    if (!reader->parse(element.data(),
+                       element.data() + element.size(),
+                       &value,
+                       &errs))
+    {
+        throw runtime_error("malformed json array element: " + errs);
+    }
+    element.clear();
+    return visitor(std::move(value));
+}
+
+}  // namespace
+
+StreamSink tl::rest::fdSink(int fd)
+{
+    return [fd](string_view chunk) {
+        while (!chunk.empty())
+        {
+            auto n = write(fd, chunk.data(), chunk.size());
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throwErrno("failed to write the response body");
+            }
+            chunk.remove_prefix(n);
+        }
+        return true;
+    };
+}
+
+StreamSink tl::rest::jsonArraySink(std::function<bool(Json::Value &&)> visitor,
+                                   size_t maxElementSize)
+{
+    auto parser = make_shared<ArrayParser>();
+    parser->visitor = std::move(visitor);
+    parser->maxElementSize = maxElementSize;
+    return [parser](string_view chunk) { return parser->feed(chunk); };
+}
+
+HttpStream HttpStream::connectTcp(const string &host,
+                                  uint16_t port,
+                                  const StreamOptions &options)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result{nullptr};
+    int err =
+        getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &result);
+    if (err != 0)
+    {
+        throw runtime_error("failed to resolve " + host + ": " +
+                            gai_strerror(err));
+    }
+    unique_ptr<addrinfo, decltype(&freeaddrinfo)> guard(result, freeaddrinfo);
+    for (auto ai = result; ai != nullptr; ai = ai->ai_next)
+    {
+        int fd = socket(ai->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (connectWithin(fd, ai->ai_addr, ai->ai_addrlen, options.timeout))
+        {
+            return HttpStream(fd, options);
+        }
+        close(fd);
+    }
+    throw runtime_error("failed to connect to " + host + ":" + to_string(port));
+}
+
+HttpStream HttpStream::connectUnix(const string &path,
+                                   const StreamOptions &options)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    {
+        throw runtime_error("invalid unix socket path: " + path);
+    }
+    path.copy(addr.sun_path, path.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throwErrno("failed to create a unix socket");
+    }
+    if (!connectWithin(fd,
+                       reinterpret_cast<const sockaddr *>(&addr),
+                       sizeof(addr),
+                       options.timeout))
+    {
+        close(fd);
+        throw runtime_error("failed to connect to " + path);
+    }
+    return HttpStream(fd, options);
+}
+
+HttpStream::HttpStream(int fd, const StreamOptions &options)
+    : fd_(fd),
+      timeout_(options.timeout),
+      buffer_(std::max<size_t>(options.bufferSize, 1))
+{
+    setSocketTimeout(fd_, timeout_);
+}
+
+HttpStream::HttpStream(HttpStream &&other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      timeout_(other.timeout_),
+      buffer_(std::move(other.buffer_)),
+      begin_(other.begin_),
+      end_(other.end_),
+      body_(other.body_),
+      contentLength_(other.contentLength_)
+{
+}
+
+HttpStream::~HttpStream()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+    }
+}
+
+void HttpStream::send(string_view head, string_view body)
+{
+    for (auto data : {head, body})
+    {
+        while (!data.empty())
+        {
+            auto n = ::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    throw StreamTimeout("timed out sending the request");
+                }
+                throwErrno("failed to send the request");
+            }
+            data.remove_prefix(n);
+        }
+    }
+}
+
+StreamResponse HttpStream::readHead(bool headRequest)
+{
+    StreamResponse response;
+    if (!fill())
+    {
+        throw StreamClosed("connection closed before the response");
+    }
+    // Interim responses such as 100 Continue are skipped
+    while (response.status < 200)
+    {
+        auto statusLine = readLine();
+        auto space = statusLine.find(' ');
+        if (!statusLine.starts_with("HTTP/1.") || space == string::npos)
+        {
+            throw runtime_error("malformed status line: " + statusLine);
+        }
+        response.status = atoi(statusLine.c_str() + space + 1);
+        response.headers.clear();
+        for (auto line = readLine(); !line.empty(); line = readLine())
+        {
+            auto colon = line.find(':');
+            if (colon == string::npos)
+            {
+                throw runtime_error("malformed header: " + line);
+            }
+            auto &value = response.headers[toLower(line.substr(0, colon))];
+            value += (value.empty() ? "" : ", ") + trim(line.substr(colon + 1));
+        }
+    }
+
+    auto transferEncoding = response.headers.find("transfer-encoding");
+    auto contentLength = response.headers.find("content-length");
+    if (headRequest || response.status == 204 || response.status == 304)
+    {
+        body_ = Body::None;
+    }
+    else if (transferEncoding != response.headers.end() &&
+             toLower(transferEncoding->second).find("chunked") != string::npos)
+    {
+        body_ = Body::Chunked;
+    }
+    else if (contentLength != response.headers.end())
+    {
+        body_ = Body::Length;
+        contentLength_ =
+            parseSize(contentLength->second, 10, "content length");
+    }
+    else
+    {
+        body_ = Body::UntilClose;
+    }
+    return response;
+}
+
+void HttpStream::readBody(StreamResponse &response, const StreamSink &sink)
+{
+    auto deliver = [&response, &sink](string_view chunk) {
+        response.bodyBytes += chunk.size();
+        return sink(chunk);
+    };
+    auto deliverExactly = [this, &deliver](size_t size) {
+        while (size > 0)
+        {
+            auto chunk = take(size);
+            if (chunk.empty())
+            {
+                throw runtime_error("connection closed in the middle of the "
+                                    "response body");
+            }
+            size -= chunk.size();
+            if (!deliver(chunk))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    response.complete = false;
+    switch (body_)
+    {
+        case Body::None:
+            break;
+        case Body::Length:
+            if (!deliverExactly(contentLength_))
+            {
+                return;
+            }
+            break;
+        case Body::UntilClose:
+            for (auto chunk = take(buffer_.size()); !chunk.empty();
+                 chunk = take(buffer_.size()))
+            {
+                if (!deliver(chunk))
+                {
+                    return;
+                }
+            }
+            break;
+        case Body::Chunked:
+            while (true)
+            {
+                // Chunk extensions after ';' are ignored
+                auto sizeLine = readLine();
+                auto size = parseSize(
+                    sizeLine.substr(0, sizeLine.find(';')), 16, "chunk size");
+                if (size == 0)
+                {
+                    // Skip the trailers
+                    while (!readLine().empty())
+                    {
+                    }
+                    break;
+                }
+                if (!deliverExactly(size))
+                {
+                    return;
+                }
+                if (!readLine().empty())
+                {
+                    throw runtime_error("malformed chunked response body");
+                }
+            }
+            break;
+    }
+    response.complete = true;
+    // Tell the sink that nothing is missing
+    sink({});
+}
+
+bool HttpStream::keepAlive(const StreamResponse &response) const
+{
+    if (!response.complete || body_ == Body::UntilClose)
+    {
+        return false;
+    }
+    auto connection = response.headers.find("connection");
+    return connection == response.headers.end() ||
+           toLower(connection->second).find("close") == string::npos;
+}
+
+void HttpStream::setTimeout(double timeout)
+{
+    timeout_ = timeout;
+    setSocketTimeout(fd_, timeout_);
+}
+
+bool HttpStream::fill()
+{
+    if (begin_ < end_)
+    {
+        return true;
+    }
+    while (true)
+    {
+        auto n = recv(fd_, buffer_.data(), buffer_.size(), 0);
+        if (n >= 0)
+        {
+            begin_ = 0;
+            end_ = n;
+            return n > 0;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            throw StreamTimeout("timed out reading the response");
+        }
+        if (errno != EINTR)
+        {
+            throwErrno("failed to read the response");
+        }
+    }
+}
+
+string HttpStream::readLine()
+{
+    string line;
+    while (true)
+    {
+        if (!fill())
+        {
+            throw runtime_error("connection closed in the middle of the "
+                                "response head");
+        }
+        auto begin = buffer_.data() + begin_;
+        auto end = buffer_.data() + end_;
+        auto newline = std::find(begin, end, '\n');
+        line.append(begin, newline);
+        begin_ = newline - buffer_.data();
+        if (newline != end)
+        {
+            ++begin_;
+            break;
+        }
+        if (line.size() > maxLineSize)
+        {
+            throw runtime_error("response line is too long");
+        }
+    }
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.pop_back();
+    }
+    return line;
+}
+
+string_view HttpStream::take(size_t maxSize)
+{
+    if (!fill())
+    {
+        return {};
+    }
+    auto size = std::min(maxSize, end_ - begin_);
+    string_view chunk(buffer_.data() + begin_, size);
+    begin_ += size;
+    return chunk;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file HttpStream.h
+ * @brief Read HTTP responses piece by piece instead of buffering them.
+ *
+ * drogon's HttpClient hands over a response only once its whole body has been
+ * received. HttpStream performs a blocking HTTP/1.1 exchange on its own
+ * connection and delivers the body to a sink through a fixed-size buffer, so
+ * the memory used by a call does not depend on the size of the response.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <json/json.h>
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace tl::rest
+{
+
+/**
+ * @brief Receives the body of a streamed response, chunk by chunk.
+ *
+ * A chunk is only valid during the call. Return false to stop reading, the
+ * connection is closed and the rest of the body is discarded. Once the whole
+ * body is read, the sink is called with an empty chunk, which it can use to
+ * check that the body is complete.
+ *
+ * The sink is called on the thread that reads the response, the next chunk
+ * is not read before it returns. A slow sink therefore slows the server down
+ * through TCP flow control instead of growing a buffer.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+using StreamSink = std::function<bool(std::string_view chunk)>;
+
+/**
+ * @brief Options of a streamed call.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct StreamOptions
+{
+    /// The size of the read buffer, and the largest chunk given to the sink.
+    size_t bufferSize{64 * 1024};
+    /// Give up when the server sends nothing for this long, in seconds.
+    double timeout{30};
+};
+
+/**
+ * @brief What is known about a streamed response once it is read.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct StreamResponse
+{
+    int status{0};
+    /// Header names are in lower case.
+    std::unordered_map<std::string, std::string> headers;
+    /// The number of body bytes given to the sink.
+    size_t bodyBytes{0};
+    /// false if the sink stopped the transfer.
+    bool complete{false};
+};
+
+/**
+ * @brief A sink that writes every chunk to fd, which is left open.
+ *
+ * @throw std::runtime_error If writing fails.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+StreamSink fdSink(int fd);
+
+/**
+ * @brief A sink that parses a JSON array and visits its elements one by one.
+ *
+ * Only one element is held in memory at a time. Return false from the visitor
+ * to stop reading.
+ *
+ * @param maxElementSize The size limit of a single element, in bytes.
+ * @throw std::runtime_error If the body is not a JSON array, an element
+ * exceeds the limit, or the body ends before the array does.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+StreamSink jsonArraySink(std::function<bool(Json::Value &&)> visitor,
+                         size_t maxElementSize = 1 << 20);
+
+/**
+ * @brief Thrown when the peer sends or accepts nothing within the timeout.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class StreamTimeout : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Thrown when the connection ends before the first byte of the
+ * response, as a kept-alive connection does once the server has closed it.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class StreamClosed : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief A blocking HTTP/1.1 exchange on a connection of its own.
+ *
+ * Errors are reported with std::runtime_error, timeouts with StreamTimeout
+ * and a connection that ends before the response with StreamClosed.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class HttpStream
+{
+  public:
+    /// Connect to host:port, trying each of its addresses in turn.
+    static HttpStream connectTcp(const std::string &host,
+                                 uint16_t port,
+                                 const StreamOptions &options);
+
+    /// Connect to the Unix domain socket at path.
+    static HttpStream connectUnix(const std::string &path,
+                                  const StreamOptions &options);
+
+    /// Take over a connected socket.
+    HttpStream(int fd, const StreamOptions &options);
+    HttpStream(HttpStream &&other) noexcept;
+    HttpStream &operator=(HttpStream &&) = delete;
+    ~HttpStream();
+
+    /// Send the request, head already ends with an empty line.
+    void send(std::string_view head, std::string_view body);
+
+    /**
+     * @brief Read the status line and the headers.
+     *
+     * @throw StreamClosed If the connection ends before the response starts.
+     */
+    StreamResponse readHead(bool headRequest = false);
+
+    /// Deliver the body to sink, then fill in bodyBytes and complete.
+    /// @throw std::runtime_error If the body is malformed or cut short.
+    void readBody(StreamResponse &response, const StreamSink &sink);
+
+    /**
+     * @brief Whether another request can be sent once the body of response
+     * is completely read.
+     */
+    bool keepAlive(const StreamResponse &response) const;
+
+    /// Change the timeout of each wait on the socket, in seconds.
+    void setTimeout(double timeout);
+
+    int fd() const
+    {
+        return fd_;
+    }
+
+  private:
+    bool fill();
+    std::string readLine();
+    std::string_view take(size_t maxSize);
+
+    int fd_;
+    double timeout_;
+    std::vector<char> buffer_;
+    size_t begin_{0};
+    size_t end_{0};
+    enum class Body
+    {
+        None,
+        Length,
+        Chunked,
+        UntilClose
+    } body_{Body::None};
+    size_t contentLength_{0};
+};
+
+}  // namespace tl::rest
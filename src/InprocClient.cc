@@ -0,0 +1,145 @@
+#include "InprocClient.h"
+
+#include <trantor/net/EventLoopThread.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+using namespace drogon;
+using namespace tl::rest;
+
+namespace
+{
+
+struct Registry
+{
+    std::mutex mutex;
+    std::unordered_map<string, shared_ptr<const InprocHandler>> handlers;
+};
+
+Registry &registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+shared_ptr<const InprocHandler> findHandler(const string &name)
+{
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto iter = reg.handlers.find(name);
+    return iter == reg.handlers.end() ? nullptr : iter->second;
+}
+
+/// The thread the handlers run on, started on first use.
+trantor::EventLoop *handlerLoop()
+{
+    static trantor::EventLoopThread thread("inproc");
+    static std::once_flag started;
+    std::call_once(started, []() { thread.run(); });
+    return thread.getLoop();
+}
+
+/**
+ * @brief Copy what would go over the wire into a new response, so that the
+ * client parses the body instead of reusing the objects of the handler.
+ */
+HttpResponsePtr received(const HttpResponsePtr &resp)
+{
+    auto copy = HttpResponse::newHttpResponse();
+    copy->setStatusCode(resp->statusCode());
+    for (const auto &[field, value] : resp->headers())
+    {
+        copy->addHeader(field, value);
+    }
+    auto contentType = resp->contentTypeString();
+    if (!contentType.empty())
+    {
+        copy->addHeader("content-type", string(contentType));
+    }
+    copy->setBody(string(resp->body()));
+    return copy;
+}
+
+}  // namespace
+
+void tl::rest::registerInprocHandler(const string &name,
+                                     InprocHandler handler)
+{
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.handlers[name] = make_shared<const InprocHandler>(std::move(handler));
+}
+
+void tl::rest::removeInprocHandler(const string &name)
+{
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.handlers.erase(name);
+}
+
+InprocClient::InprocClient(string name) : name_(std::move(name))
+{
+}
+
+trantor::EventLoop *InprocClient::getLoop()
+{
+    return handlerLoop();
+}
+
+void InprocClient::sendRequest(const HttpRequestPtr &req,
+                               const HttpReqCallback &callback,
+                               double timeout)
+{
+    sendRequest(req, HttpReqCallback(callback), timeout);
+}
+
+void InprocClient::sendRequest(const HttpRequestPtr &req,
+                               HttpReqCallback &&callback,
+                               double timeout)
+{
+    // Completed at most once, by the handler or by the timeout
+    struct Pending
+    {
+        std::atomic<bool> done{false};
+        std::atomic<trantor::TimerId> timer{0};
+        HttpReqCallback callback;
+    };
+    auto loop = handlerLoop();
+    auto pending = make_shared<Pending>();
+    pending->callback = std::move(callback);
+    auto complete = [pending, loop](ReqResult result,
+                                    const HttpResponsePtr &resp) {
+        if (!pending->done.exchange(true))
+        {
+            if (pending->timer != 0)
+            {
+                loop->invalidateTimer(pending->timer);
+            }
+            pending->callback(result, resp);
+        }
+    };
+    if (timeout > 0)
+    {
+        pending->timer = loop->runAfter(timeout, [complete]() {
+            complete(ReqResult::Timeout, nullptr);
+        });
+    }
+    loop->queueInLoop([handler = findHandler(name_), req, complete]() {
+        if (handler == nullptr)
+        {
+            complete(ReqResult::BadServerAddress, nullptr);
+            return;
+        }
+        (*handler)(req, [complete](const HttpResponsePtr &resp) {
+            if (resp == nullptr)
+            {
+                complete(ReqResult::BadResponse, nullptr);
+                return;
+            }
+            complete(ReqResult::Ok, received(resp));
+        });
+    });
+}
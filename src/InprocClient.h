@@ -0,0 +1,151 @@
+/**
+ * @file InprocClient.h
+ * @brief Call handlers of the same process without sockets, through urls
+ * like `inproc://name/path`.
+ *
+ * Requests are built, encoded and decoded exactly as for a remote host, only
+ * the network is left out. This isolates the cost of Muelsyse itself in
+ * benchmarks, and lets tests run without a server.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <drogon/HttpClient.h>
+
+#include <functional>
+#include <string>
+
+namespace tl::rest
+{
+
+/**
+ * @brief A handler with the signature of drogon's request handlers.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+using InprocHandler = std::function<void(
+    const drogon::HttpRequestPtr &,
+    std::function<void(const drogon::HttpResponsePtr &)> &&)>;
+
+/**
+ * @brief Serve the urls `inproc://name/...` with handler, replacing the
+ * previous handler of name.
+ *
+ * The handler is called on a thread of its own, like the IO thread of a
+ * server, and is given the whole path in req->path().
+ *
+ * @code
+ * tl::rest::registerInprocHandler(
+ *     "users",
+ *     [](const HttpRequestPtr &req,
+ *        std::function<void(const HttpResponsePtr &)> &&callback) {
+ *         callback(HttpResponse::newHttpJsonResponse(findUser(req->path())));
+ *     });
+ * @endcode
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+void registerInprocHandler(const std::string &name, InprocHandler handler);
+
+/**
+ * @brief Stop serving `inproc://name`, its calls then fail with
+ * ReqResult::BadServerAddress.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+void removeInprocHandler(const std::string &name);
+
+/**
+ * @brief An HttpClient that hands requests to the handler registered for
+ * its name.
+ *
+ * The response is rebuilt from its status, headers and body before it is
+ * delivered, so it is parsed on the client side as a received one would
+ * be. TLS and cookie settings do not apply and are ignored.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class InprocClient : public drogon::HttpClient
+{
+  public:
+    explicit InprocClient(std::string name);
+
+    void sendRequest(const drogon::HttpRequestPtr &req,
+                     const drogon::HttpReqCallback &callback,
+                     double timeout = 0) override;
+    void sendRequest(const drogon::HttpRequestPtr &req,
+                     drogon::HttpReqCallback &&callback,
+                     double timeout = 0) override;
+
+    void setPipeliningDepth(size_t) override
+    {
+    }
+
+    void enableCookies(bool = true) override
+    {
+    }
+
+    void addCookie(const std::string &, const std::string &) override
+    {
+    }
+
+    void addCookie(const drogon::Cookie &) override
+    {
+    }
+
+    void setUserAgent(const std::string &) override
+    {
+    }
+
+    trantor::EventLoop *getLoop() override;
+
+    size_t bytesSent() const override
+    {
+        return 0;
+    }
+
+    size_t bytesReceived() const override
+    {
+        return 0;
+    }
+
+    std::string host() const override
+    {
+        return name_;
+    }
+
+    uint16_t port() const override
+    {
+        return 0;
+    }
+
+    bool secure() const override
+    {
+        return false;
+    }
+
+    void setCertPath(const std::string &, const std::string &) override
+    {
+    }
+
+    void addSSLConfigs(
+        const std::vector<std::pair<std::string, std::string>> &) override
+    {
+    }
+
+    void setSockOptCallback(std::function<void(int)>) override
+    {
+    }
+
+  private:
+    const std::string name_;
+};
+
+}  // namespace tl::rest
@@ -1,5 +1,21 @@
 #include "Muelsyse.h"
+#ifdef MUELSYSE_WITH_NGHTTP2
+#include "Http2Client.h"
+#endif
+#ifdef MUELSYSE_WITH_BROTLI
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#endif
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <random>
 #include <stdexcept>
+#include <unordered_set>
 
 using namespace std;
 using namespace drogon;
@@ -31,196 +47,2804 @@ HttpMethod fromString(const string &method)
     throw invalid_argument("Unsupported HttpMethod: " + method);
 }
 
+/**
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+Compression compressionFromString(const string &algorithm)
+{
+    if (algorithm == "gzip")
+    {
+        return Compression::Gzip;
+    }
+    if (algorithm == "br")
+    {
+#ifdef MUELSYSE_WITH_BROTLI
+        return Compression::Brotli;
+#else
+        LOG_WARN << "built without MUELSYSE_WITH_BROTLI, fall back to gzip";
+        return Compression::Gzip;
+#endif
+    }
+    if (algorithm == "none")
+    {
+        return Compression::None;
+    }
+    throw invalid_argument("Unsupported compression: " + algorithm);
+}
+
+/**
+ * @brief Read the optional `compression` item of a function.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static void parseCompression(const Json::Value &config, RestRoute &route)
+{
+    route.compression =
+        compressionFromString(config.get("algorithm", "gzip").asString());
+    route.compressMinSize =
+        config.get("min_size", (Json::UInt64)route.compressMinSize)
+            .asUInt64();
+    route.acceptEncoding = config.get("accept_encoding", true).asBool();
+}
+
+/**
+ * @brief Read the optional `tls` item of a function.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static shared_ptr<const TlsConfig> parseTls(const Json::Value &config)
+{
+    auto tls = make_shared<TlsConfig>();
+    tls->validateCert = config.get("validate_cert", true).asBool();
+    tls->useOldTls = config.get("use_old_tls", false).asBool();
+    tls->caFile = config.get("ca_file", "").asString();
+    tls->certFile = config.get("cert", "").asString();
+    tls->keyFile = config.get("key", "").asString();
+    if (tls->certFile.empty() != tls->keyFile.empty())
+    {
+        throw invalid_argument("tls: cert and key must be set together");
+    }
+    if (!tls->caFile.empty())
+    {
+        tls->sslConfigs.emplace_back("VerifyCAFile", tls->caFile);
+    }
+    const auto &commands = config["ssl_conf"];
+    for (const auto &command : commands.getMemberNames())
+    {
+        tls->sslConfigs.emplace_back(command, commands[command].asString());
+    }
+    tls->source = config;
+    return tls;
+}
+
+/**
+ * @brief Read the optional `auth` item of a host.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static AuthConfig parseAuth(const Json::Value &config)
+{
+    AuthConfig auth;
+    if (!config["token_function"].isString())
+    {
+        throw invalid_argument("auth.token_function is required");
+    }
+    auth.tokenFunction = config["token_function"].asString();
+    auth.args = config["args"];
+    auth.skew = config.get("skew", auth.skew).asDouble();
+    auth.header = config.get("header", auth.header).asString();
+    // drogon sends header names in lowercase
+    std::transform(auth.header.begin(),
+                   auth.header.end(),
+                   auth.header.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    auth.timeout = config.get("timeout", auth.timeout).asDouble();
+    return auth;
+}
+
+/**
+ * @brief How long a call waits for the first token of auth, not past its
+ * deadline.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static std::chrono::milliseconds tokenWait(
+    const AuthConfig &auth,
+    const std::optional<std::chrono::steady_clock::time_point> &deadline)
+{
+    auto wait =
+        std::chrono::milliseconds(static_cast<int64_t>(auth.timeout * 1000));
+    if (deadline)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            *deadline - std::chrono::steady_clock::now());
+        wait = std::clamp(left, std::chrono::milliseconds(0), wait);
+    }
+    return wait;
+}
+
+/**
+ * @brief Read a token from the OAuth 2.0 style response of a token function:
+ * `{"access_token": "...", "expires_in": 3600}`.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static TokenCache::Token parseToken(const Json::Value &json)
+{
+    if (!json.isObject() || !json["access_token"].isString())
+    {
+        throw runtime_error("the response has no access_token");
+    }
+    return {"Bearer " + json["access_token"].asString(),
+            json.get("expires_in", 0).asDouble()};
+}
+
+/**
+ * @brief Where the host of url ends, and where its path starts.
+ *
+ * The socket path of `unix:///path/to.sock:/request/path` ends at the colon
+ * that is followed by the request path.
+ *
+ * @return npos twice if url has no path.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static std::pair<size_t, size_t> splitPoint(const string &url)
+{
+    if (url.starts_with("unix://"))
+    {
+        auto pos = url.find(":/", 7);
+        return {pos, pos == string::npos ? pos : pos + 1};
+    }
+    auto pos = url.find('/', url.find("://") + 3);
+    return {pos, pos};
+}
+
+/**
+ * @brief The scheme and authority of url, the key of the HttpClient pool.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static string hostOf(string url)
+{
+    if (url.find("://") == string::npos)
+    {
+        url = "http://" + url;
+    }
+    auto pos = splitPoint(url).first;
+    if (pos != string::npos)
+    {
+        url.resize(pos);
+    }
+    return url;
+}
+
+/**
+ * @brief Split a pool key like `http://host:port` whose host is a name.
+ *
+ * @return false if the key is https, or the host is already an address.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static bool splitNamedHost(const string &url, string &host, uint16_t &port)
+{
+    if (!url.starts_with("http://") || url.size() <= 7 || url[7] == '[')
+    {
+        return false;
+    }
+    host = url.substr(7);
+    port = 80;
+    auto pos = host.rfind(':');
+    if (pos != string::npos)
+    {
+        port = static_cast<uint16_t>(std::stoul(host.substr(pos + 1)));
+        host.resize(pos);
+    }
+    in_addr addr;
+    return inet_pton(AF_INET, host.c_str(), &addr) != 1;
+}
+
+/**
+ * @brief The hosts of the routes of a table, stored once, by their content.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+using HostNames =
+    std::unordered_map<std::string_view, shared_ptr<const string>>;
+
+/**
+ * @brief The host of a route from hosts, added to it if it is new.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static shared_ptr<const string> internHost(HostNames &hosts, string host)
+{
+    auto iter = hosts.find(host);
+    if (iter == hosts.end())
+    {
+        auto shared = make_shared<const string>(std::move(host));
+        iter = hosts.emplace(*shared, shared).first;
+    }
+    return iter->second;
+}
+
+/**
+ * @brief A template with the headers of the requests of route to host, the
+ * pool key with the scheme. hostOptions tell the hosts that speak HTTP/2.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static RequestTemplate requestHeaders(
+    const RestRoute &route,
+    const string &host,
+    const std::unordered_map<string, HostOptions> &hostOptions)
+{
+    RequestTemplate request;
+    if (route.codec)
+    {
+        auto contentType = string(route.codec->contentType());
+        request.headers.emplace_back("Accept", contentType);
+        // UnixClient and Http2Client cannot read back the content type of a
+        // request
+        auto options = hostOptions.find(host);
+        if (host.starts_with("unix://") ||
+            (options != hostOptions.end() && options->second.http2))
+        {
+            request.headers.emplace_back("Content-Type", contentType);
+        }
+    }
+    if (route.acceptEncoding)
+    {
+#ifdef MUELSYSE_WITH_BROTLI
+        request.headers.emplace_back("Accept-Encoding", "gzip, br");
+#else
+        request.headers.emplace_back("Accept-Encoding", "gzip");
+#endif
+    }
+    return request;
+}
+
+/**
+ * @brief The template of the requests of route to url, its host is taken
+ * from or added to hosts. hostOptions tell the hosts that speak HTTP/2.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static RequestTemplate compileRequest(
+    string url,
+    const RestRoute &route,
+    HostNames &hosts,
+    const std::unordered_map<string, HostOptions> &hostOptions)
+{
+    if (url.find("://") == string::npos)
+    {
+        url = "http://" + url;
+    }
+    auto [hostEnd, pathStart] = splitPoint(url);
+    auto host = url.substr(0, hostEnd);
+    auto request = requestHeaders(route, host, hostOptions);
+    if (host.find('{') == string::npos)
+    {
+        request.host = internHost(hosts, std::move(host));
+        url = hostEnd == string::npos ? "/" : url.substr(pathStart);
+    }
+    size_t from = 0;
+    for (size_t open; (open = url.find('{', from)) != string::npos;)
+    {
+        auto close = url.find('}', open);
+        if (close == string::npos)
+        {
+            break;
+        }
+        request.pieces.push_back(url.substr(from, open - from));
+        request.placeholders.push_back(url.substr(open, close - open + 1));
+        from = close + 1;
+    }
+    request.pieces.push_back(url.substr(from));
+    return request;
+}
+
+/**
+ * @brief The template of the requests of a route declared in code, cut at
+ * the placeholders found when url was checked. configured is the host of
+ * `route_hosts`, if any, which replaces the host of url.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static RequestTemplate compileStaticRequest(
+    const RestRoute &route,
+    const UrlTemplate &url,
+    const string *configured,
+    HostNames &hosts,
+    const std::unordered_map<string, HostOptions> &hostOptions)
+{
+    const auto scheme =
+        url.url.find("://") == string::npos ? "http://" : string();
+    auto host = configured ? hostOf(*configured)
+                           : scheme + string(url.url.substr(0, url.hostEnd));
+    auto request = requestHeaders(route, host, hostOptions);
+    size_t index = 0;
+    size_t from = 0;
+    if (configured || url.placeholderCount == 0 || url.starts[0] > url.hostEnd)
+    {
+        request.host = internHost(hosts, std::move(host));
+        from = url.pathStart;
+        // A configured host has none of the placeholders of the declared one
+        while (index < url.placeholderCount && url.starts[index] < from)
+        {
+            ++index;
+        }
+    }
+    auto piece = request.host ? string() : scheme;
+    for (; index < url.placeholderCount; ++index)
+    {
+        piece.append(url.url.substr(from, url.starts[index] - from));
+        request.pieces.push_back(std::move(piece));
+        piece.clear();
+        request.placeholders.emplace_back(url.url.substr(
+            url.starts[index], url.ends[index] - url.starts[index]));
+        from = url.ends[index];
+    }
+    piece.append(url.url.substr(from));
+    if (request.pieces.empty() && piece.empty())
+    {
+        piece = "/";
+    }
+    request.pieces.push_back(std::move(piece));
+    return request;
+}
+
+/**
+ * @brief The url of request with its placeholders, for logs.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static string urlOf(const RequestTemplate &request)
+{
+    auto url = request.host ? *request.host : string();
+    for (size_t i = 0; i < request.pieces.size(); ++i)
+    {
+        url.append(request.pieces[i]);
+        if (i < request.placeholders.size())
+        {
+            url.append(request.placeholders[i]);
+        }
+    }
+    return url;
+}
+
+/**
+ * @brief Read the optional `shadow` item of a function, whose other items
+ * are parsed already.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static shared_ptr<const ShadowConfig> parseShadow(
+    const Json::Value &config,
+    const RestRoute &route,
+    HostNames &hosts,
+    const std::unordered_map<string, HostOptions> &hostOptions)
+{
+    auto shadow = make_shared<ShadowConfig>();
+    if (!config["url"].isString())
+    {
+        throw invalid_argument("shadow.url is required");
+    }
+    shadow->url = config["url"].asString();
+    shadow->sampleRate = config.get("sample_rate", shadow->sampleRate)
+                             .asDouble();
+    if (shadow->sampleRate < 0 || shadow->sampleRate > 1)
+    {
+        throw invalid_argument("shadow.sample_rate must be between 0 and 1");
+    }
+    shadow->maxInFlight =
+        config.get("max_in_flight", (Json::UInt)shadow->maxInFlight)
+            .asUInt();
+    shadow->timeout = config.get("timeout", shadow->timeout).asDouble();
+    RestRoute target;
+    target.codec = route.codec;
+    shadow->request = compileRequest(shadow->url, target, hosts, hostOptions);
+    return shadow;
+}
+
+/**
+ * @brief Read the optional `pagination` item of a function.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static shared_ptr<const PaginationConfig> parsePagination(
+    const Json::Value &config)
+{
+    auto pagination = make_shared<PaginationConfig>();
+    if (!config["cursor"].isString() || !config["next_cursor"].isString())
+    {
+        throw invalid_argument(
+            "pagination.cursor and pagination.next_cursor are required");
+    }
+    pagination->cursor = config["cursor"].asString();
+    pagination->nextCursor = splitString(config["next_cursor"].asString(), ".");
+    if (config.isMember("items"))
+    {
+        pagination->items = splitString(config["items"].asString(), ".");
+    }
+    pagination->prefetch =
+        config.get("prefetch", (Json::UInt)pagination->prefetch).asUInt();
+    return pagination;
+}
+
+/**
+ * @brief The item of json at path, or nullptr.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static const Json::Value *findPath(const Json::Value &json,
+                                   const std::vector<string> &path)
+{
+    const auto *value = &json;
+    for (const auto &name : path)
+    {
+        if (!value->isObject() ||
+            (value = value->find(name.data(), name.data() + name.size())) ==
+                nullptr)
+        {
+            return nullptr;
+        }
+    }
+    return value;
+}
+
+/**
+ * @brief Fill the placeholders of request with pathValues, in order.
+ *
+ * Placeholders without a value are kept.
+ *
+ * @param host The key of the client pool.
+ * @param path The path, with the query if any.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static void fillTemplate(const RequestTemplate &request,
+                         const std::vector<string> &pathValues,
+                         string &host,
+                         string &path)
+{
+    path = request.pieces[0];
+    for (size_t i = 0; i < request.placeholders.size(); ++i)
+    {
+        path.append(i < pathValues.size() ? pathValues[i]
+                                          : request.placeholders[i]);
+        path.append(request.pieces[i + 1]);
+    }
+    if (request.host)
+    {
+        host = *request.host;
+        return;
+    }
+    // The url is complete only now, split it like compileRequest does
+    host = std::move(path);
+    path = "/";
+    auto [hostEnd, pathStart] = splitPoint(host);
+    if (hostEnd != string::npos)
+    {
+        path = host.substr(pathStart);
+        host.resize(hostEnd);
+    }
+}
+
+/**
+ * @brief Whether to pick one call, with probability rate.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static bool sampled(double rate)
+{
+    if (rate <= 0)
+    {
+        return false;
+    }
+    thread_local std::minstd_rand engine(std::random_device{}());
+    return rate >= 1 ||
+           std::uniform_real_distribution<double>(0, 1)(engine) < rate;
+}
+
+/**
+ * @brief Serialize the request of call for the outbox: the function, the
+ * pool, the method, the path, the content type and the body, then the
+ * headers but skipHeader, each prefixed with its length.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static string outboxRecord(const string &funcName,
+                           const PreparedCall &call,
+                           const string &skipHeader)
+{
+    const auto &req = *call.request;
+    const auto &codec = call.route->codec;
+    auto method = std::to_string(static_cast<int>(req.method()));
+    std::vector<std::string_view> fields{
+        funcName,
+        call.host,
+        method,
+        req.path(),
+        codec ? codec->contentType() : "application/json",
+        req.body()};
+    for (const auto &[field, value] : req.headers())
+    {
+        if (field == skipHeader)
+        {
+            continue;
+        }
+        fields.push_back(field);
+        fields.push_back(value);
+    }
+    string record;
+    for (auto field : fields)
+    {
+        auto size = static_cast<uint32_t>(field.size());
+        record.append(reinterpret_cast<const char *>(&size), sizeof(size));
+        record.append(field);
+    }
+    return record;
+}
+
+/**
+ * @brief Split a record made by outboxRecord, empty if it is malformed.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static std::vector<string> outboxFields(std::string_view record)
+{
+    std::vector<string> fields;
+    while (!record.empty())
+    {
+        uint32_t size;
+        if (record.size() < sizeof(size))
+        {
+            return {};
+        }
+        memcpy(&size, record.data(), sizeof(size));
+        record.remove_prefix(sizeof(size));
+        if (record.size() < size)
+        {
+            return {};
+        }
+        fields.emplace_back(record.substr(0, size));
+        record.remove_prefix(size);
+    }
+    return fields;
+}
+
 void Muelsyse::initAndStart(const Json::Value &config)
 {
-    if (config.isMember("function_list") && config["function_list"].isArray())
+    defaultHostOptions_.connections =
+        std::max(1u, config.get("connections_per_host", 1).asUInt());
+    const auto &hosts = config["hosts"];
+    for (const auto &host : hosts.getMemberNames())
+    {
+        auto &options = hostOptions_[hostOf(host)];
+        options = defaultHostOptions_;
+        options.connections = std::max(
+            1u,
+            hosts[host].get("connections", (Json::UInt)options.connections)
+                .asUInt());
+        auto protocol = hosts[host].get("protocol", "http/1.1").asString();
+        if (protocol == "h2")
+        {
+#ifndef MUELSYSE_WITH_NGHTTP2
+            throw invalid_argument("protocol h2 needs a build with "
+                                   "MUELSYSE_WITH_NGHTTP2: " +
+                                   host);
+#endif
+            options.http2 = true;
+        }
+        else if (protocol != "http/1.1")
+        {
+            throw invalid_argument("Unsupported protocol: " + protocol);
+        }
+    }
+    maxConcurrencyPerHost_ = config.get("max_concurrency_per_host", 0).asUInt();
+    maxQueueWait_ = std::chrono::milliseconds(
+        static_cast<int64_t>(config.get("max_queue_wait", 1.0).asDouble() *
+                             1000));
+    auto executor = config.get("callback_executor", "client").asString();
+    if (executor == "caller")
+    {
+        callbackTarget_ = CallbackExecutor::Target::Caller;
+    }
+    else if (executor != "client")
+    {
+        throw invalid_argument("Unsupported callback_executor: " + executor);
+    }
+    if (config.isMember("deadline"))
+    {
+        const auto &deadline = config["deadline"];
+        deadlineHeader_ = deadline.get("header", deadlineHeader_).asString();
+        defaultDeadline_ = deadline.get("default_timeout", 0.0).asDouble();
+    }
+    if (config.isMember("outbox"))
+    {
+        const auto &outbox = config["outbox"];
+        if (!outbox["path"].isString())
+        {
+            throw invalid_argument("outbox.path is required");
+        }
+        outboxTimeout_ = outbox.get("timeout", outboxTimeout_).asDouble();
+        outbox_ = std::make_unique<Outbox>(
+            outbox["path"].asString(),
+            outbox.get("capacity", 64 << 20).asUInt64(),
+            outbox.get("batch_size", 64).asUInt(),
+            outbox.get("retry_interval", 1.0).asDouble(),
+            [this](const std::vector<string> &batch) {
+                return deliverOutbox(batch);
+            });
+    }
+    // Its thread starts with the first host with auth
+    tokenCache_ = std::make_unique<TokenCache>();
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex_);
+        auto table = buildRoutes(config);
+        auto auth = parseHostAuth(config, *table);
+        publishRoutes(std::move(table));
+        publishHostAuth(std::move(auth));
+    }
+
+    if (config.isMember("dns"))
+    {
+        const auto &dns = config["dns"];
+        std::unordered_map<string, string> staticHosts;
+        for (const auto &host : dns["hosts"].getMemberNames())
+        {
+            staticHosts[host] = dns["hosts"][host].asString();
+        }
+        // A changed address only affects the connections opened from now on
+        dnsCache_ = std::make_unique<DnsCache>(
+            dns.get("ttl", 60.0).asDouble(),
+            dns.get("happy_eyeballs", true).asBool(),
+            std::move(staticHosts),
+            [this](const string &url) {
+                std::lock_guard<std::mutex> lock(getMapMutex());
+                httpClientMap_.erase(url);
+            });
+        // Resolved on its thread rather than here or on the first calls
+        string host;
+        uint16_t port;
+        for (const auto &[name, route] : *routes())
+        {
+            const auto &url = route.request.host;
+            if (url && splitNamedHost(*url, host, port))
+            {
+                dnsCache_->lookup(*url, host, port);
+            }
+        }
+    }
+
+    const auto &prewarm = config["prewarm"];
+    prewarm_ = prewarm.isBool() ? prewarm.asBool() : prewarm.isObject();
+    if (prewarm.isObject())
+    {
+        prewarmPath_ = prewarm.get("path", prewarmPath_).asString();
+        prewarmTimeout_ = prewarm.get("timeout", prewarmTimeout_).asDouble();
+    }
+    if (prewarm_)
+    {
+        ready_ = false;
+        warmUp(*routes(), false, [this]() {
+            std::vector<std::function<void()>> callbacks;
+            {
+                std::lock_guard<std::mutex> lock(readyMutex_);
+                ready_ = true;
+                callbacks.swap(readyCallbacks_);
+            }
+            for (auto &callback : callbacks)
+            {
+                callback();
+            }
+        });
+    }
+
+    if (config.isMember("watch_file") && watchTimerId_ == 0)
+    {
+        watchedFile_ = config["watch_file"].asString();
+        std::error_code ec;
+        watchedFileTime_ = filesystem::last_write_time(watchedFile_, ec);
+        fileWatch_ = make_shared<FileWatch>();
+        fileWatch_->plugin = this;
+        watchTimerId_ = app().getLoop()->runEvery(
+            config.get("watch_interval", 2.0).asDouble(),
+            [watch = fileWatch_]() {
+                std::lock_guard<std::mutex> lock(watch->mutex);
+                if (watch->plugin)
+                {
+                    watch->plugin->checkWatchedFile();
+                }
+            });
+    }
+}
+
+void Muelsyse::reload(const Json::Value &config) noexcept(false)
+{
+    std::lock_guard<std::mutex> lock(reloadMutex_);
+    auto table = buildRoutes(config);
+    // Checked before anything is published, a bad auth item changes nothing
+    auto auth = parseHostAuth(config, *table);
+    publishRoutes(table);
+    publishHostAuth(std::move(auth));
+    LOG_INFO << "function_list reloaded";
+    if (prewarm_)
+    {
+        warmUp(*table, true, nullptr);
+    }
+}
+
+void Muelsyse::onReady(std::function<void()> callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(readyMutex_);
+        if (!ready_)
+        {
+            readyCallbacks_.push_back(std::move(callback));
+            return;
+        }
+    }
+    callback();
+}
+
+shared_ptr<Muelsyse::RouteTable> Muelsyse::buildRoutes(
+    const Json::Value &config) const
+{
+    auto current = routes();
+    const auto &functions = config["function_list"];
+    std::vector<std::pair<string, RestRoute>> built;
+    built.reserve(functions.isArray() ? functions.size() : 0);
+    std::unordered_map<string, shared_ptr<const TlsConfig>> tlsByHost;
+    HostNames hostNames;
+    // Keep counting where the previous configuration stopped
+    auto keepStats = [&current](const string &name, RestRoute &route) {
+        if (current)
+        {
+            auto old = current->find(name);
+            if (old != nullptr)
+            {
+                route.stats = old->stats;
+            }
+        }
+    };
+    // Without function_list the functions are kept, except those declared
+    // in code, which are built below
+    if (!config.isMember("function_list") && current)
+    {
+        std::unordered_set<std::string_view> declared;
+        for (const auto &[name, staticRoute] : staticRoutes())
+        {
+            declared.insert(name);
+        }
+        for (const auto &[name, route] : *current)
+        {
+            if (declared.count(name) > 0)
+            {
+                continue;
+            }
+            const auto &host = route.request.host;
+            if (host)
+            {
+                hostNames.emplace(*host, host);
+                if (route.tls)
+                {
+                    tlsByHost.try_emplace(*host, route.tls);
+                }
+            }
+            built.emplace_back(name, route);
+        }
+    }
+    if (functions.isArray())
+    {
+        for (const auto &function : functions)
+        {
+            const auto &name = function["name"];
+            const auto &url = function["url"];
+            const auto &httpMethod = function["http_method"];
+            if (!name.isString() || !url.isString() || !httpMethod.isString())
+            {
+                LOG_WARN
+                    << "An item in function_list is missing a required item "
+                    << "or is in the wrong format: "
+                    << function.toStyledString();
+                continue;
+            }
+            RestRoute route;
+            route.httpMethod = fromString(httpMethod.asString());
+            if (function.isMember("codec"))
+            {
+                auto codecName = function["codec"].asString();
+                route.codec = BodyCodec::get(codecName);
+                if (route.codec == nullptr)
+                {
+                    throw invalid_argument("Unsupported codec: " + codecName);
+                }
+            }
+            if (function.isMember("compression"))
+            {
+                parseCompression(function["compression"], route);
+            }
+            if (function.isMember("shadow"))
+            {
+                route.shadow = parseShadow(
+                    function["shadow"], route, hostNames, hostOptions_);
+            }
+            if (function.isMember("pagination"))
+            {
+                route.pagination = parsePagination(function["pagination"]);
+            }
+            if (function.isMember("priority"))
+            {
+                route.priority =
+                    priorityFromString(function["priority"].asString());
+            }
+            if (function.isMember("delivery"))
+            {
+                auto delivery = function["delivery"].asString();
+                if (delivery == "outbox")
+                {
+                    if (outbox_ == nullptr)
+                    {
+                        throw invalid_argument(
+                            "delivery: outbox of " + name.asString() +
+                            " needs the outbox to be configured");
+                    }
+                    route.outbox = true;
+                }
+                else if (delivery != "direct")
+                {
+                    throw invalid_argument("Unsupported delivery: " +
+                                           delivery);
+                }
+            }
+            route.request = compileRequest(
+                url.asString(), route, hostNames, hostOptions_);
+            if (function.isMember("tls"))
+            {
+                auto host = hostOf(url.asString());
+                if (!host.starts_with("https://"))
+                {
+                    throw invalid_argument("tls is set for a non-https url: " +
+                                           url.asString());
+                }
+                route.tls = parseTls(function["tls"]);
+                // The functions of a host share one pool and its settings,
+                // unchanged settings keep the pool across reloads.
+                auto [iter, inserted] = tlsByHost.try_emplace(host, route.tls);
+                if (!inserted && iter->second->source != route.tls->source)
+                {
+                    throw invalid_argument("Conflicting tls settings of " +
+                                           host);
+                }
+                if (inserted && current)
+                {
+                    for (const auto &[oldName, oldRoute] : *current)
+                    {
+                        if (oldRoute.tls && oldRoute.request.host &&
+                            oldRoute.tls->source == route.tls->source &&
+                            *oldRoute.request.host == host)
+                        {
+                            iter->second = oldRoute.tls;
+                            break;
+                        }
+                    }
+                }
+                route.tls = iter->second;
+            }
+            auto funcName = name.asString();
+            keepStats(funcName, route);
+            built.emplace_back(std::move(funcName), std::move(route));
+        }
+    }
+    // Routes declared in code, only their hosts can be configured
+    const auto &hosts = config["route_hosts"];
+    std::unordered_set<std::string_view> configured;
+    if (!staticRoutes().empty())
+    {
+        for (const auto &[builtName, builtRoute] : built)
+        {
+            configured.insert(builtName);
+        }
+    }
+    for (const auto &[name, staticRoute] : staticRoutes())
+    {
+        if (configured.count(name) > 0)
+        {
+            throw invalid_argument(
+                "Function declared both in code and in function_list: " +
+                name);
+        }
+        // Without route_hosts their hosts are kept
+        if (!config.isMember("route_hosts") && current)
+        {
+            auto old = current->find(name);
+            if (old != nullptr)
+            {
+                built.emplace_back(name, *old);
+                continue;
+            }
+        }
+        const auto &url = staticRoute->url;
+        RestRoute route;
+        route.httpMethod = staticRoute->method;
+        const bool hostSet = hosts.isMember(name);
+        auto configuredHost = hostSet ? hosts[name].asString() : string();
+        route.request = compileStaticRequest(
+            route,
+            url,
+            hostSet ? &configuredHost : nullptr,
+            hostNames,
+            hostOptions_);
+        keepStats(name, route);
+        built.emplace_back(name, std::move(route));
+    }
+    for (auto &[name, route] : built)
+    {
+        // Functions without tls use the settings of their host, if any
+        if (!tlsByHost.empty() && route.request.host)
+        {
+            auto iter = tlsByHost.find(*route.request.host);
+            if (iter != tlsByHost.end())
+            {
+                route.tls = iter->second;
+            }
+        }
+    }
+    return make_shared<RouteTable>(std::move(built));
+}
+
+shared_ptr<const Muelsyse::RouteTable> Muelsyse::routes() const
+{
+    // One slot per thread, taken by the instance that used it last, so a
+    // thread never keeps more than one table alive.
+    struct Cache
+    {
+        const Muelsyse *owner{nullptr};
+        uint64_t version{0};
+        shared_ptr<const RouteTable> table;
+    };
+    thread_local Cache cache;
+
+    // Versions are unique across instances, the owner is checked first so
+    // that a table is never handed to the wrong instance.
+    if (cache.owner != this ||
+        cache.version != routesVersion_.load(std::memory_order_acquire))
+    {
+        // Released before the lock, the last reader of a table frees it
+        cache.table.reset();
+        cache.owner = this;
+        std::lock_guard<std::mutex> lock(routesMutex_);
+        cache.table = routes_;
+        cache.version = routesVersion_.load(std::memory_order_relaxed);
+    }
+    return cache.table;
+}
+
+void Muelsyse::publishRoutes(shared_ptr<const RouteTable> table)
+{
+    static std::atomic<uint64_t> nextVersion{1};
+    std::lock_guard<std::mutex> lock(routesMutex_);
+    routes_ = std::move(table);
+    routesVersion_.store(nextVersion++, std::memory_order_release);
+}
+
+void Muelsyse::registerRest(const std::string &func_name,
+                            const std::string &url,
+                            RestRoute &&route)
+{
+    std::vector<Registration> functions;
+    functions.push_back({func_name, url, std::move(route)});
+    registerRest(std::move(functions));
+}
+
+void Muelsyse::registerRest(std::vector<Registration> &&functions)
+{
+    std::lock_guard<std::mutex> lock(reloadMutex_);
+    auto current = routes();
+    std::vector<std::pair<string, RestRoute>> items;
+    HostNames hostNames;
+    items.reserve((current ? current->size() : 0) + functions.size());
+    if (current)
+    {
+        for (const auto &[name, old] : *current)
+        {
+            items.emplace_back(name, old);
+            if (old.request.host)
+            {
+                hostNames.emplace(*old.request.host, old.request.host);
+            }
+        }
+    }
+    for (auto &[name, url, route] : functions)
+    {
+        route.request = compileRequest(url, route, hostNames, hostOptions_);
+        items.emplace_back(std::move(name), std::move(route));
+    }
+    publishRoutes(make_shared<RouteTable>(std::move(items)));
+}
+
+void Muelsyse::checkWatchedFile()
+{
+    std::error_code ec;
+    auto time = filesystem::last_write_time(watchedFile_, ec);
+    if (ec || time == watchedFileTime_)
+    {
+        return;
+    }
+    watchedFileTime_ = time;
+
+    std::ifstream in(watchedFile_);
+    Json::Value config;
+    std::string errs;
+    Json::CharReaderBuilder builder;
+    if (!Json::parseFromStream(builder, in, &config, &errs))
+    {
+        LOG_ERROR << "failed to parse " << watchedFile_ << ": " << errs;
+        return;
+    }
+    try
+    {
+        reload(config);
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR << "failed to reload " << watchedFile_ << ": " << e.what();
+    }
+}
+
+void Muelsyse::shutdown()
+{
+    /// Shutdown the plugin
+    outbox_.reset();
+    tokenCache_.reset();
+    dnsCache_.reset();
+    if (watchTimerId_ != 0)
+    {
+        // The timer is only cancelled once the loop gets to it, and a check
+        // may be running meanwhile
+        {
+            std::lock_guard<std::mutex> lock(fileWatch_->mutex);
+            fileWatch_->plugin = nullptr;
+        }
+        app().getLoop()->invalidateTimer(watchTimerId_);
+        watchTimerId_ = 0;
+    }
+}
+
+string Muelsyse::jsonToStringInPath(const Json::Value &json) const
+    noexcept(false)
+{
+    switch (json.type())
+    {
+        case Json::nullValue:
+            return "";
+        case Json::intValue:
+            return formattedString("%d", json.asInt());
+        case Json::uintValue:
+            return formattedString("%u", json.asUInt());
+        case Json::realValue:
+            return formattedString("%lf", json.asDouble());
+        case Json::stringValue:
+            return json.asString();
+        case Json::booleanValue:
+            return json.asBool() ? "true" : "false";
+        case Json::arrayValue:
+        {
+            if (json.size() == 0)
+                return "";
+            string result = "";
+            for (const auto &item : json)
+            {
+                result += jsonToStringInPath(item);
+                result += ',';
+            }
+            result.resize(result.size() - 1);
+            return result;
+        }
+            [[unlikely]] default  // objectValue
+                : throw invalid_argument(
+                      "JSON object cannot be converted to a string.");
+    }
+}
+
+PreparedCall tl::rest::Muelsyse::prepareCall(
+    const std::string &funcName,
+    const std::vector<Argument> &args,
+    bool waitForToken,
+    bool toOutbox) const
+{
+    assert(args.size() % 2 == 0);
+    auto table = routes();
+    const RestRoute *found;
+    if (table == nullptr || (found = table->find(funcName)) == nullptr)
+    {
+        throw std::invalid_argument("rest function not found: " + funcName);
+    }
+
+    auto options = CallScope::current();
+    if (options && options->deadline &&
+        *options->deadline <= std::chrono::steady_clock::now())
+    {
+        throw DeadlineExceeded("deadline exceeded before calling " + funcName);
+    }
+    if (options && options->cancelToken && options->cancelToken->isCancelled())
+    {
+        throw CallCancelled();
+    }
+
+    const auto &route = *found;
+    const auto &request = route.request;
+    Json::Value requestBody(Json::objectValue);
+    std::vector<std::string> pathValues;
+    // parameter processing
+    for (int i = 0; i < args.size(); i += 2)
+    {
+        auto key = args[i].toJson();
+        if (!key.isString())
+        {
+            throw std::invalid_argument(
+                "Incorrect parameter configuration of " + funcName);
+        }
+        std::string arg = key.asString();
+        // path parameter, fills the next placeholder of the url
+        if (arg == "_")
+        {
+            if (pathValues.size() == request.placeholders.size())
+            {
+                throw std::invalid_argument(
+                    "Incorrect parameter configuration of " + funcName);
+            }
+            pathValues.push_back(jsonToStringInPath(args[i + 1].toJson()));
+        }
+        // root parameter
+        else if (arg == "")
+        {
+            if (!requestBody.empty())
+            {
+                // If the request body already has data, the new parameter
+                // should not be placed as root
+                throw std::invalid_argument(
+                    "Incorrect parameter configuration of " + funcName);
+            }
+            requestBody = args[i + 1].toJson();
+        }
+        // request body parameter
+        else
+        {
+            requestBody[arg] = args[i + 1].toJson();
+        }
+    }
+    std::string host;
+    std::string path;
+    fillTemplate(request, pathValues, host, path);
+    auto pool = getClientPool(host, route.tls);
+    auto httpClient = pool->pick();
+    auto req = newEncodedRequest(route, requestBody);
+    req->setPath(path);
+    req->setMethod(route.httpMethod);
+    if (!pool->hostHeader.empty())
+    {
+        req->addHeader("Host", pool->hostHeader);
+    }
+    for (const auto &[field, value] : request.headers)
+    {
+        req->addHeader(field, value);
+    }
+    auto tokenAdded = addAuthHeader(host, *req, waitForToken);
+    // The call keeps the whole table it was built from alive
+    PreparedCall call{
+        httpClient,
+        req,
+        shared_ptr<const RestRoute>(std::move(table), found),
+        std::move(host),
+        pool->scheduler,
+        options && options->priority ? *options->priority : route.priority,
+        options ? options->deadline : std::nullopt,
+        options ? options->cancelToken : std::nullopt};
+    auto target = options && options->executor ? options->executor->target
+                                                : callbackTarget_;
+    if (target == CallbackExecutor::Target::Caller)
+    {
+        call.callbackLoop = CallerLoop::current();
+    }
+    else if (target == CallbackExecutor::Target::Custom)
+    {
+        call.execute = options->executor->execute;
+    }
+    if (!tokenAdded)
+    {
+        call.pendingAuth = authOf(call.host);
+    }
+    // Calls queued in the outbox are never sent from here, nor shadowed
+    if (route.shadow && !(toOutbox && route.outbox && outbox_) &&
+        sampled(route.shadow->sampleRate))
+    {
+        call.shadow = prepareShadow(route, pathValues, call.host, *req);
+    }
+    return call;
+}
+
+#ifdef MUELSYSE_WITH_BROTLI
+/**
+ * @brief Compress data with brotli, at a quality that suits bodies sent per
+ * call rather than files compressed once.
+ *
+ * @return An empty string on failure.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static string brotliEncode(std::string_view data)
+{
+    string out(BrotliEncoderMaxCompressedSize(data.size()), '\0');
+    auto size = out.size();
+    if (out.empty() ||
+        !BrotliEncoderCompress(5,
+                               BROTLI_DEFAULT_WINDOW,
+                               BROTLI_MODE_GENERIC,
+                               data.size(),
+                               reinterpret_cast<const uint8_t *>(data.data()),
+                               &size,
+                               reinterpret_cast<uint8_t *>(out.data())))
+    {
+        return {};
+    }
+    out.resize(size);
+    return out;
+}
+
+/**
+ * @brief Decompress a brotli stream.
+ *
+ * @return An empty string if data is corrupt or incomplete.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static string brotliDecode(std::string_view data)
+{
+    auto *decoder = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+    if (decoder == nullptr)
+    {
+        return {};
+    }
+    string out;
+    auto *next = reinterpret_cast<const uint8_t *>(data.data());
+    auto available = data.size();
+    auto result = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+    while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT)
+    {
+        uint8_t buffer[16384];
+        auto *outNext = buffer;
+        size_t outAvailable = sizeof(buffer);
+        result = BrotliDecoderDecompressStream(
+            decoder, &available, &next, &outAvailable, &outNext, nullptr);
+        out.append(reinterpret_cast<const char *>(buffer),
+                   sizeof(buffer) - outAvailable);
+    }
+    BrotliDecoderDestroyInstance(decoder);
+    if (result != BROTLI_DECODER_RESULT_SUCCESS)
+    {
+        out.clear();
+    }
+    return out;
+}
+#endif
+
+drogon::HttpRequestPtr tl::rest::Muelsyse::newEncodedRequest(
+    const RestRoute &route,
+    const Json::Value &requestBody)
+{
+    static const JsonCodec jsonCodec;
+    const BodyCodec &codec = route.codec ? *route.codec : jsonCodec;
+    // Serialize into a buffer that is large enough from the start, it is
+    // then moved into the request as it is
+    auto &hint = route.stats->requestBodyHint;
+    auto reserved = hint.load(std::memory_order_relaxed);
+    string body;
+    body.reserve(reserved + reserved / 8);
+    codec.encode(requestBody, body);
+    route.stats->requestBytes += body.size();
+    // The mark decays by 1/16 per call, so that a single large body does not
+    // keep the buffers of a route oversized
+    hint.store(std::max(body.size(), reserved - reserved / 16),
+               std::memory_order_relaxed);
+
+    auto req = HttpRequest::newHttpRequest();
+    if (route.codec)
+    {
+        req->setContentTypeString(codec.contentType());
+    }
+    else
+    {
+        req->setContentTypeCode(CT_APPLICATION_JSON);
+    }
+    if (route.compression != Compression::None &&
+        body.size() >= route.compressMinSize)
     {
-        for (const auto &function : config["function_list"])
+        string compressed;
+        const char *encoding{nullptr};
+#ifdef MUELSYSE_WITH_BROTLI
+        if (route.compression == Compression::Brotli)
         {
-            string name{""};
-            if (function.isMember("name") &&
-                function["name"].type() == Json::ValueType::stringValue)
-            {
-                name = function["name"].asString();
-            }
-            else
-            {
-                LOG_WARN
-                    << "An item in function_list is missing a required item "
-                    << "or is in the wrong format: "
-                    << function.toStyledString();
-                continue;
-            }
-            string url{""};
-            if (function.isMember("url") &&
-                function["url"].type() == Json::ValueType::stringValue)
+            compressed = brotliEncode(body);
+            encoding = "br";
+        }
+        else
+#endif
+        {
+            compressed = gzipCompress(body.data(), body.size());
+            encoding = "gzip";
+        }
+        // Incompressible bodies are sent as they are
+        if (!compressed.empty() && compressed.size() < body.size())
+        {
+            LOG_TRACE << "request body compressed with " << encoding << ": "
+                      << body.size() << " -> " << compressed.size();
+            req->addHeader("Content-Encoding", encoding);
+            body = std::move(compressed);
+        }
+    }
+    route.stats->requestBytesSent += body.size();
+    req->setBody(std::move(body));
+    return req;
+}
+
+/**
+ * @brief Decompress a body sent with Content-Encoding gzip, or br when
+ * brotli is available.
+ *
+ * @return false if the encoding is unknown or the body is corrupt.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static bool decompressBody(const string &encoding,
+                           std::string_view body,
+                           string &out)
+{
+    out.clear();
+    if (encoding == "gzip")
+    {
+        out = gzipDecompress(body.data(), body.size());
+    }
+#ifdef MUELSYSE_WITH_BROTLI
+    else if (encoding == "br")
+    {
+        out = brotliDecode(body);
+    }
+#endif
+    return !out.empty();
+}
+
+std::shared_ptr<const Json::Value> Muelsyse::getResponseJson(
+    const RestRoute &route,
+    const HttpResponsePtr &resp)
+{
+    static const JsonCodec jsonCodec;
+    const BodyCodec *codec = &jsonCodec;
+    if (route.codec && resp->getHeader("content-type")
+                           .starts_with(route.codec->contentType()))
+    {
+        codec = route.codec.get();
+    }
+
+    const auto &encoding = resp->getHeader("content-encoding");
+    bool compressed = !encoding.empty() && encoding != "identity";
+    if (!compressed && codec == &jsonCodec)
+    {
+        return resp->getJsonObject();
+    }
+
+    auto body = resp->body();
+    string decompressed;
+    if (compressed)
+    {
+        if (!decompressBody(encoding, body, decompressed))
+        {
+            LOG_ERROR << "failed to decode the response of "
+                      << urlOf(route.request)
+                      << " with Content-Encoding: " << encoding;
+            return nullptr;
+        }
+        route.stats->responseBytesReceived += body.size();
+        route.stats->responseBytes += decompressed.size();
+        LOG_TRACE << "response body of " << urlOf(route.request)
+                  << " decompressed: " << body.size() << " -> "
+                  << decompressed.size();
+        body = decompressed;
+    }
+
+    auto json = std::make_shared<Json::Value>();
+    if (!codec->decode(body, *json))
+    {
+        return nullptr;
+    }
+    return json;
+}
+
+StreamResponse Muelsyse::restCallStream(const string &funcName,
+                                        const std::vector<Argument> &args,
+                                        const StreamSink &sink,
+                                        const StreamOptions &options) const
+{
+    auto call = prepareCall(funcName, args);
+    const auto &client = call.client;
+    if (client->secure())
+    {
+        throw invalid_argument("streaming is not supported for https: " +
+                               funcName);
+    }
+    if (dynamic_cast<InprocClient *>(client.get()) != nullptr)
+    {
+        throw invalid_argument("streaming is not supported for inproc: " +
+                               funcName);
+    }
+#ifdef MUELSYSE_WITH_NGHTTP2
+    if (dynamic_cast<Http2Client *>(client.get()) != nullptr)
+    {
+        throw invalid_argument("streaming is not supported for h2: " +
+                               funcName);
+    }
+#endif
+
+    const auto &request = *call.request;
+    string head = request.methodString();
+    head.append(" ").append(urlEncode(request.path()));
+    if (!request.query().empty())
+    {
+        head.append("?").append(request.query());
+    }
+    head.append(" HTTP/1.1\r\n");
+    auto headers = request.headers();
+    auto unixClient = dynamic_cast<UnixClient *>(client.get()) != nullptr;
+    if (unixClient)
+    {
+        headers.try_emplace("host", "localhost");
+    }
+    else if (headers.find("host") == headers.end())
+    {
+        auto host = client->host();
+        if (host.find(':') != string::npos)
+        {
+            host = "[" + host + "]";
+        }
+        if (client->port() != 80)
+        {
+            host += ":" + std::to_string(client->port());
+        }
+        headers["host"] = std::move(host);
+    }
+    // The body is handed over as it is, undecoded
+    headers["accept-encoding"] = "identity";
+    headers["connection"] = "close";
+    auto body = request.body();
+    if (!body.empty())
+    {
+        headers["content-type"] =
+            call.route->codec ? string(call.route->codec->contentType())
+                              : "application/json";
+        headers["content-length"] = std::to_string(body.size());
+    }
+    for (const auto &[field, value] : headers)
+    {
+        head.append(field).append(": ").append(value).append("\r\n");
+    }
+    head.append("\r\n");
+
+    auto stream =
+        unixClient
+            ? HttpStream::connectUnix(client->host(), options)
+            : HttpStream::connectTcp(client->host(), client->port(), options);
+    stream.send(head, body);
+    auto response = stream.readHead(request.method() == Head);
+    if (response.status < 200 || response.status >= 300)
+    {
+        // Keep the start of the body for the message, then drop the rest
+        string message;
+        stream.readBody(response, [&message](std::string_view chunk) {
+            message.append(chunk.substr(0, 1024 - message.size()));
+            return message.size() < 1024;
+        });
+        throw std::runtime_error(funcName + " returned status " +
+                                 std::to_string(response.status) + ": " +
+                                 message);
+    }
+    stream.readBody(response, sink);
+    return response;
+}
+
+struct tl::rest::PageFetch
+{
+    using Page = std::optional<Json::Value>;
+
+    const Muelsyse *owner{nullptr};
+    string funcName;
+    std::vector<Argument> args;
+    shared_ptr<const PaginationConfig> config;
+    /// The position of the cursor in the path arguments, if it goes in the
+    /// url.
+    std::optional<size_t> cursorPlaceholder;
+    CallOptions options;
+
+    std::mutex mutex;
+    /// Null for the first page.
+    Json::Value cursor;
+    /// Fetched, not taken by next() yet.
+    std::deque<Json::Value> pages;
+    /// The calls of next() that wait for a page.
+    std::deque<std::promise<Page>> waiting;
+    std::exception_ptr error;
+    bool fetching{false};
+    bool done{false};
+    bool stopped{false};
+
+    /// Whether to fetch the next page now, with mutex held.
+    bool startFetch()
+    {
+        if (fetching || done || error || stopped ||
+            (waiting.empty() && pages.size() >= config->prefetch))
+        {
+            return false;
+        }
+        fetching = true;
+        return true;
+    }
+
+    /// Hand out a page, or the error of the call, and tell whether to fetch
+    /// the next page.
+    bool complete(Page page, Json::Value next, std::exception_ptr failure)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fetching = false;
+        if (failure)
+        {
+            error = failure;
+            for (auto &promise : waiting)
             {
-                url = function["url"].asString();
+                promise.set_exception(error);
             }
-            else
+            waiting.clear();
+            return false;
+        }
+        if (!waiting.empty())
+        {
+            waiting.front().set_value(std::move(page));
+            waiting.pop_front();
+        }
+        else
+        {
+            pages.push_back(std::move(*page));
+        }
+        cursor = std::move(next);
+        done = cursor.isNull() || (cursor.isString() && cursor.empty());
+        if (done)
+        {
+            for (auto &promise : waiting)
             {
-                LOG_WARN
-                    << "An item in function_list is missing a required item "
-                    << "or is in the wrong format: "
-                    << function.toStyledString();
-                continue;
+                promise.set_value(std::nullopt);
             }
-            string httpMethod{""};
-            if (function.isMember("http_method") &&
-                function["http_method"].type() == Json::ValueType::stringValue)
+            waiting.clear();
+        }
+        return startFetch();
+    }
+};
+
+PageStream::~PageStream()
+{
+    if (fetch_)
+    {
+        std::lock_guard<std::mutex> lock(fetch_->mutex);
+        fetch_->stopped = true;
+    }
+}
+
+std::future<std::optional<Json::Value>> PageStream::next()
+{
+    std::promise<PageFetch::Page> promise;
+    auto future = promise.get_future();
+    bool fetch;
+    {
+        std::lock_guard<std::mutex> lock(fetch_->mutex);
+        // The pages fetched before an error are still handed out
+        if (!fetch_->pages.empty())
+        {
+            promise.set_value(std::move(fetch_->pages.front()));
+            fetch_->pages.pop_front();
+        }
+        else if (fetch_->error)
+        {
+            promise.set_exception(fetch_->error);
+        }
+        else if (fetch_->done)
+        {
+            promise.set_value(std::nullopt);
+        }
+        else
+        {
+            fetch_->waiting.push_back(std::move(promise));
+        }
+        fetch = fetch_->startFetch();
+    }
+    if (fetch)
+    {
+        fetch_->owner->fetchPage(fetch_);
+    }
+    return future;
+}
+
+PageStream Muelsyse::restCallPages(const string &funcName,
+                                   const std::vector<Argument> &args) const
+    noexcept(false)
+{
+    auto table = routes();
+    const RestRoute *route;
+    if (table == nullptr || (route = table->find(funcName)) == nullptr)
+    {
+        throw invalid_argument("rest function not found: " + funcName);
+    }
+    if (route->pagination == nullptr)
+    {
+        throw invalid_argument("rest function is not paginated: " + funcName);
+    }
+    auto fetch = make_shared<PageFetch>();
+    fetch->owner = this;
+    fetch->funcName = funcName;
+    fetch->args = args;
+    fetch->config = route->pagination;
+    const auto &placeholders = route->request.placeholders;
+    auto placeholder = std::find(placeholders.begin(),
+                                 placeholders.end(),
+                                 "{" + fetch->config->cursor + "}");
+    if (placeholder != placeholders.end())
+    {
+        fetch->cursorPlaceholder = placeholder - placeholders.begin();
+        // The path arguments before the cursor must all be given
+        size_t pathArgs = 0;
+        for (size_t i = 0; i < args.size(); i += 2)
+        {
+            const auto &key = args[i].toJson();
+            pathArgs += key.isString() && key.asString() == "_";
+        }
+        if (pathArgs < *fetch->cursorPlaceholder)
+        {
+            throw invalid_argument("Incorrect parameter configuration of " +
+                                   funcName);
+        }
+    }
+    if (auto options = CallScope::current())
+    {
+        fetch->options = *options;
+    }
+    // Setting the promises can be done anywhere, a hop would only cost time
+    fetch->options.executor = CallbackExecutor::client();
+    fetch->fetching = true;
+    fetchPage(fetch);
+    return PageStream(std::move(fetch));
+}
+
+void Muelsyse::fetchPage(const shared_ptr<PageFetch> &fetch) const
+{
+    // Only one page is fetched at a time, the cursor is not written meanwhile
+    std::vector<Argument> args;
+    args.reserve(fetch->args.size() + 2);
+    const auto &cursor = fetch->cursor;
+    auto addCursor = [this, &args, &cursor]() {
+        args.emplace_back("_");
+        args.emplace_back(urlEncodeComponent(jsonToStringInPath(cursor)));
+    };
+    size_t pathArgs = 0;
+    for (size_t i = 0; i < fetch->args.size(); i += 2)
+    {
+        const auto &key = fetch->args[i].toJson();
+        if (key.isString() && key.asString() == "_" &&
+            pathArgs++ == fetch->cursorPlaceholder)
+        {
+            addCursor();
+        }
+        args.push_back(fetch->args[i]);
+        args.push_back(fetch->args[i + 1]);
+    }
+    if (pathArgs == fetch->cursorPlaceholder)
+    {
+        addCursor();
+    }
+    else if (!fetch->cursorPlaceholder && !cursor.isNull())
+    {
+        args.emplace_back(fetch->config->cursor);
+        args.emplace_back(cursor);
+    }
+
+    PreparedCall call;
+    try
+    {
+        CallScope scope(fetch->options);
+        call = prepareCall(fetch->funcName, args, false);
+    }
+    catch (...)
+    {
+        fetch->complete(
+            std::nullopt, Json::nullValue, std::current_exception());
+        return;
+    }
+    send(call,
+         [this, fetch, route = call.route, cancelToken = call.cancelToken](
+             ReqResult result, const HttpResponsePtr &resp) {
+             PageFetch::Page page;
+             Json::Value next;
+             std::exception_ptr error;
+             try
+             {
+                 if (cancelToken && cancelToken->isCancelled())
+                 {
+                     throw CallCancelled();
+                 }
+                 if (result != ReqResult::Ok)
+                 {
+                     throw std::runtime_error(
+                         "The request failed. It may be a network problem "
+                         "or a configuration error");
+                 }
+                 if (resp->statusCode() < 200 || resp->statusCode() >= 300)
+                 {
+                     throw std::runtime_error(formattedString(
+                         "%s returned status %d",
+                         fetch->funcName.c_str(),
+                         resp->statusCode()));
+                 }
+                 auto json = getResponseJson(*route, resp);
+                 if (json == nullptr)
+                 {
+                     throw std::runtime_error("response body is not json.");
+                 }
+                 const auto &config = *fetch->config;
+                 auto items = findPath(*json, config.items);
+                 if (items == nullptr)
+                 {
+                     throw std::runtime_error("no page in the response of " +
+                                              fetch->funcName);
+                 }
+                 page = *items;
+                 if (auto cursor = findPath(*json, config.nextCursor))
+                 {
+                     next = *cursor;
+                 }
+             }
+             catch (...)
+             {
+                 error = std::current_exception();
+             }
+             if (fetch->complete(std::move(page), std::move(next), error))
+             {
+                 fetchPage(fetch);
+             }
+         });
+}
+
+Json::Value Muelsyse::getStats(const string &funcName) const
+{
+    auto table = routes();
+    const RestRoute *route;
+    if (table == nullptr || (route = table->find(funcName)) == nullptr)
+    {
+        return Json::nullValue;
+    }
+    const auto &stats = *route->stats;
+    Json::Value result;
+    result["request_bytes"] = (Json::UInt64)stats.requestBytes;
+    result["request_bytes_sent"] = (Json::UInt64)stats.requestBytesSent;
+    result["response_bytes_received"] =
+        (Json::UInt64)stats.responseBytesReceived;
+    result["response_bytes"] = (Json::UInt64)stats.responseBytes;
+    result["request_body_hint"] = (Json::UInt64)stats.requestBodyHint;
+    result["calls"] = (Json::UInt64)stats.calls;
+    result["failed_calls"] = (Json::UInt64)stats.failedCalls;
+    result["latency_us_avg"] =
+        (Json::UInt64)(stats.calls ? stats.latencyTotalUs / stats.calls : 0);
+    result["latency_us_max"] = (Json::UInt64)stats.latencyMaxUs;
+    auto host = route->request.host ? *route->request.host : string();
+    auto options = hostOptions_.find(host);
+    result["protocol"] =
+        options != hostOptions_.end() && options->second.http2 ? "h2"
+                                                               : "http/1.1";
+    result["connections"] = 0;
+    {
+        std::lock_guard<std::mutex> lock(getMapMutex());
+        auto pool = httpClientMap_.find(host);
+        if (pool != httpClientMap_.end())
+        {
+            result["connections"] = (Json::UInt64)*pool->second->connections;
+#ifdef MUELSYSE_WITH_NGHTTP2
+            // Only the h2 transport owns its TLS sessions, drogon keeps them
+            // out of reach
+            if (host.starts_with("https://") && options != hostOptions_.end() &&
+                options->second.http2)
             {
-                httpMethod = function["http_method"].asString();
+                uint64_t full = 0;
+                uint64_t resumed = 0;
+                for (const auto &client : pool->second->clients)
+                {
+                    const auto *http2 =
+                        dynamic_cast<const Http2Client *>(client.get());
+                    if (http2 != nullptr)
+                    {
+                        full += http2->fullHandshakes();
+                        resumed += http2->resumedHandshakes();
+                    }
+                }
+                result["tls_handshakes"]["full"] = (Json::UInt64)full;
+                result["tls_handshakes"]["resumed"] = (Json::UInt64)resumed;
             }
-            else
+#endif
+            if (pool->second->scheduler)
             {
-                LOG_WARN
-                    << "An item in function_list is missing a required item "
-                    << "or is in the wrong format: "
-                    << function.toStyledString();
-                continue;
+                result["queued"] =
+                    (Json::UInt64)pool->second->scheduler->queued();
+                result["in_flight"] =
+                    (Json::UInt64)pool->second->scheduler->inFlight();
             }
-            registerRest(name, url, fromString(httpMethod));
         }
     }
+    if (route->shadow)
+    {
+        auto &shadow = result["shadow"];
+        shadow["calls"] = (Json::UInt64)stats.shadowCalls;
+        shadow["failed_calls"] = (Json::UInt64)stats.shadowFailedCalls;
+        shadow["dropped"] = (Json::UInt64)stats.shadowDropped;
+        shadow["in_flight"] = (Json::UInt64)stats.shadowInFlight;
+        shadow["latency_us_avg"] =
+            (Json::UInt64)(stats.shadowCalls
+                               ? stats.shadowLatencyTotalUs / stats.shadowCalls
+                               : 0);
+        shadow["latency_us_max"] = (Json::UInt64)stats.shadowLatencyMaxUs;
+        shadow["status_diffs"] = (Json::UInt64)stats.shadowStatusDiffs;
+        shadow["body_diffs"] = (Json::UInt64)stats.shadowBodyDiffs;
+    }
+    return result;
+}
+
+static uint64_t microsecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+/**
+ * @brief Compute the timeout of a request from its deadline, and tell the
+ * server about it.
+ *
+ * @return false if the deadline has passed.
+ */
+static bool timeoutFromDeadline(
+    const std::optional<std::chrono::steady_clock::time_point> &deadline,
+    const HttpRequestPtr &request,
+    const string &header,
+    double &timeout)
+{
+    timeout = 0;
+    if (!deadline)
+    {
+        return true;
+    }
+    auto left = *deadline - std::chrono::steady_clock::now();
+    if (left <= left.zero())
+    {
+        return false;
+    }
+    timeout = std::chrono::duration<double>(left).count();
+    if (!header.empty())
+    {
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(left);
+        request->addHeader(header, std::to_string(ms.count()));
+    }
+    return true;
+}
+
+/// What the comparison of a shadow call needs from a response.
+struct ResponseCopy
+{
+    bool ok{false};
+    int status{0};
+    string contentType;
+    string encoding;
+    string body;
+};
+
+struct tl::rest::ShadowCall
+{
+    HttpClientPtr client;
+    HttpRequestPtr request;
+    std::shared_ptr<RouteStats> stats;
+    /// The codec of the function, nullptr for JSON.
+    std::shared_ptr<const BodyCodec> codec;
+    size_t maxInFlight{0};
+    double timeout{0};
+
+    std::mutex mutex;
+    /// Set once each response, or failure, has arrived. The response of the
+    /// call belongs to the caller, so it is copied rather than shared.
+    std::optional<ResponseCopy> primary;
+    std::optional<ResponseCopy> shadow;
+};
+
+/**
+ * @brief Decode a body the way getResponseJson would, but without touching
+ * the response or the stats.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static bool decodeCopy(const BodyCodec *codec,
+                       const ResponseCopy &copy,
+                       Json::Value &json)
+{
+    static const JsonCodec jsonCodec;
+    if (codec == nullptr || !copy.contentType.starts_with(codec->contentType()))
+    {
+        codec = &jsonCodec;
+    }
+    std::string_view body = copy.body;
+    string decompressed;
+    if (!copy.encoding.empty() && copy.encoding != "identity")
+    {
+        if (!decompressBody(copy.encoding, body, decompressed))
+        {
+            return false;
+        }
+        body = decompressed;
+    }
+    return codec->decode(body, json);
+}
+
+/**
+ * @brief Count the differences between the responses of a shadow call and
+ * of its call: the status, or else the body, compared as decoded values when
+ * both decode.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static void compareShadow(const ShadowCall &shadow)
+{
+    const auto &primary = *shadow.primary;
+    const auto &copy = *shadow.shadow;
+    // Failures are counted as such, there is nothing to compare
+    if (!primary.ok || !copy.ok)
+    {
+        return;
+    }
+    if (primary.status != copy.status)
+    {
+        ++shadow.stats->shadowStatusDiffs;
+        return;
+    }
+    if (primary.body == copy.body && primary.encoding == copy.encoding)
+    {
+        return;
+    }
+    Json::Value primaryJson;
+    Json::Value copyJson;
+    if (!decodeCopy(shadow.codec.get(), primary, primaryJson) ||
+        !decodeCopy(shadow.codec.get(), copy, copyJson) ||
+        primaryJson != copyJson)
+    {
+        ++shadow.stats->shadowBodyDiffs;
+    }
+}
+
+/**
+ * @brief Record the response, or failure, of a shadow call or of its call,
+ * and compare them once both have arrived.
+ *
+ * The comparison always runs on the loop of the shadow client, off the path
+ * of the call, and only reads copies of the responses.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static void completeShadow(const shared_ptr<ShadowCall> &shadow,
+                           bool isShadow,
+                           ReqResult result,
+                           const HttpResponsePtr &resp)
+{
+    {
+        ResponseCopy copy;
+        copy.ok = result == ReqResult::Ok;
+        if (copy.ok)
+        {
+            copy.status = resp->statusCode();
+            copy.contentType = resp->getHeader("content-type");
+            copy.encoding = resp->getHeader("content-encoding");
+            copy.body = resp->body();
+        }
+        std::lock_guard<std::mutex> lock(shadow->mutex);
+        (isShadow ? shadow->shadow : shadow->primary) = std::move(copy);
+        if (!shadow->primary || !shadow->shadow)
+        {
+            return;
+        }
+    }
+    if (isShadow)
+    {
+        compareShadow(*shadow);
+    }
+    else
+    {
+        shadow->client->getLoop()->queueInLoop(
+            [shadow]() { compareShadow(*shadow); });
+    }
+}
+
+/**
+ * @brief Send the shadow call, if any, unless too many are in flight.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+static void startShadow(const shared_ptr<ShadowCall> &shadow)
+{
+    if (!shadow)
+    {
+        return;
+    }
+    auto &stats = *shadow->stats;
+    if (++stats.shadowInFlight > shadow->maxInFlight)
+    {
+        --stats.shadowInFlight;
+        ++stats.shadowDropped;
+        return;
+    }
+    shadow->client->sendRequest(
+        shadow->request,
+        [shadow, sentAt = std::chrono::steady_clock::now()](
+            ReqResult result, const HttpResponsePtr &resp) {
+            auto &stats = *shadow->stats;
+            --stats.shadowInFlight;
+            stats.recordShadowCall(result == ReqResult::Ok,
+                                   microsecondsSince(sentAt));
+            completeShadow(shadow, true, result, resp);
+        },
+        shadow->timeout);
+}
+
+shared_ptr<CallerLoop> CallerLoop::current()
+{
+    thread_local shared_ptr<CallerLoop> current;
+    auto *loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    if (loop == nullptr)
+    {
+        return nullptr;
+    }
+    // A thread may run another loop once the previous one has quit
+    bool stale = current == nullptr || current->loop_ != loop;
+    if (!stale)
+    {
+        std::lock_guard<std::mutex> lock(current->mutex_);
+        stale = !current->open_;
+    }
+    if (stale)
+    {
+        current = make_shared<CallerLoop>(loop);
+        loop->runOnQuit([caller = current]() {
+            std::lock_guard<std::mutex> lock(caller->mutex_);
+            caller->open_ = false;
+        });
+    }
+    return current;
 }
 
-void Muelsyse::shutdown()
+bool CallerLoop::queue(std::function<void()> &&task)
 {
-    /// Shutdown the plugin
+    // Held while queueing, so the loop cannot quit in between
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_)
+    {
+        return false;
+    }
+    loop_->queueInLoop(std::move(task));
+    return true;
 }
 
-string Muelsyse::jsonToStringInPath(const Json::Value &json) const
-    noexcept(false)
+/**
+ * @brief The callback of an asynchronous call with what it completes with,
+ * made once per call by send().
+ *
+ * It is handed from the thread of the response to the loop of the call as a
+ * pointer, so the hop allocates no task of its own. Custom executors get a
+ * task that shares it instead, so one that drops the task frees it too.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct Completion
 {
-    switch (json.type())
+    shared_ptr<RouteStats> stats;
+    std::chrono::steady_clock::time_point sentAt;
+    shared_ptr<CallerLoop> loop;
+    shared_ptr<const CallbackExecutor::Execute> execute;
+    shared_ptr<ShadowCall> shadow;
+    HttpReqCallback callback;
+    ReqResult result{ReqResult::Ok};
+    HttpResponsePtr resp;
+
+    void run()
     {
-        case Json::nullValue:
-            return "";
-        case Json::intValue:
-            return formattedString("%d", json.asInt());
-        case Json::uintValue:
-            return formattedString("%u", json.asUInt());
-        case Json::realValue:
-            return formattedString("%lf", json.asDouble());
-        case Json::stringValue:
-            return json.asString();
-        case Json::booleanValue:
-            return json.asBool() ? "true" : "false";
-        case Json::arrayValue:
+        callback(result, resp);
+    }
+};
+
+void Muelsyse::send(const PreparedCall &call,
+                    HttpReqCallback &&callback,
+                    bool dispatch) const
+{
+    // Timed from here, so the time spent queued counts too. Only the
+    // pointer to the completion is passed around, which std::function keeps
+    // without allocating.
+    auto *completion = new Completion{call.route->stats,
+                                      std::chrono::steady_clock::now(),
+                                      dispatch ? call.callbackLoop : nullptr,
+                                      dispatch ? call.execute : nullptr,
+                                      call.shadow,
+                                      std::move(callback)};
+    callback = [completion](ReqResult result, const HttpResponsePtr &resp) {
+        std::unique_ptr<Completion> owned(completion);
+        owned->stats->recordCall(result == ReqResult::Ok,
+                                 microsecondsSince(owned->sentAt));
+        if (owned->shadow)
         {
-            if (json.size() == 0)
-                return "";
-            string result = "";
-            for (const auto &item : json)
+            completeShadow(owned->shadow, false, result, resp);
+        }
+        owned->result = result;
+        owned->resp = resp;
+        if (owned->execute)
+        {
+            // Kept aside, a task run inline frees the completion
+            auto execute = owned->execute;
+            (*execute)([shared = shared_ptr<Completion>(std::move(owned))]() {
+                shared->run();
+            });
+            return;
+        }
+        const auto &loop = owned->loop;
+        if (loop != nullptr && !loop->isInLoopThread() &&
+            loop->queue([completion]() {
+                std::unique_ptr<Completion>(completion)->run();
+            }))
+        {
+            // Owned by the queued task now
+            owned.release();
+            return;
+        }
+        owned->run();
+    };
+    if (call.cancelToken)
+    {
+        // Complete once, with the response or as soon as the token is
+        // cancelled; a response that arrives later is dropped.
+        struct Pending
+        {
+            std::atomic<bool> done{false};
+            HttpReqCallback callback;
+            CancelToken token;
+            uint64_t id{0};
+        };
+        auto pending = make_shared<Pending>();
+        pending->callback = std::move(callback);
+        pending->token = *call.cancelToken;
+        callback = [pending](ReqResult result, const HttpResponsePtr &resp) {
+            if (!pending->done.exchange(true))
             {
-                result += jsonToStringInPath(item);
-                result += ',';
+                pending->token.removeCallback(pending->id);
+                pending->callback(result, resp);
             }
-            result.resize(result.size() - 1);
-            return result;
+        };
+        pending->id = pending->token.onCancel(
+            [callback]() { callback(ReqResult::NetworkFailure, nullptr); });
+    }
+    auto start = [client = call.client,
+                  request = call.request,
+                  deadline = call.deadline,
+                  cancelToken = call.cancelToken,
+                  shadow = call.shadow,
+                  header = deadlineHeader_](HttpReqCallback &&callback) {
+        // Cancelled while queued, the callback has run already
+        if (cancelToken && cancelToken->isCancelled())
+        {
+            callback(ReqResult::NetworkFailure, nullptr);
+            return;
         }
-            [[unlikely]] default  // objectValue
-                : throw invalid_argument(
-                      "JSON object cannot be converted to a string.");
+        double timeout;
+        if (!timeoutFromDeadline(deadline, request, header, timeout))
+        {
+            callback(ReqResult::Timeout, nullptr);
+            return;
+        }
+        // Only calls that are really sent are shadowed
+        startShadow(shadow);
+        client->sendRequest(request, std::move(callback), timeout);
+    };
+    auto submit = [start = std::move(start),
+                   scheduler = call.scheduler,
+                   priority = call.priority](
+                      HttpReqCallback &&callback) mutable {
+        if (!scheduler)
+        {
+            start(std::move(callback));
+            return;
+        }
+        // The slot is released before the callback, which may take a while
+        scheduler->submit(
+            priority,
+            [start = std::move(start),
+             scheduler,
+             callback = std::move(callback)]() mutable {
+                start([scheduler, callback = std::move(callback)](
+                          ReqResult result, const HttpResponsePtr &resp) {
+                    scheduler->release();
+                    callback(result, resp);
+                });
+            });
+    };
+    if (!call.pendingAuth || tokenCache_ == nullptr)
+    {
+        submit(std::move(callback));
+        return;
     }
+    // Held until the first token of the host is fetched, rather than
+    // blocking the thread of the caller. The thread of the cache only hands
+    // the call over to the loop of the client.
+    tokenCache_->get(
+        call.host,
+        tokenWait(*call.pendingAuth, call.deadline),
+        [submit = std::move(submit),
+         callback = std::move(callback),
+         request = call.request,
+         header = call.pendingAuth->header,
+         loop = call.client->getLoop()](string token, string error) mutable {
+            loop->queueInLoop([submit = std::move(submit),
+                               callback = std::move(callback),
+                               request,
+                               header,
+                               token = std::move(token),
+                               error = std::move(error)]() mutable {
+                if (token.empty())
+                {
+                    LOG_WARN << error;
+                    callback(ReqResult::BadServerAddress, nullptr);
+                    return;
+                }
+                request->addHeader(header, token);
+                submit(std::move(callback));
+            });
+        });
 }
 
-std::tuple<drogon::HttpClientPtr, drogon::HttpRequestPtr> tl::rest::Muelsyse::
-    prepare(const std::string &funcName,
-            const std::vector<Argument> &args) const
+std::pair<ReqResult, HttpResponsePtr> Muelsyse::sendSync(
+    const PreparedCall &call) const
 {
-    assert(args.size() % 2 == 0);
-    if (this->restMap_.find(funcName) == restMap_.end())
+    if (!call.scheduler && !call.cancelToken && !call.pendingAuth)
     {
-        throw std::invalid_argument("rest function not found: " + funcName);
+        double timeout;
+        if (!timeoutFromDeadline(
+                call.deadline, call.request, deadlineHeader_, timeout))
+        {
+            call.route->stats->recordCall(false, 0);
+            return {ReqResult::Timeout, nullptr};
+        }
+        startShadow(call.shadow);
+        auto sentAt = std::chrono::steady_clock::now();
+        auto response = call.client->sendRequest(call.request, timeout);
+        call.route->stats->recordCall(response.first == ReqResult::Ok,
+                                      microsecondsSince(sentAt));
+        if (call.shadow)
+        {
+            completeShadow(
+                call.shadow, false, response.first, response.second);
+        }
+        return response;
+    }
+    using Response = std::pair<ReqResult, HttpResponsePtr>;
+    auto promise = make_shared<std::promise<Response>>();
+    auto future = promise->get_future();
+    send(
+        call,
+        [promise](ReqResult result, const HttpResponsePtr &resp) {
+            promise->set_value({result, resp});
+        },
+        false);
+    return future.get();
+}
+
+HttpClientPtr Muelsyse::getHttpClient(const string &url) const
+{
+    return getClientPool(url)->pick();
+}
+
+shared_ptr<Muelsyse::ClientPool> Muelsyse::getClientPool(
+    const string &url) const
+{
+    return findClientPool(url, nullptr, true);
+}
+
+shared_ptr<Muelsyse::ClientPool> Muelsyse::getClientPool(
+    const string &url,
+    const shared_ptr<const TlsConfig> &tls) const
+{
+    return findClientPool(url, tls, false);
+}
+
+shared_ptr<Muelsyse::ClientPool> Muelsyse::findClientPool(
+    const string &url,
+    const shared_ptr<const TlsConfig> &tls,
+    bool anyTls) const
+{
+    auto &mtx = getMapMutex();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto iter = httpClientMap_.find(url);
+        if (iter != httpClientMap_.end() &&
+            (anyTls || iter->second->tls == tls))
+            return iter->second;
+    }
+    auto newPool = make_shared<ClientPool>();
+    newPool->tls = tls;
+    if (url.starts_with("inproc://"))
+    {
+        // No connections, so nothing to resolve, pin or spread over
+        newPool->clients.push_back(make_shared<InprocClient>(url.substr(9)));
+    }
+    else if (url.starts_with("unix://"))
+    {
+        auto iter = hostOptions_.find(url);
+        const auto &options =
+            iter == hostOptions_.end() ? defaultHostOptions_ : iter->second;
+        for (size_t i = 0; i < options.connections; ++i)
+        {
+            auto client = make_shared<UnixClient>(url.substr(7));
+            client->setSockOptCallback(
+                [connections = newPool->connections](int) { ++*connections; });
+            newPool->clients.push_back(std::move(client));
+        }
+    }
+    else
+    {
+        addHttpClients(*newPool, url, tls);
+    }
+    if (maxConcurrencyPerHost_ > 0)
+    {
+        newPool->scheduler =
+            make_shared<CallScheduler>(maxConcurrencyPerHost_, maxQueueWait_);
     }
 
-    auto [url, httpMethod] = restMap_.at(funcName);
-    if (!url.starts_with("http://") && !url.starts_with("https://"))
+    std::lock_guard<std::mutex> lock(mtx);
+    auto &pool = httpClientMap_[url];
+    // Another thread may have created a suitable pool in the meantime
+    if (pool == nullptr || (!anyTls && pool->tls != tls))
     {
-        url = "http://" + url;
+        pool = std::move(newPool);
     }
+    return pool;
+}
 
-    Json::Value requestBody(Json::objectValue);
-    // parameter processing
-    for (int i = 0; i < args.size(); i += 2)
+std::vector<bool> Muelsyse::deliverOutbox(
+    const std::vector<string> &batch) const
+{
+    auto table = routes();
+    std::vector<std::future<bool>> results;
+    for (const auto &record : batch)
     {
-        if (!args[i].toJson().isString())
+        auto promise = make_shared<std::promise<bool>>();
+        results.push_back(promise->get_future());
+        auto fields = outboxFields(record);
+        if (fields.size() < 6 || fields.size() % 2 != 0)
         {
-            throw std::invalid_argument(
-                "Incorrect parameter configuration of " + funcName);
+            // Retrying cannot help, drop it
+            LOG_ERROR << "malformed record in the outbox";
+            promise->set_value(true);
+            continue;
         }
-        std::string arg = args[i].toJson().asString();
-        // path parameter
-        if (arg == "_")
+        const auto &funcName = fields[0];
+        shared_ptr<const TlsConfig> tls;
+        const RestRoute *route;
+        if (table != nullptr && (route = table->find(funcName)) != nullptr)
         {
-            // Find the first {} in the url and replace it
-            int startPos = url.find("{");
-            if (startPos == std::string::npos)
-            {
-                throw std::invalid_argument(
-                    "Incorrect parameter configuration of " + funcName);
-            }
-            int endPos = url.find("}", startPos);
-            if (endPos == std::string::npos)
-            {
-                throw std::invalid_argument(
-                    "Incorrect parameter configuration of " + funcName);
-            }
-            Json::Value json = args[i + 1].toJson();
-            url.replace(startPos,
-                        endPos - startPos + 1,
-                        jsonToStringInPath(json));
+            tls = route->tls;
         }
-        // root parameter
-        else if (arg == "")
+        auto req = HttpRequest::newHttpRequest();
+        req->setMethod(static_cast<HttpMethod>(std::stoi(fields[2])));
+        req->setPath(fields[3]);
+        req->setContentTypeString(fields[4]);
+        req->setBody(std::move(fields[5]));
+        for (size_t i = 6; i < fields.size(); i += 2)
         {
-            if (!requestBody.empty())
+            req->addHeader(fields[i], fields[i + 1]);
+        }
+        // Tokens are not kept in the outbox, they would be stale by now
+        try
+        {
+            addAuthHeader(fields[1], *req);
+        }
+        catch (const std::exception &e)
+        {
+            LOG_WARN << funcName << " from the outbox: " << e.what();
+            promise->set_value(false);
+            continue;
+        }
+        getClientPool(fields[1], tls)->pick()->sendRequest(
+            req,
+            [promise, funcName](ReqResult result, const HttpResponsePtr &resp) {
+                // Server errors may go away, other statuses will not
+                bool delivered = result == ReqResult::Ok &&
+                                 resp->statusCode() < 500 &&
+                                 resp->statusCode() != k429TooManyRequests;
+                if (result == ReqResult::Ok && resp->statusCode() >= 400)
+                {
+                    LOG_WARN << funcName << " from the outbox returned status "
+                             << resp->statusCode();
+                }
+                promise->set_value(delivered);
+            },
+            outboxTimeout_);
+    }
+    std::vector<bool> delivered;
+    delivered.reserve(results.size());
+    for (auto &result : results)
+    {
+        delivered.push_back(result.get());
+    }
+    return delivered;
+}
+
+bool Muelsyse::addAuthHeader(const string &host,
+                             HttpRequest &req,
+                             bool wait) const
+{
+    auto auth = authOf(host);
+    if (auth == nullptr || tokenCache_ == nullptr)
+    {
+        return true;
+    }
+    std::optional<string> token =
+        wait ? tokenCache_->get(host, tokenWait(*auth, std::nullopt))
+             : tokenCache_->tryGet(host);
+    if (!token)
+    {
+        return false;
+    }
+    req.addHeader(auth->header, *token);
+    return true;
+}
+
+shared_ptr<const Muelsyse::HostAuth> Muelsyse::hostAuth() const
+{
+    std::lock_guard<std::mutex> lock(authMutex_);
+    return hostAuth_;
+}
+
+shared_ptr<const AuthConfig> Muelsyse::authOf(const string &host) const
+{
+    auto auth = hostAuth();
+    auto iter = auth->find(host);
+    if (iter == auth->end())
+    {
+        return nullptr;
+    }
+    return shared_ptr<const AuthConfig>(std::move(auth), &iter->second);
+}
+
+shared_ptr<const Muelsyse::HostAuth> Muelsyse::parseHostAuth(
+    const Json::Value &config,
+    const RouteTable &table) const
+{
+    shared_ptr<const HostAuth> auth;
+    if (config.isMember("hosts"))
+    {
+        auto parsed = make_shared<HostAuth>();
+        const auto &hosts = config["hosts"];
+        for (const auto &host : hosts.getMemberNames())
+        {
+            if (hosts[host].isMember("auth"))
             {
-                // If the request body already has data, the new parameter
-                // should not be placed as root
-                throw std::invalid_argument(
-                    "Incorrect parameter configuration of " + funcName);
+                (*parsed)[hostOf(host)] = parseAuth(hosts[host]["auth"]);
             }
-            requestBody = args[i + 1].toJson();
         }
-        // request body parameter
-        else
+        auth = std::move(parsed);
+    }
+    else
+    {
+        auth = hostAuth();
+    }
+    for (const auto &[host, config] : *auth)
+    {
+        auto route = table.find(config.tokenFunction);
+        if (route == nullptr)
         {
-            requestBody[arg] = args[i + 1].toJson();
+            throw invalid_argument("Unknown token_function of " + host + ": " +
+                                   config.tokenFunction);
+        }
+        // Its calls would wait for their own token
+        if (route->request.host && auth->count(*route->request.host) > 0)
+        {
+            throw invalid_argument("The token_function of " + host +
+                                   " is on a host with auth");
         }
     }
-    int pos = 7;
-    pos += (url[pos] == '/');
+    return auth;
+}
 
-    std::string path = "/";
-    if ((pos = url.find('/', pos)) != std::string::npos)
+void Muelsyse::publishHostAuth(shared_ptr<const HostAuth> auth)
+{
+    auto current = hostAuth();
+    for (const auto &[host, config] : *auth)
     {
-        path = url.substr(pos);
-        url.resize(pos);
+        auto old = current->find(host);
+        if (old != current->end() && old->second == config)
+        {
+            continue;
+        }
+        std::vector<Argument> args;
+        if (!config.args.isNull())
+        {
+            args = {"", config.args};
+        }
+        auto timeout =
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(config.timeout));
+        // Fetched right away, so that the first calls rarely wait
+        tokenCache_->add(
+            host,
+            [this, function = config.tokenFunction, args, timeout]() {
+                auto deadline = std::chrono::steady_clock::now() + timeout;
+                CallScope scope({.deadline = deadline});
+                return parseToken(restCallSync<Json::Value>(function, args));
+            },
+            config.skew);
+    }
+    {
+        std::lock_guard<std::mutex> lock(authMutex_);
+        hostAuth_ = auth;
+    }
+    // The calls prepared before fail rather than go without a token
+    for (const auto &[host, config] : *current)
+    {
+        if (auth->count(host) == 0)
+        {
+            tokenCache_->remove(host);
+        }
     }
-    auto httpClient = getHttpClient(url);
-    auto req = drogon::HttpRequest::newHttpJsonRequest(requestBody);
+}
+
+shared_ptr<ShadowCall> Muelsyse::prepareShadow(
+    const RestRoute &route,
+    const std::vector<string> &pathValues,
+    const string &primaryHost,
+    const HttpRequest &primary) const
+{
+    const auto &config = *route.shadow;
+    string host;
+    string path;
+    fillTemplate(config.request, pathValues, host, path);
+    auto req = HttpRequest::newHttpRequest();
+    req->setMethod(primary.method());
     req->setPath(path);
-    req->setMethod(httpMethod);
-    return {httpClient, req};
+    if (route.codec)
+    {
+        req->setContentTypeString(route.codec->contentType());
+    }
+    else
+    {
+        req->setContentTypeCode(CT_APPLICATION_JSON);
+    }
+    // The body as it was encoded and compressed, with the headers that go
+    // with it, but those that belong to the host of the call
+    auto auth = authOf(primaryHost);
+    for (const auto &[field, value] : primary.headers())
+    {
+        if (field == "host" || (auth != nullptr && field == auth->header))
+        {
+            continue;
+        }
+        req->addHeader(field, value);
+    }
+    req->setBody(string(primary.body()));
+    bool tokenAdded;
+    try
+    {
+        tokenAdded = addAuthHeader(host, *req, false);
+    }
+    catch (const std::exception &e)
+    {
+        tokenAdded = false;
+    }
+    if (!tokenAdded)
+    {
+        ++route.stats->shadowDropped;
+        return nullptr;
+    }
+
+    auto pool = getClientPool(host);
+    if (!pool->hostHeader.empty())
+    {
+        req->addHeader("Host", pool->hostHeader);
+    }
+    auto shadow = make_shared<ShadowCall>();
+    shadow->client = pool->pick();
+    shadow->request = std::move(req);
+    shadow->stats = route.stats;
+    shadow->codec = route.codec;
+    shadow->maxInFlight = config.maxInFlight;
+    shadow->timeout = config.timeout;
+    return shadow;
 }
 
-HttpClientPtr Muelsyse::getHttpClient(const string &url) const
+void Muelsyse::addHttpClients(ClientPool &pool,
+                              const string &url,
+                              const shared_ptr<const TlsConfig> &tls) const
 {
-    auto &mtx = getMapMutex();
+    auto target = url;
+    string host;
+    uint16_t port;
+    if (dnsCache_ && splitNamedHost(url, host, port))
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        auto iter = httpClientMap_.find(url);
-        if (iter != httpClientMap_.end())
-            return iter->second;
+        // Until the host is resolved, drogon resolves it by itself
+        auto address = dnsCache_->lookup(url, host, port);
+        if (!address.empty())
+        {
+            if (address.find(':') != string::npos)
+            {
+                address = "[" + address + "]";
+            }
+            target = "http://" + address + ":" + std::to_string(port);
+            pool.hostHeader = url.substr(7);
+        }
+    }
+    auto iter = hostOptions_.find(url);
+    const auto &options =
+        iter == hostOptions_.end() ? defaultHostOptions_ : iter->second;
+    for (size_t i = 0; i < options.connections; ++i)
+    {
+        HttpClientPtr client;
+#ifdef MUELSYSE_WITH_NGHTTP2
+        if (options.http2)
+        {
+            // HTTP/2 needs TLS 1.2 at least, use_old_tls does not apply
+            client =
+                make_shared<Http2Client>(target, !tls || tls->validateCert);
+        }
+#endif
+        if (client == nullptr)
+        {
+            client = tls ? HttpClient::newHttpClient(target,
+                                                     nullptr,
+                                                     tls->useOldTls,
+                                                     tls->validateCert)
+                         : HttpClient::newHttpClient(target);
+        }
+        if (tls && !tls->certFile.empty())
+        {
+            client->setCertPath(tls->certFile, tls->keyFile);
+        }
+        if (tls && !tls->sslConfigs.empty())
+        {
+            client->addSSLConfigs(tls->sslConfigs);
+        }
+        // Called with each new socket, before it connects
+        client->setSockOptCallback(
+            [connections = pool.connections](int) { ++*connections; });
+        pool.clients.push_back(std::move(client));
     }
-    auto newHttpClient = HttpClient::newHttpClient(url);
+}
 
-    std::lock_guard<std::mutex> lock(mtx);
-    auto ret =
-        httpClientMap_.emplace(std::make_pair(url, std::move(newHttpClient)));
-    return ret.first->second;
+void Muelsyse::warmUp(const RouteTable &table,
+                      bool onlyNewHosts,
+                      std::function<void()> callback) const
+{
+    std::map<string, shared_ptr<const TlsConfig>> hosts;
+    for (const auto &[name, route] : table)
+    {
+        // Hosts with path parameters are only known at call time, in-process
+        // ones have no connections
+        if (!route.request.host ||
+            route.request.host->starts_with("inproc://"))
+        {
+            continue;
+        }
+        const auto &host = *route.request.host;
+        if (onlyNewHosts)
+        {
+            // A host whose TLS settings changed gets new connections too
+            std::lock_guard<std::mutex> lock(getMapMutex());
+            auto iter = httpClientMap_.find(host);
+            if (iter != httpClientMap_.end() && iter->second->tls == route.tls)
+            {
+                continue;
+            }
+        }
+        hosts.emplace(std::move(host), route.tls);
+    }
+
+    std::vector<HttpClientPtr> clients;
+    for (const auto &[host, tls] : hosts)
+    {
+        auto pool = getClientPool(host, tls);
+        const auto &poolClients = pool->clients;
+        clients.insert(clients.end(), poolClients.begin(), poolClients.end());
+    }
+    if (clients.empty())
+    {
+        if (callback)
+        {
+            callback();
+        }
+        return;
+    }
+
+    struct Progress
+    {
+        size_t total;
+        std::atomic<size_t> pending;
+        std::atomic<size_t> failed{0};
+        std::function<void()> callback;
+    };
+    auto progress = make_shared<Progress>();
+    progress->total = clients.size();
+    progress->pending = clients.size();
+    progress->callback = std::move(callback);
+
+    // Any response, even an error status, means the connection is open
+    for (const auto &client : clients)
+    {
+        auto req = HttpRequest::newHttpRequest();
+        req->setMethod(Head);
+        req->setPath(prewarmPath_);
+        client->sendRequest(
+            req,
+            [progress, host = client->host()](ReqResult result,
+                                              const HttpResponsePtr &) {
+                if (result != ReqResult::Ok)
+                {
+                    ++progress->failed;
+                    LOG_WARN << "failed to warm up a connection to " << host
+                             << ": " << result;
+                }
+                if (--progress->pending == 0)
+                {
+                    LOG_INFO << "warm-up completed, "
+                             << progress->total - progress->failed << "/"
+                             << progress->total << " connections opened";
+                    if (progress->callback)
+                    {
+                        progress->callback();
+                    }
+                }
+            },
+            prewarmTimeout_);
+    }
 }
 
 void Muelsyse::restCallAsync(
@@ -229,12 +2853,48 @@ void Muelsyse::restCallAsync(
     std::function<void()> successCallback,
     std::function<void(const std::exception &)> errorCallback) const
 {
-    auto [httpClient, req] = prepare(funcName, args);
-    httpClient->sendRequest(
-        req,
-        [successCallback, errorCallback](drogon::ReqResult result,
-                                         const drogon::HttpResponsePtr &resp) {
-            if (result == drogon::ReqResult::Ok)
+    auto call = prepareCall(funcName, args, false, true);
+    if (call.route->outbox && outbox_)
+    {
+        // Done once the request is in the log, it is sent later
+        auto auth = authOf(call.host);
+        if (!outbox_->append(outboxRecord(
+                funcName, call, auth == nullptr ? "" : auth->header)))
+        {
+            if (errorCallback)
+            {
+                errorCallback(std::runtime_error("the outbox is full"));
+            }
+            return;
+        }
+        try
+        {
+            successCallback();
+        }
+        catch (const std::exception &e)
+        {
+            if (errorCallback)
+            {
+                errorCallback(e);
+            }
+        }
+        return;
+    }
+    send(
+        call,
+        [client = call.client,
+         cancelToken = call.cancelToken,
+         successCallback,
+         errorCallback](drogon::ReqResult result,
+                        const drogon::HttpResponsePtr &resp) {
+            if (cancelToken && cancelToken->isCancelled())
+            {
+                if (errorCallback)
+                {
+                    errorCallback(CallCancelled());
+                }
+            }
+            else if (result == drogon::ReqResult::Ok)
             {
                 try
                 {
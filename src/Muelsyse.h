@@ -17,6 +17,22 @@
 #include <drogon/HttpAppFramework.h>
 #include <drogon/HttpClient.h>
 
+#include <filesystem>
+#include <optional>
+
+#include "BodyCodec.h"
+#include "CallScheduler.h"
+#include "CancelToken.h"
+#include "DnsCache.h"
+#include "Expected.h"
+#include "HttpStream.h"
+#include "InprocClient.h"
+#include "NameTable.h"
+#include "Outbox.h"
+#include "StaticRoute.h"
+#include "TokenCache.h"
+#include "UnixClient.h"
+
 /**
  * @brief Normal functions DO NOT have the classTypeName() member function.
  * Please use the REST_FUNC macro to declare functor.
@@ -45,6 +61,7 @@ inline std::string classTypeName() noexcept(false)
 #define REST_FUNC(ret_type, func_name, ...)               \
     struct func_name : public drogon::DrObject<func_name> \
     {                                                     \
+        using RestFuncType = func_name;                   \
         ret_type operator()(__VA_ARGS__) const;           \
     } static func_name;                                   \
     inline ret_type func_name::operator()(__VA_ARGS__) const
@@ -71,6 +88,7 @@ inline std::string classTypeName() noexcept(false)
 #define REST_FUNC_ASYNC(ret_type, func_name, ...)                            \
     struct func_name : public drogon::DrObject<func_name>                    \
     {                                                                        \
+        using RestFuncType = func_name;                                      \
         void operator()(__VA_ARGS__ __VA_OPT__(, )                           \
                             std::function<void(ret_type)> &&successCallback, \
                         std::function<void(const std::exception &)>          \
@@ -94,10 +112,25 @@ inline std::string classTypeName() noexcept(false)
 #define REST_FUNC_FUTURE(ret_type, func_name, ...)           \
     struct func_name : public drogon::DrObject<func_name>    \
     {                                                        \
+        using RestFuncType = func_name;                      \
         std::future<ret_type> operator()(__VA_ARGS__) const; \
     } static func_name;                                      \
     inline std::future<ret_type> func_name::operator()(__VA_ARGS__) const
 
+/**
+ * @brief Define a functor for synchronous HTTP requests that report failures
+ * through their result instead of exceptions.
+ *
+ * @param ret_type The type of the value of the result.
+ * @param func_name The name of the functor.
+ * @param ... The parameter list for the functor.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+#define REST_FUNC_EXPECTED(ret_type, ...) \
+    REST_FUNC(tl::rest::RestResult<ret_type>, __VA_ARGS__)
+
 /**
  * @addtogroup param_macros
  * @{
@@ -106,7 +139,7 @@ inline std::string classTypeName() noexcept(false)
  */
 
 /// Define a path parameter
-#define PATH_PARAM(value) "_", value
+#define PATH_PARAM(value) tl::rest::pathParam, value
 /// Use the parameter as the request body
 #define ROOT_PARAM(value) "", value
 /// Define an additional attribute in the request body
@@ -124,6 +157,7 @@ inline std::string classTypeName() noexcept(false)
  * @since v0.0.1
  */
 #define REST_CALL_SYNC(ret_type, ...)                                \
+    REST_CHECK_ROUTE(__VA_ARGS__);                                   \
     auto restCaller = drogon::app().getPlugin<tl::rest::Muelsyse>(); \
     std::string func_name{""};                                       \
     try                                                              \
@@ -167,6 +201,7 @@ struct RestCallWrapper<void>
  * @since 0.4.0
  */
 #define REST_CALL_ASYNC(ret_type, ...)                                 \
+    REST_CHECK_ROUTE(__VA_ARGS__);                                     \
     auto restCaller = drogon::app().getPlugin<tl::rest::Muelsyse>();   \
     std::string func_name{""};                                         \
     try                                                                \
@@ -193,6 +228,7 @@ struct RestCallWrapper<void>
  * @since 0.4.0
  */
 #define REST_CALL_FUTURE(ret_type, ...)                              \
+    REST_CHECK_ROUTE(__VA_ARGS__);                                   \
     auto restCaller = drogon::app().getPlugin<tl::rest::Muelsyse>(); \
     std::string func_name{""};                                       \
     try                                                              \
@@ -205,6 +241,28 @@ struct RestCallWrapper<void>
     }                                                                \
     return restCaller->restCallFuture<ret_type>(func_name, {__VA_ARGS__})
 
+/**
+ * @brief Custom functions can call this macro to simplify synchronous HTTP
+ * requests that return a RestResult.
+ * @see tl::rest::Muelsyse::restCallExpected<T>()
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+#define REST_CALL_EXPECTED(ret_type, ...)                            \
+    REST_CHECK_ROUTE(__VA_ARGS__);                                   \
+    auto restCaller = drogon::app().getPlugin<tl::rest::Muelsyse>(); \
+    std::string func_name{""};                                       \
+    try                                                              \
+    {                                                                \
+        func_name = classTypeName();                                 \
+    }                                                                \
+    catch (const std::runtime_error &e)                              \
+    {                                                                \
+        func_name = __FUNCTION__;                                    \
+    }                                                                \
+    return restCaller->restCallExpected<ret_type>(func_name, {__VA_ARGS__})
+
 namespace tl::rest
 {
 
@@ -261,6 +319,12 @@ Json::Value toJson(const HasToStringAndToJson auto &param)
     return param.toJson();
 }
 
+/// PATH_PARAM marks its value with this, it is sent as "_"
+inline Json::Value toJson(const PathParamTag &)
+{
+    return "_";
+}
+
 template <typename T>
 Json::Value toJson(const std::unordered_map<std::string, T> &param);
 
@@ -336,6 +400,571 @@ class Argument
     Json::Value data_;
 };
 
+/**
+ * @brief Algorithms used to compress request bodies.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+enum class Compression
+{
+    None,
+    Gzip,
+    Brotli
+};
+
+/**
+ * @brief Counters collected for each function.
+ *
+ * @see Muelsyse::getStats
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct RouteStats
+{
+    /// Size of the request bodies before compression.
+    std::atomic<uint64_t> requestBytes{0};
+    /// Size of the request bodies actually put on the wire.
+    std::atomic<uint64_t> requestBytesSent{0};
+    /// Size of the compressed response bodies decoded by Muelsyse.
+    std::atomic<uint64_t> responseBytesReceived{0};
+    /// Size of the same response bodies after decompression.
+    std::atomic<uint64_t> responseBytes{0};
+    /// How much to reserve for the next request body, a high-water mark of
+    /// the recent body sizes.
+    std::atomic<size_t> requestBodyHint{0};
+    /// Completed calls, from the time they are sent, queueing included, to
+    /// the time their response or error is received.
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> failedCalls{0};
+    std::atomic<uint64_t> latencyTotalUs{0};
+    std::atomic<uint64_t> latencyMaxUs{0};
+    /// Completed shadow calls, see RestRoute::shadow.
+    std::atomic<uint64_t> shadowCalls{0};
+    std::atomic<uint64_t> shadowFailedCalls{0};
+    std::atomic<uint64_t> shadowLatencyTotalUs{0};
+    std::atomic<uint64_t> shadowLatencyMaxUs{0};
+    /// Sampled calls that were not shadowed, because max_in_flight shadow
+    /// calls were in flight already.
+    std::atomic<uint64_t> shadowDropped{0};
+    std::atomic<uint64_t> shadowInFlight{0};
+    /// Shadow responses whose status, or else whose body, differs from the
+    /// response of the call.
+    std::atomic<uint64_t> shadowStatusDiffs{0};
+    std::atomic<uint64_t> shadowBodyDiffs{0};
+
+    void recordCall(bool ok, uint64_t latencyUs)
+    {
+        record(ok, latencyUs, calls, failedCalls, latencyTotalUs, latencyMaxUs);
+    }
+
+    void recordShadowCall(bool ok, uint64_t latencyUs)
+    {
+        record(ok,
+               latencyUs,
+               shadowCalls,
+               shadowFailedCalls,
+               shadowLatencyTotalUs,
+               shadowLatencyMaxUs);
+    }
+
+  private:
+    static void record(bool ok,
+                       uint64_t latencyUs,
+                       std::atomic<uint64_t> &calls,
+                       std::atomic<uint64_t> &failedCalls,
+                       std::atomic<uint64_t> &latencyTotalUs,
+                       std::atomic<uint64_t> &latencyMaxUs)
+    {
+        ++calls;
+        if (!ok)
+        {
+            ++failedCalls;
+        }
+        latencyTotalUs += latencyUs;
+        auto max = latencyMaxUs.load(std::memory_order_relaxed);
+        while (latencyUs > max &&
+               !latencyMaxUs.compare_exchange_weak(max, latencyUs))
+        {
+        }
+    }
+};
+
+/**
+ * @brief How the connections to one host are used.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct HostOptions
+{
+    /// The number of connections, calls use them in turn.
+    size_t connections{1};
+    /// Speak HTTP/2 instead of HTTP/1.1, with `protocol: h2`. Each
+    /// connection then carries many calls at once.
+    bool http2{false};
+};
+
+/**
+ * @brief Where the calls to a host get their access token from, the `auth`
+ * item of the host.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct AuthConfig
+{
+    /// The function that fetches tokens, it must not be on a host with auth.
+    std::string tokenFunction;
+    /// The request body of tokenFunction, such as the client credentials.
+    Json::Value args;
+    /// Refresh a token this many seconds before it expires.
+    double skew{30};
+    /// The header that carries the token, as `Bearer <access_token>`.
+    std::string header{"authorization"};
+    /// How long a fetch may take, and how long a call waits for the first
+    /// token of the host.
+    double timeout{5};
+
+    bool operator==(const AuthConfig &) const = default;
+};
+
+/**
+ * @brief The TLS settings of the connections to an https host.
+ *
+ * All the functions of a host share its connections, so they must agree on
+ * these settings.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct TlsConfig
+{
+    /// Verify the certificate chain and the host name of the server.
+    bool validateCert{true};
+    /// Allow TLS 1.0 and 1.1.
+    bool useOldTls{false};
+    /// Trust the certificates in this PEM file when verifying the server.
+    std::string caFile;
+    /// The client certificate and its key, for mutual TLS.
+    std::string certFile;
+    std::string keyFile;
+    /// OpenSSL SSL_CONF commands, such as `{"MinProtocol", "TLSv1.3"}`.
+    std::vector<std::pair<std::string, std::string>> sslConfigs;
+    /// The configuration item it was parsed from.
+    Json::Value source;
+};
+
+/**
+ * @brief What the requests of a function have in common, worked out once when
+ * the function is registered instead of on every call.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct RequestTemplate
+{
+    /// The key of the HttpClient pool, shared by the functions of a host,
+    /// nullptr when the host has placeholders and is only known once they
+    /// are filled.
+    std::shared_ptr<const std::string> host;
+    /// The path, or the whole url when host is empty, cut around the
+    /// placeholders: pieces[i] comes right before placeholders[i].
+    std::vector<std::string> pieces;
+    /// The placeholders with their braces, kept in the url when no argument
+    /// fills them.
+    std::vector<std::string> placeholders;
+    /// Added to every request, such as Accept.
+    std::vector<std::pair<std::string, std::string>> headers;
+};
+
+/**
+ * @brief Where a sample of the calls of a function is copied to, the
+ * `shadow` item of the function.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct ShadowConfig
+{
+    /// The url of the copies, with the same placeholders as the function.
+    std::string url;
+    RequestTemplate request;
+    /// The share of the calls that are copied, from 0 to 1.
+    double sampleRate{0.01};
+    /// How many copies may be in flight at once, others are dropped.
+    size_t maxInFlight{16};
+    /// The timeout of the copies, in seconds.
+    double timeout{10};
+};
+
+/**
+ * @brief How a function returns a list page by page, the `pagination` item
+ * of the function.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct PaginationConfig
+{
+    /// Where the cursor of a page goes: the placeholder of the url with this
+    /// name if there is one, the item of the request body otherwise.
+    std::string cursor;
+    /// The path of the cursor of the next page in a response, split on dots.
+    /// A missing, null or empty cursor ends the list.
+    std::vector<std::string> nextCursor;
+    /// The path of the page in a response, the whole body if empty.
+    std::vector<std::string> items;
+    /// How many pages are fetched ahead of the consumer.
+    size_t prefetch{1};
+};
+
+/**
+ * @brief The configuration of a function in function_list.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct RestRoute
+{
+    drogon::HttpMethod httpMethod{drogon::Get};
+    /// The wire format of bodies, nullptr means JSON through drogon.
+    std::shared_ptr<const BodyCodec> codec;
+    /// Compress request bodies whose size reaches compressMinSize.
+    Compression compression{Compression::None};
+    size_t compressMinSize{1024};
+    /// Send Accept-Encoding and decode compressed responses.
+    bool acceptEncoding{false};
+    /// Only set for https urls, nullptr means the defaults of drogon.
+    std::shared_ptr<const TlsConfig> tls;
+    /// Used when the calls to the host are limited, see CallScope.
+    Priority priority{Priority::Normal};
+    std::shared_ptr<RouteStats> stats{std::make_shared<RouteStats>()};
+    /// Queue the calls without a result in the outbox instead of sending
+    /// them, see `delivery`.
+    bool outbox{false};
+    /// Copy a sample of the calls to another upstream, nullptr if not.
+    std::shared_ptr<const ShadowConfig> shadow;
+    /// Set when the function is paginated, see Muelsyse::restCallPages.
+    std::shared_ptr<const PaginationConfig> pagination;
+    /// The url, cut when the function is registered, with the headers built
+    /// from the members above.
+    RequestTemplate request;
+};
+
+/**
+ * @brief Where the callbacks of asynchronous calls run.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct CallbackExecutor
+{
+    /// Runs a task once, on a thread of its choice.
+    using Execute = std::function<void(std::function<void()> &&task)>;
+
+    enum class Target
+    {
+        /// The event loop of the HttpClient, where the response is read.
+        Client,
+        /// The event loop of the thread that makes the call, such as the
+        /// loop of the inbound request being handled. Calls made from a
+        /// thread without a loop behave as Client.
+        Caller,
+        /// execute.
+        Custom
+    };
+
+    Target target{Target::Client};
+    /// Only used by Custom.
+    std::shared_ptr<const Execute> execute;
+
+    static CallbackExecutor client()
+    {
+        return {};
+    }
+
+    static CallbackExecutor caller()
+    {
+        return {Target::Caller, nullptr};
+    }
+
+    static CallbackExecutor custom(Execute execute)
+    {
+        return {Target::Custom,
+                std::make_shared<const Execute>(std::move(execute))};
+    }
+};
+
+/**
+ * @brief Options of the calls made while a CallScope is alive.
+ *
+ * Unset members take their value from the enclosing scope, or from the
+ * configuration of the function.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct CallOptions
+{
+    std::optional<Priority> priority;
+    /// Calls fail with ReqResult::Timeout once it has passed, and are sent
+    /// with the time left as their timeout. A nested scope cannot extend
+    /// the deadline of the enclosing one.
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    /// Abandon the calls when it is cancelled.
+    std::optional<CancelToken> cancelToken;
+    /// Where the callbacks of restCallAsync run, callback_executor of the
+    /// configuration by default.
+    std::optional<CallbackExecutor> executor;
+};
+
+/**
+ * @brief Apply options to the calls made by the current thread until it is
+ * destroyed.
+ *
+ * The options are read when a call is prepared, so they also apply to
+ * asynchronous calls started in the scope.
+ *
+ * @code
+ * {
+ *     tl::rest::CallScope scope({.priority = tl::rest::Priority::Low});
+ *     syncAllUsers();
+ * }
+ * @endcode
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class CallScope
+{
+  public:
+    explicit CallScope(CallOptions options)
+        : options_(std::move(options)), previous_(current_)
+    {
+        if (previous_ != nullptr)
+        {
+            if (!options_.priority)
+            {
+                options_.priority = previous_->priority;
+            }
+            if (!options_.cancelToken)
+            {
+                options_.cancelToken = previous_->cancelToken;
+            }
+            if (!options_.executor)
+            {
+                options_.executor = previous_->executor;
+            }
+            const auto &outer = previous_->deadline;
+            if (outer && (!options_.deadline || *outer < *options_.deadline))
+            {
+                options_.deadline = outer;
+            }
+        }
+        current_ = &options_;
+    }
+
+    ~CallScope()
+    {
+        current_ = previous_;
+    }
+
+    CallScope(const CallScope &) = delete;
+    CallScope &operator=(const CallScope &) = delete;
+
+    /// The options of the innermost scope of this thread, or nullptr.
+    static const CallOptions *current()
+    {
+        return current_;
+    }
+
+  private:
+    CallOptions options_;
+    const CallOptions *previous_;
+    inline static thread_local const CallOptions *current_{nullptr};
+};
+
+/**
+ * @brief Why a call made with Muelsyse::restCallExpected failed.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct RestError
+{
+    /// Not Ok when no response was received. BadServerAddress is also used
+    /// when the call could not be built, such as for an unknown function.
+    drogon::ReqResult result{drogon::ReqResult::Ok};
+    /// The status of the response, 0 when there is none.
+    int status{0};
+    /// Why the call could not be built or the body could not be parsed.
+    std::string message;
+    /// The CancelToken of the call was cancelled, result is then
+    /// NetworkFailure whether or not a response arrived.
+    bool cancelled{false};
+};
+
+/**
+ * @brief Thrown when a call is made after the deadline of its CallScope.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class DeadlineExceeded : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief The error of a call whose CancelToken was cancelled.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class CallCancelled : public std::runtime_error
+{
+  public:
+    CallCancelled() : std::runtime_error("call cancelled")
+    {
+    }
+};
+
+/// The result of Muelsyse::restCallExpected.
+template <typename T>
+using RestResult = Expected<T, RestError>;
+
+/// A copy of a call sent to the shadow of its function.
+struct ShadowCall;
+
+/**
+ * @brief The event loop of a thread that makes calls, which tells whether the
+ * loop is still running.
+ *
+ * Each loop thread has one, made by its first call with the Caller executor
+ * and closed when the loop quits. A callback is never queued in a loop that
+ * has quit, it runs where the response arrives instead.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class CallerLoop
+{
+  public:
+    explicit CallerLoop(trantor::EventLoop *loop) : loop_(loop)
+    {
+    }
+
+    /// The loop of the current thread, nullptr if it has none.
+    static std::shared_ptr<CallerLoop> current();
+
+    /// Queue task in the loop, false if the loop has quit.
+    bool queue(std::function<void()> &&task);
+
+    bool isInLoopThread() const
+    {
+        return loop_->isInLoopThread();
+    }
+
+  private:
+    trantor::EventLoop *const loop_;
+    std::mutex mutex_;
+    bool open_{true};
+};
+
+/**
+ * @brief Everything needed to send a request, produced by Muelsyse::prepare.
+ *
+ * The route is the snapshot the request was built from, so a call that is in
+ * flight during a reload finishes with the old configuration.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct PreparedCall
+{
+    drogon::HttpClientPtr client;
+    drogon::HttpRequestPtr request;
+    std::shared_ptr<const RestRoute> route;
+    /// The scheme and authority of the url, the key of the client pool.
+    std::string host;
+    /// Set when the calls to the host are limited.
+    std::shared_ptr<CallScheduler> scheduler;
+    Priority priority{Priority::Normal};
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    std::optional<CancelToken> cancelToken;
+    /// Where the callback of an asynchronous call is handed to, nullptr for
+    /// the thread the response arrives on. execute takes precedence.
+    std::shared_ptr<CallerLoop> callbackLoop;
+    std::shared_ptr<const CallbackExecutor::Execute> execute;
+    /// Set when the call is sampled for the shadow of its function.
+    std::shared_ptr<ShadowCall> shadow;
+    /// Set when the token of the host was not fetched yet, the request is
+    /// sent once it is.
+    std::shared_ptr<const AuthConfig> pendingAuth;
+
+    /// Whether the call was cancelled, its result must then be dropped.
+    bool cancelled() const
+    {
+        return cancelToken && cancelToken->isCancelled();
+    }
+};
+
+/// The state of the pages of a PageStream, shared with the calls in flight.
+struct PageFetch;
+
+/**
+ * @brief The pages of a paginated function, fetched while the previous ones
+ * are processed; produced by Muelsyse::restCallPages.
+ *
+ * @code
+ * auto pages = restCaller->restCallPages("listUsers", {});
+ * while (auto page = pages.next().get())
+ * {
+ *     for (const auto &user : *page)
+ *     {
+ *         process(user);
+ *     }
+ * }
+ * @endcode
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class PageStream
+{
+  public:
+    explicit PageStream(std::shared_ptr<PageFetch> fetch)
+        : fetch_(std::move(fetch))
+    {
+    }
+
+    /// Stops fetching, the page in flight if any is dropped.
+    ~PageStream();
+
+    PageStream(PageStream &&) = default;
+    PageStream &operator=(PageStream &&) = default;
+    PageStream(const PageStream &) = delete;
+    PageStream &operator=(const PageStream &) = delete;
+
+    /**
+     * @brief The next page, or std::nullopt after the last one.
+     *
+     * The future is ready at once when the page was prefetched. It holds
+     * the error of the call when a page cannot be fetched, the pages after
+     * it are never fetched.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    std::future<std::optional<Json::Value>> next();
+
+  private:
+    std::shared_ptr<PageFetch> fetch_;
+};
+
 /**
  * @brief The main class of the Muelsyse plugin.
  *
@@ -374,6 +1003,79 @@ class Muelsyse : public drogon::Plugin<Muelsyse>
 
     void shutdown() override;
 
+    /**
+     * @brief Replace all functions with the function_list of config.
+     *
+     * The new functions are built into a new table that is published at
+     * once; calls that are in flight keep using the old one. Nothing is
+     * changed if config contains an invalid item. The counters of functions
+     * that keep their name are preserved, and so are the connections.
+     *
+     * The auth items of hosts are replaced too when config has hosts, the
+     * other host settings are only read at start. A missing function_list,
+     * route_hosts or hosts leaves what it configures unchanged, while an
+     * empty one removes it.
+     *
+     * @param config An object with a function_list member, the same as the
+     * plugin config.
+     * @throw std::invalid_argument If an item of function_list is invalid.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    void reload(const Json::Value &config) noexcept(false);
+
+    /**
+     * @brief Run callback once the connections opened by `prewarm` are
+     * established.
+     *
+     * The callback runs immediately if warm-up has already completed or is
+     * not configured, otherwise it runs in the event loop of an HttpClient.
+     * Hosts that cannot be reached within the timeout do not block
+     * readiness, they are reported in the log instead.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    void onReady(std::function<void()> callback);
+
+    /**
+     * @brief Whether warm-up has completed.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    bool isReady() const
+    {
+        return ready_;
+    }
+
+    /**
+     * @brief The header that carries the time left to the deadline of a
+     * call, in milliseconds, empty if it is not sent.
+     *
+     * @see DeadlineFilter
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    const std::string &deadlineHeader() const
+    {
+        return deadlineHeader_;
+    }
+
+    /**
+     * @brief The time given to an inbound request without a deadline
+     * header, in seconds, 0 means no deadline.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    double defaultDeadline() const
+    {
+        return defaultDeadline_;
+    }
+
     /**
      * @brief Send HTTP requests synchronously.
      *
@@ -391,6 +1093,36 @@ class Muelsyse : public drogon::Plugin<Muelsyse>
     T restCallSync(const std::string &funcName,
                    const std::vector<Argument> &args) const noexcept(false);
 
+    /**
+     * @brief Send HTTP requests synchronously, reporting failures through
+     * the result instead of exceptions.
+     *
+     * Besides network failures, responses whose status is not 2xx and
+     * bodies that cannot be parsed are errors.
+     *
+     * @code
+     * auto user = restCaller->restCallExpected<User>("getUserById",
+     *                                                 {PATH_PARAM(1)});
+     * if (!user && user.error().status == 404)
+     * {
+     *     ...
+     * }
+     * @endcode
+     *
+     * @param funcName The name of the function or functor.
+     * @param args The parameters of the function or functor.
+     * @return The response, or what went wrong.
+     *
+     * @attention
+     * Exceptions thrown by setByJson() of T are not caught.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    template <typename T>
+    RestResult<T> restCallExpected(const std::string &funcName,
+                                   const std::vector<Argument> &args) const;
+
     /**
      * @brief Send HTTP requests asynchronously using a callback mechanism.
      *
@@ -455,7 +1187,100 @@ class Muelsyse : public drogon::Plugin<Muelsyse>
                                   const std::vector<Argument> &args) const
         noexcept(false);
 
+    /**
+     * @brief Send an HTTP request and deliver the response body to sink as
+     * it arrives, instead of buffering and parsing it.
+     *
+     * The call blocks until the body has been read or the sink stops it. It
+     * uses a connection of its own, and holds at most options.bufferSize
+     * bytes of the body in memory whatever the size of the response.
+     *
+     * @code
+     * auto count = 0;
+     * restCaller->restCallStream(
+     *     "exportUsers",
+     *     {},
+     *     tl::rest::jsonArraySink([&count](Json::Value &&user) {
+     *         ++count;
+     *         return true;
+     *     }));
+     * @endcode
+     *
+     * @param funcName The name of the function or functor.
+     * @param args The parameters for the function or functor.
+     * @param sink Receives the body, see fdSink and jsonArraySink.
+     * @return The status and headers of the response.
+     *
+     * @throw std::invalid_argument If the function is an https one, which is
+     * not supported.
+     * @throw std::runtime_error If the request fails, or the status of the
+     * response is not 2xx.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    StreamResponse restCallStream(const std::string &funcName,
+                                  const std::vector<Argument> &args,
+                                  const StreamSink &sink,
+                                  const StreamOptions &options = {}) const
+        noexcept(false);
+
+    /**
+     * @brief Call a paginated function page after page, following the
+     * cursors of the responses.
+     *
+     * The first page is requested at once. Up to `prefetch` pages of the
+     * `pagination` item are then fetched ahead of PageStream::next, so that
+     * the next page is on its way while the current one is processed. The
+     * options of the current CallScope apply to every page.
+     *
+     * @param funcName The name of the function or functor.
+     * @param args The parameters of the first page, without the cursor.
+     * @return The pages, see PageStream.
+     *
+     * @throw std::invalid_argument If the function is not found or not
+     * paginated.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    PageStream restCallPages(const std::string &funcName,
+                             const std::vector<Argument> &args = {}) const
+        noexcept(false);
+
+    /**
+     * @brief Retrieve the counters of a function.
+     *
+     * The result looks like
+     * `{"request_bytes": 1024, "request_bytes_sent": 256, ...}`, an unknown
+     * function yields a null value.
+     *
+     * `connections` counts the connections opened to the host of the
+     * function, for https each of them is a full TLS handshake.
+     *
+     * @param funcName The name of the function or functor.
+     * @return A snapshot of the counters.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    Json::Value getStats(const std::string &funcName) const;
+
+    /**
+     * @brief The number of requests in the outbox that are not delivered
+     * yet, 0 if there is no outbox.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    size_t outboxSize() const
+    {
+        return outbox_ ? outbox_->size() : 0;
+    }
+
   protected:
+    using RouteTable = NameTable<RestRoute>;
+
     /**
      * @brief Register the url and HttpMethod of a function
      *
@@ -470,9 +1295,42 @@ class Muelsyse : public drogon::Plugin<Muelsyse>
                       const std::string &url,
                       drogon::HttpMethod httpMethod)
     {
-        restMap_[func_name] = std::make_pair(url, httpMethod);
+        RestRoute route;
+        route.httpMethod = httpMethod;
+        registerRest(func_name, url, std::move(route));
     }
 
+    /**
+     * @brief Register a function with all its options.
+     *
+     * @param func_name The name of the function.
+     * @param url The request url, cut into route.request.
+     * @param route The configuration of the function.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    void registerRest(const std::string &func_name,
+                      const std::string &url,
+                      RestRoute &&route);
+
+    /// A function for registerRest(), see RestRoute.
+    struct Registration
+    {
+        std::string name;
+        std::string url;
+        RestRoute route;
+    };
+
+    /**
+     * @brief Register many functions, published as one new table rather
+     * than one table per function.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    void registerRest(std::vector<Registration> &&functions);
+
     /**
      * @brief Convert a Json::Value to a string suitable for inclusion in a URL
      * path.
@@ -524,7 +1382,43 @@ class Muelsyse : public drogon::Plugin<Muelsyse>
      */
     std::tuple<drogon::HttpClientPtr, drogon::HttpRequestPtr> prepare(
         const std::string &funcName,
-        const std::vector<Argument> &args = {}) const;
+        const std::vector<Argument> &args = {}) const
+    {
+        auto call = prepareCall(funcName, args);
+        return {std::move(call.client), std::move(call.request)};
+    }
+
+    /**
+     * @brief Same as prepare, but also returns the route that was used.
+     *
+     * @param waitForToken Wait for the first token of a host with auth.
+     * Otherwise the call gets pendingAuth, and send() holds it until the
+     * token is fetched, so that asynchronous calls never block.
+     * @param toOutbox The call goes to the outbox if its function has
+     * `delivery: outbox`, its shadow is then not prepared.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    PreparedCall prepareCall(const std::string &funcName,
+                             const std::vector<Argument> &args = {},
+                             bool waitForToken = true,
+                             bool toOutbox = false) const;
+
+    /**
+     * @brief Build a request whose body is serialized with the codec of the
+     * route, and compressed when it is large enough.
+     *
+     * @param route The configuration of the function.
+     * @param requestBody The request body.
+     * @return The request without path and method.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    static drogon::HttpRequestPtr newEncodedRequest(
+        const RestRoute &route,
+        const Json::Value &requestBody);
 
     /**
      * @brief Retrieve the HttpClient object for the specified URL.
@@ -537,10 +1431,134 @@ class Muelsyse : public drogon::Plugin<Muelsyse>
      */
     drogon::HttpClientPtr getHttpClient(const std::string &url) const;
 
+    /// The connections to one host, used in turn.
+    struct ClientPool
+    {
+        const drogon::HttpClientPtr &pick()
+        {
+            if (clients.size() == 1)
+            {
+                return clients[0];
+            }
+            return clients[next++ % clients.size()];
+        }
+
+        std::vector<drogon::HttpClientPtr> clients;
+        std::atomic<size_t> next{0};
+        /// Set when the clients connect to a pinned address instead of the
+        /// host name.
+        std::string hostHeader;
+        /// The TLS settings the clients were created with.
+        std::shared_ptr<const TlsConfig> tls;
+        /// Connections opened by the clients, outlives the pool because the
+        /// clients can.
+        std::shared_ptr<std::atomic<uint64_t>> connections{
+            std::make_shared<std::atomic<uint64_t>>(0)};
+        /// Set when max_concurrency_per_host is configured.
+        std::shared_ptr<CallScheduler> scheduler;
+    };
+
     /**
-     * @brief Retrieve the mutex for the restMap_ member variable.
+     * @brief Retrieve all HttpClient objects of the specified host, they are
+     * created on first use.
      *
-     * @return A reference to the mutex for the restMap_ member variable.
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    std::shared_ptr<ClientPool> getClientPool(const std::string &url) const;
+
+    /**
+     * @brief Same as above, but a pool created with other TLS settings is
+     * replaced.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    std::shared_ptr<ClientPool> getClientPool(
+        const std::string &url,
+        const std::shared_ptr<const TlsConfig> &tls) const;
+
+    /**
+     * @brief Open every connection to the hosts of table.
+     *
+     * @param table The functions whose hosts should be warmed up.
+     * @param onlyNewHosts Skip hosts that already have connections.
+     * @param callback Called once every connection is established or failed.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    void warmUp(const RouteTable &table,
+                bool onlyNewHosts,
+                std::function<void()> callback) const;
+
+    /**
+     * @brief Parse the body of a response as JSON.
+     *
+     * Bodies that are still compressed (`Content-Encoding: gzip` or `br`) are
+     * decompressed first, and the sizes are recorded in the stats of the
+     * function. Bodies whose Content-Type matches the codec of the function
+     * are decoded with that codec, others are parsed as JSON.
+     *
+     * @param route The function that sent the request.
+     * @param resp The response.
+     * @return The JSON object, or nullptr if the body is not JSON.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    static std::shared_ptr<const Json::Value> getResponseJson(
+        const RestRoute &route,
+        const drogon::HttpResponsePtr &resp);
+
+    /**
+     * @brief Send a prepared request, through the scheduler of its host if
+     * there is one.
+     *
+     * A request whose deadline passes before it is sent completes with
+     * ReqResult::Timeout. A call with pendingAuth is sent once the token of
+     * its host is fetched, or completes with ReqResult::BadServerAddress when
+     * there is none within the timeout of the auth.
+     *
+     * @param dispatch Run callback where the executor of the call says,
+     * rather than where the response arrives.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    void send(const PreparedCall &call,
+              drogon::HttpReqCallback &&callback,
+              bool dispatch = true) const;
+
+    /**
+     * @brief Same as above, but waits for the response.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    std::pair<drogon::ReqResult, drogon::HttpResponsePtr> sendSync(
+        const PreparedCall &call) const;
+
+    /**
+     * @brief Copy an error given to an errorCallback, keeping CallCancelled
+     * apart from the other errors.
+     *
+     * @date 2026-10-19
+     * @since 0.5.0
+     */
+    static std::exception_ptr toExceptionPtr(const std::exception &e)
+    {
+        if (dynamic_cast<const CallCancelled *>(&e) != nullptr)
+        {
+            return std::make_exception_ptr(CallCancelled());
+        }
+        return std::make_exception_ptr(e);
+    }
+
+    /**
+     * @brief Retrieve the mutex for the httpClientMap_ member variable.
+     *
+     * @return A reference to the mutex for the httpClientMap_ member variable.
      *
      * @date 2025-04-29
      * @since 0.3.0
@@ -552,10 +1570,146 @@ class Muelsyse : public drogon::Plugin<Muelsyse>
     }
 
   private:
-    std::unordered_map<std::string, std::pair<std::string, drogon::HttpMethod>>
-        restMap_;
-    mutable std::unordered_map<std::string, drogon::HttpClientPtr>
+    /**
+     * @brief The current route table.
+     *
+     * Each thread caches the table together with its version, so the common
+     * case is a single atomic load; the mutex is only taken by the first call
+     * of a thread after a reload.
+     */
+    std::shared_ptr<const RouteTable> routes() const;
+
+    /// Build a route table from config, without publishing it.
+    std::shared_ptr<RouteTable> buildRoutes(const Json::Value &config) const;
+
+    void publishRoutes(std::shared_ptr<const RouteTable> table);
+
+    /// Reload function_list when the watched file is modified.
+    void checkWatchedFile();
+
+    /// Request the page after the cursor of fetch.
+    void fetchPage(const std::shared_ptr<PageFetch> &fetch) const;
+
+    friend class PageStream;
+
+    /// Implement getClientPool, anyTls accepts a pool with any TLS settings.
+    std::shared_ptr<ClientPool> findClientPool(
+        const std::string &url,
+        const std::shared_ptr<const TlsConfig> &tls,
+        bool anyTls) const;
+
+    /**
+     * @brief Send a batch of records of the outbox, and wait for the
+     * responses.
+     *
+     * @return Whether each record of batch was delivered.
+     */
+    std::vector<bool> deliverOutbox(
+        const std::vector<std::string> &batch) const;
+
+    /**
+     * @brief Add the token of host to req, if host has auth.
+     *
+     * @param wait Wait for the first token, up to the timeout of the auth of
+     * host.
+     * @return false if wait is false and there is no valid token yet.
+     * @throw std::runtime_error If there is no valid token in time.
+     */
+    bool addAuthHeader(const std::string &host,
+                       drogon::HttpRequest &req,
+                       bool wait = true) const;
+
+    using HostAuth = std::unordered_map<std::string, AuthConfig>;
+
+    /// The current items of hosts with auth.
+    std::shared_ptr<const HostAuth> hostAuth() const;
+
+    /// The auth of host, nullptr if it has none.
+    std::shared_ptr<const AuthConfig> authOf(const std::string &host) const;
+
+    /**
+     * @brief The auth items of the hosts of config, checked against the
+     * functions of table; the current ones if config has no hosts.
+     */
+    std::shared_ptr<const HostAuth> parseHostAuth(
+        const Json::Value &config,
+        const RouteTable &table) const;
+
+    /**
+     * @brief Fetch the tokens of the hosts whose auth is new or changed,
+     * publish auth, then drop the tokens of the hosts it no longer has.
+     * Called with reloadMutex_.
+     */
+    void publishHostAuth(std::shared_ptr<const HostAuth> auth);
+
+    /**
+     * @brief Copy primary, the request of a call of route, for the shadow of
+     * route.
+     *
+     * @return nullptr if the copy cannot be sent without waiting.
+     */
+    std::shared_ptr<ShadowCall> prepareShadow(
+        const RestRoute &route,
+        const std::vector<std::string> &pathValues,
+        const std::string &primaryHost,
+        const drogon::HttpRequest &primary) const;
+
+    /// Create the drogon clients of a pool for an http or https url.
+    void addHttpClients(ClientPool &pool,
+                        const std::string &url,
+                        const std::shared_ptr<const TlsConfig> &tls) const;
+
+    std::shared_ptr<const RouteTable> routes_;
+    std::atomic<uint64_t> routesVersion_{0};
+    mutable std::mutex routesMutex_;
+    /// Serializes writers, readers never take it.
+    std::mutex reloadMutex_;
+
+    /// How the timer of watch_file reaches the plugin, which shutdown()
+    /// takes away.
+    struct FileWatch
+    {
+        std::mutex mutex;
+        Muelsyse *plugin{nullptr};
+    };
+
+    std::string watchedFile_;
+    std::filesystem::file_time_type watchedFileTime_;
+    std::shared_ptr<FileWatch> fileWatch_;
+    trantor::TimerId watchTimerId_{0};
+    mutable std::unordered_map<std::string, std::shared_ptr<ClientPool>>
         httpClientMap_;
+    /// connections_per_host.
+    HostOptions defaultHostOptions_;
+    /// The items of hosts, by scheme and authority.
+    std::unordered_map<std::string, HostOptions> hostOptions_;
+    /// 0 means the calls to a host are not limited.
+    size_t maxConcurrencyPerHost_{0};
+    std::chrono::milliseconds maxQueueWait_{1000};
+    std::string deadlineHeader_{"X-Request-Timeout-Ms"};
+    double defaultDeadline_{0};
+    /// callback_executor, the scopes without an executor use it.
+    CallbackExecutor::Target callbackTarget_{CallbackExecutor::Target::Client};
+
+    bool prewarm_{false};
+    std::string prewarmPath_{"/"};
+    double prewarmTimeout_{5.0};
+    std::atomic<bool> ready_{true};
+    std::mutex readyMutex_;
+    std::vector<std::function<void()>> readyCallbacks_;
+
+    double outboxTimeout_{10.0};
+    /// The items of hosts with auth, by scheme and authority. Replaced as a
+    /// whole by reloads.
+    std::shared_ptr<const HostAuth> hostAuth_{std::make_shared<HostAuth>()};
+    mutable std::mutex authMutex_;
+
+    /// Declared last so that its thread stops before the pools are gone.
+    std::unique_ptr<DnsCache> dnsCache_;
+    /// Its thread calls the token functions, it stops before dnsCache_.
+    std::unique_ptr<TokenCache> tokenCache_;
+    /// After dnsCache_, its thread sends through the pools and stops first.
+    std::unique_ptr<Outbox> outbox_;
 };
 
 template <typename T>
@@ -563,9 +1717,13 @@ T Muelsyse::restCallSync(const std::string &funcName,
                          const std::vector<Argument> &args) const
     noexcept(false)
 {
-    auto [httpClient, req] = prepare(funcName, args);
+    auto call = prepareCall(funcName, args);
 
-    auto [result, resp] = httpClient->sendRequest(req);
+    auto [result, resp] = sendSync(call);
+    if (call.cancelled())
+    {
+        throw CallCancelled();
+    }
     if (result == drogon::ReqResult::Ok)
     {
         if constexpr (std::is_void_v<T>)
@@ -574,7 +1732,7 @@ T Muelsyse::restCallSync(const std::string &funcName,
         }
         else
         {
-            auto jsonPtr = resp->getJsonObject();
+            auto jsonPtr = getResponseJson(*call.route, resp);
             if (jsonPtr == nullptr)
             {
                 throw std::runtime_error("response body is not json.");
@@ -600,6 +1758,80 @@ T Muelsyse::restCallSync(const std::string &funcName,
     }
 }
 
+template <typename T>
+RestResult<T> Muelsyse::restCallExpected(
+    const std::string &funcName,
+    const std::vector<Argument> &args) const
+{
+    PreparedCall call;
+    try
+    {
+        call = prepareCall(funcName, args);
+    }
+    catch (const DeadlineExceeded &e)
+    {
+        return Unexpected<RestError>(
+            RestError{drogon::ReqResult::Timeout, 0, e.what()});
+    }
+    catch (const CallCancelled &e)
+    {
+        return Unexpected<RestError>(
+            RestError{drogon::ReqResult::NetworkFailure, 0, e.what(), true});
+    }
+    catch (const std::exception &e)
+    {
+        return Unexpected<RestError>(
+            RestError{drogon::ReqResult::BadServerAddress, 0, e.what()});
+    }
+
+    auto [result, resp] = sendSync(call);
+    if (call.cancelled())
+    {
+        return Unexpected<RestError>(
+            RestError{drogon::ReqResult::NetworkFailure,
+                      0,
+                      CallCancelled().what(),
+                      true});
+    }
+    if (result != drogon::ReqResult::Ok)
+    {
+        return Unexpected<RestError>(
+            RestError{result, 0, drogon::to_string(result)});
+    }
+    int status = resp->statusCode();
+    if (status < 200 || status >= 300)
+    {
+        return Unexpected<RestError>(RestError{result, status, ""});
+    }
+    if constexpr (std::is_void_v<T>)
+    {
+        return {};
+    }
+    else
+    {
+        auto jsonPtr = getResponseJson(*call.route, resp);
+        if (jsonPtr == nullptr)
+        {
+            const auto &error = resp->getJsonError();
+            return Unexpected<RestError>(
+                RestError{result,
+                          status,
+                          error.empty() ? "response body is not json."
+                                        : error});
+        }
+        if constexpr (std::is_same_v<T, Json::Value>)
+        {
+            return *jsonPtr;
+        }
+        else
+        {
+            T res;
+            res.setByJson(*jsonPtr);
+            return res;
+        }
+    }
+}
+
 template <typename T>
 void Muelsyse::restCallAsync(
     const std::string &funcName,
@@ -607,17 +1839,29 @@ void Muelsyse::restCallAsync(
     std::function<void(T)> successCallback,
     std::function<void(const std::exception &)> errorCallback) const
 {
-    auto [httpClient, req] = prepare(funcName, args);
+    auto call = prepareCall(funcName, args, false);
 
-    httpClient->sendRequest(
-        req,
-        [successCallback, errorCallback](drogon::ReqResult result,
-                                         const drogon::HttpResponsePtr &resp) {
-            if (result == drogon::ReqResult::Ok)
+    // The client is kept alive in case its pool is dropped in the meantime
+    send(
+        call,
+        [client = call.client,
+         route = call.route,
+         cancelToken = call.cancelToken,
+         successCallback,
+         errorCallback](drogon::ReqResult result,
+                        const drogon::HttpResponsePtr &resp) {
+            if (cancelToken && cancelToken->isCancelled())
+            {
+                if (errorCallback)
+                {
+                    errorCallback(CallCancelled());
+                }
+            }
+            else if (result == drogon::ReqResult::Ok)
             {
                 try
                 {
-                    auto jsonPtr = resp->getJsonObject();
+                    auto jsonPtr = getResponseJson(*route, resp);
                     if (jsonPtr == nullptr)
                     {
                         throw std::runtime_error("response body is not json.");
@@ -656,6 +1900,8 @@ std::future<T> Muelsyse::restCallFuture(const std::string &funcName,
     noexcept(false)
 {
     auto promisePtr = std::make_shared<std::promise<T>>();
+    // Setting the promise can be done anywhere, a hop would only cost time
+    CallScope scope({.executor = CallbackExecutor::client()});
 
     if constexpr (std::is_void_v<T>)
     {
@@ -666,7 +1912,7 @@ std::future<T> Muelsyse::restCallFuture(const std::string &funcName,
             args,
             [promisePtr]() mutable { promisePtr->set_value(); },
             [promisePtr](const std::exception &e) mutable {
-                promisePtr->set_exception(std::make_exception_ptr(e));
+                promisePtr->set_exception(toExceptionPtr(e));
             });
         return future;
     }
@@ -679,7 +1925,7 @@ std::future<T> Muelsyse::restCallFuture(const std::string &funcName,
             args,
             [promisePtr](T result) mutable { promisePtr->set_value(result); },
             [promisePtr](const std::exception &e) mutable {
-                promisePtr->set_exception(std::make_exception_ptr(e));
+                promisePtr->set_exception(toExceptionPtr(e));
             });
         return future;
     }
@@ -0,0 +1,179 @@
+/**
+ * @file NameTable.h
+ * @brief A compact, immutable map from names to values.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace tl::rest
+{
+
+/**
+ * @brief A map from names to values that is built once and only read
+ * afterwards, such as a table of functions.
+ *
+ * The values are stored side by side in one array, and the names in one
+ * buffer, so a table of n entries costs three allocations rather than a few
+ * per entry. Lookups go through an open-addressing index of 32-bit slots,
+ * kept at most half full, and take constant time.
+ *
+ * The entries refer to the name buffer, so a table can be neither copied nor
+ * moved; it is meant to be shared, through a std::shared_ptr.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+template <typename T>
+class NameTable
+{
+  public:
+    struct Entry
+    {
+        std::string_view name;
+        T value;
+    };
+
+    NameTable()
+    {
+        index_.assign(kMinSlots, kEmpty);
+    }
+
+    /**
+     * @brief Build a table from items; of items with the same name, the last
+     * one is kept, at the position of the first one.
+     */
+    explicit NameTable(std::vector<std::pair<std::string, T>> &&items)
+    {
+        // Find the duplicates first, on the positions in items
+        resize(items.size());
+        std::vector<uint32_t> kept;
+        kept.reserve(items.size());
+        size_t namesSize = 0;
+        for (uint32_t i = 0; i < items.size(); ++i)
+        {
+            auto &slot = probe(items[i].first, [&items](uint32_t j) {
+                return std::string_view(items[j].first);
+            });
+            if (slot == kEmpty)
+            {
+                slot = i;
+                kept.push_back(i);
+                namesSize += items[i].first.size();
+            }
+            else
+            {
+                std::swap(items[slot].second, items[i].second);
+            }
+        }
+
+        names_.reserve(namesSize);
+        entries_.reserve(kept.size());
+        for (auto i : kept)
+        {
+            auto &[name, value] = items[i];
+            std::string_view stored(names_.data() + names_.size(),
+                                    name.size());
+            names_.append(name);
+            entries_.push_back({stored, std::move(value)});
+        }
+        // Then index the positions in entries_
+        index_.assign(index_.size(), kEmpty);
+        for (uint32_t i = 0; i < entries_.size(); ++i)
+        {
+            probe(entries_[i].name, [this](uint32_t j) {
+                return entries_[j].name;
+            }) = i;
+        }
+    }
+
+    NameTable(const NameTable &) = delete;
+    NameTable &operator=(const NameTable &) = delete;
+
+    /// The value of name, or nullptr.
+    const T *find(std::string_view name) const
+    {
+        auto mask = index_.size() - 1;
+        for (auto i = std::hash<std::string_view>{}(name) & mask;;
+             i = (i + 1) & mask)
+        {
+            auto slot = index_[i];
+            if (slot == kEmpty)
+            {
+                return nullptr;
+            }
+            if (entries_[slot].name == name)
+            {
+                return &entries_[slot].value;
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        return entries_.size();
+    }
+
+    bool empty() const
+    {
+        return entries_.empty();
+    }
+
+    /// The entries in the order they were given.
+    typename std::vector<Entry>::const_iterator begin() const
+    {
+        return entries_.begin();
+    }
+
+    typename std::vector<Entry>::const_iterator end() const
+    {
+        return entries_.end();
+    }
+
+  private:
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+    static constexpr size_t kMinSlots = 8;
+
+    /// Size the index for count entries, a power of two at least twice as
+    /// large.
+    void resize(size_t count)
+    {
+        size_t slots = kMinSlots;
+        while (slots < count * 2)
+        {
+            slots *= 2;
+        }
+        index_.assign(slots, kEmpty);
+    }
+
+    /// The slot that holds name, or the empty slot where it would go.
+    template <typename NameOf>
+    uint32_t &probe(std::string_view name, const NameOf &nameOf)
+    {
+        auto mask = index_.size() - 1;
+        for (auto i = std::hash<std::string_view>{}(name) & mask;;
+             i = (i + 1) & mask)
+        {
+            auto &slot = index_[i];
+            if (slot == kEmpty || nameOf(slot) == name)
+            {
+                return slot;
+            }
+        }
+    }
+
+    std::string names_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> index_;
+};
+
+}  // namespace tl::rest
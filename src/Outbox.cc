@@ -0,0 +1,359 @@
+#include "Outbox.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+using namespace std;
+using namespace tl::rest;
+
+/// The start of the file, the records follow at kDataOffset.
+///
+/// head and tail are each written with a single store, after the records
+/// they cover, so the header is consistent whenever the process stops.
+struct Outbox::Header
+{
+    uint64_t magic;
+    /// The size of the record area.
+    uint64_t capacity;
+    /// The offsets only grow, the position in the file is modulo capacity.
+    uint64_t head;
+    uint64_t tail;
+};
+
+namespace
+{
+
+constexpr uint64_t kMagic = 0x31584f4253554d54;  // "TMUSBOX1"
+constexpr size_t kDataOffset = 64;
+/// Stands for a length where the rest of the area is skipped.
+constexpr uint32_t kWrap = 0xffffffff;
+/// Set in the length of a record once it is delivered.
+constexpr uint32_t kDelivered = 0x80000000;
+/// append() leaves 1/kReserveShare of the area free, so that failed records
+/// can always be moved out of the way.
+constexpr uint64_t kReserveShare = 16;
+constexpr size_t kLengthSize = sizeof(uint32_t);
+
+void publish(uint64_t &offset, uint64_t value)
+{
+    std::atomic_ref<uint64_t>(offset).store(value, std::memory_order_release);
+}
+
+}  // namespace
+
+Outbox::Outbox(const string &path,
+               size_t capacity,
+               size_t batchSize,
+               double retryInterval,
+               Deliver deliver)
+    : batchSize_(std::max<size_t>(batchSize, 1)),
+      retryInterval_(static_cast<int64_t>(retryInterval * 1000)),
+      deliver_(std::move(deliver))
+{
+    static_assert(sizeof(Header) <= kDataOffset);
+    auto fail = [this, &path](const string &what) {
+        auto message = what + " " + path + ": " + strerror(errno);
+        if (header_ != nullptr)
+        {
+            munmap(header_, mappedSize_);
+        }
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+        throw runtime_error(message);
+    };
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        fail("failed to open the outbox");
+    }
+    // Two processes appending to the same log would corrupt it
+    if (flock(fd_, LOCK_EX | LOCK_NB) != 0)
+    {
+        fail("failed to lock the outbox");
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0)
+    {
+        fail("failed to stat the outbox");
+    }
+    bool created = st.st_size == 0;
+    if (created)
+    {
+        // Lengths leave the top bit to the delivered flag
+        capacity = std::clamp<size_t>(capacity, 4096, kDelivered);
+        mappedSize_ = kDataOffset + capacity;
+        if (ftruncate(fd_, mappedSize_) != 0)
+        {
+            fail("failed to allocate the outbox");
+        }
+    }
+    else
+    {
+        mappedSize_ = st.st_size;
+    }
+    auto addr = mmap(
+        nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED)
+    {
+        fail("failed to map the outbox");
+    }
+    header_ = static_cast<Header *>(addr);
+    data_ = static_cast<char *>(addr) + kDataOffset;
+    if (created)
+    {
+        *header_ = Header{kMagic, capacity, 0, 0};
+    }
+    else if (mappedSize_ <= kDataOffset || header_->magic != kMagic ||
+             header_->capacity != mappedSize_ - kDataOffset ||
+             header_->capacity > kDelivered ||
+             header_->head > header_->tail ||
+             header_->tail - header_->head > header_->capacity ||
+             !countPending())
+    {
+        errno = EINVAL;
+        fail("not an outbox");
+    }
+    if (pending_ > 0)
+    {
+        LOG_INFO << pending_ << " requests left in the outbox " << path;
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+Outbox::~Outbox()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    munmap(header_, mappedSize_);
+    close(fd_);
+}
+
+bool Outbox::append(string_view record)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!appendLocked(record, header_->capacity / kReserveShare))
+        {
+            return false;
+        }
+    }
+    cv_.notify_one();
+    return true;
+}
+
+std::optional<uint64_t> Outbox::appendLocked(string_view record,
+                                             uint64_t reserve)
+{
+    const auto capacity = header_->capacity;
+    if (record.size() + kLengthSize + reserve > capacity)
+    {
+        return std::nullopt;
+    }
+    auto size = static_cast<uint32_t>(record.size());
+    auto tail = header_->tail;
+    auto pos = tail % capacity;
+    // A record is never split, it starts over at the beginning instead
+    uint64_t skip = 0;
+    if (capacity - pos < kLengthSize + size)
+    {
+        skip = capacity - pos;
+    }
+    if (tail + skip + kLengthSize + size + reserve - header_->head > capacity)
+    {
+        return std::nullopt;
+    }
+    if (skip >= kLengthSize)
+    {
+        memcpy(data_ + pos, &kWrap, kLengthSize);
+    }
+    pos = (tail + skip) % capacity;
+    memcpy(data_ + pos, &size, kLengthSize);
+    memcpy(data_ + pos + kLengthSize, record.data(), size);
+    // Only now is the record part of the log
+    publish(header_->tail, tail + skip + kLengthSize + size);
+    ++pending_;
+    return tail + skip;
+}
+
+size_t Outbox::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+uint64_t Outbox::start(uint64_t offset) const
+{
+    const auto capacity = header_->capacity;
+    auto pos = offset % capacity;
+    uint32_t length = kWrap;
+    if (capacity - pos >= kLengthSize)
+    {
+        memcpy(&length, data_ + pos, kLengthSize);
+    }
+    return length == kWrap ? offset + capacity - pos : offset;
+}
+
+uint32_t Outbox::lengthAt(uint64_t start) const
+{
+    uint32_t length;
+    memcpy(&length, data_ + start % header_->capacity, kLengthSize);
+    return length;
+}
+
+uint64_t Outbox::next(uint64_t start) const
+{
+    return start + kLengthSize + (lengthAt(start) & ~kDelivered);
+}
+
+void Outbox::markDelivered(uint64_t start)
+{
+    auto length = lengthAt(start) | kDelivered;
+    memcpy(data_ + start % header_->capacity, &length, kLengthSize);
+    retryAt_.erase(start);
+    --pending_;
+}
+
+bool Outbox::countPending()
+{
+    const auto capacity = header_->capacity;
+    for (auto offset = header_->head; offset != header_->tail;)
+    {
+        offset = start(offset);
+        if (offset > header_->tail || header_->tail - offset < kLengthSize)
+        {
+            return false;
+        }
+        auto length = lengthAt(offset);
+        auto size = length & ~kDelivered;
+        if (offset % capacity + kLengthSize + size > capacity ||
+            header_->tail - offset < kLengthSize + size)
+        {
+            return false;
+        }
+        pending_ += (length & kDelivered) == 0;
+        offset += kLengthSize + size;
+    }
+    return true;
+}
+
+void Outbox::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_)
+    {
+        // The oldest records that are due, a record that keeps failing does
+        // not hold back the others
+        auto now = std::chrono::steady_clock::now();
+        auto wakeUp = std::chrono::steady_clock::time_point::max();
+        std::vector<uint64_t> offsets;
+        std::vector<string> batch;
+        for (auto offset = header_->head;
+             offset != header_->tail && batch.size() < batchSize_;)
+        {
+            offset = start(offset);
+            auto length = lengthAt(offset);
+            if ((length & kDelivered) == 0)
+            {
+                auto retry = retryAt_.find(offset);
+                if (retry == retryAt_.end() || retry->second <= now)
+                {
+                    offsets.push_back(offset);
+                    batch.emplace_back(
+                        data_ + offset % header_->capacity + kLengthSize,
+                        length);
+                }
+                else
+                {
+                    wakeUp = std::min(wakeUp, retry->second);
+                }
+            }
+            offset = next(offset);
+        }
+        if (batch.empty())
+        {
+            if (wakeUp == std::chrono::steady_clock::time_point::max())
+            {
+                cv_.wait(lock);
+            }
+            else
+            {
+                cv_.wait_until(lock, wakeUp);
+            }
+            continue;
+        }
+
+        lock.unlock();
+        std::vector<bool> delivered;
+        try
+        {
+            delivered = deliver_(batch);
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR << "failed to deliver from the outbox: " << e.what();
+        }
+        lock.lock();
+
+        // Only this thread marks records and moves the head
+        now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < offsets.size(); ++i)
+        {
+            if (i < delivered.size() && delivered[i])
+            {
+                markDelivered(offsets[i]);
+            }
+            else
+            {
+                retryAt_[offsets[i]] = now + retryInterval_;
+            }
+        }
+        // Failed records at the head are copied to the tail, so that the
+        // space of the records behind them can be used again
+        auto head = header_->head;
+        const auto tail = header_->tail;
+        while (head != tail)
+        {
+            auto offset = start(head);
+            auto length = lengthAt(offset);
+            if ((length & kDelivered) == 0)
+            {
+                auto retry = retryAt_.find(offset);
+                if (retry == retryAt_.end())
+                {
+                    break;
+                }
+                auto moved = appendLocked(
+                    string_view(data_ + offset % header_->capacity +
+                                    kLengthSize,
+                                length),
+                    0);
+                if (!moved)
+                {
+                    break;
+                }
+                retryAt_[*moved] = retry->second;
+                markDelivered(offset);
+            }
+            head = next(offset);
+        }
+        publish(header_->head, head);
+    }
+}
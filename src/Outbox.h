@@ -0,0 +1,125 @@
+/**
+ * @file Outbox.h
+ * @brief Deliver requests eventually, from a log on local disk.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace tl::rest
+{
+
+/**
+ * @brief A bounded queue of records kept in a memory-mapped file, drained by
+ * a background thread.
+ *
+ * append() only copies the record into the mapping, so it costs the same
+ * whether the upstream is up or not. The background thread hands the oldest
+ * records to the deliver callback in batches, and marks those it reports as
+ * delivered, whatever their position. The others are retried after
+ * retryInterval, while the records behind them go on being delivered; the
+ * order of delivery is therefore only kept as long as nothing fails.
+ *
+ * The file is a ring buffer. A record that failed is copied from the head to
+ * the tail, so that it does not hold the space of the records behind it;
+ * append() keeps a 16th of the file free for these copies. Records survive
+ * a restart or a crash of the process, and are delivered at least once.
+ * Writing them to the disk is left to the operating system, so a power
+ * failure can lose the latest ones.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class Outbox
+{
+  public:
+    /**
+     * @brief Deliver the records of a batch.
+     *
+     * @return Whether each record of batch was delivered.
+     */
+    using Deliver =
+        std::function<std::vector<bool>(const std::vector<std::string> &batch)>;
+
+    /**
+     * @brief Open the log at path, or create it with room for capacity bytes.
+     *
+     * An existing log keeps its records and its capacity.
+     *
+     * @throw std::runtime_error If the file cannot be created or mapped, or
+     * is not a log.
+     */
+    Outbox(const std::string &path,
+           size_t capacity,
+           size_t batchSize,
+           double retryInterval,
+           Deliver deliver);
+    ~Outbox();
+
+    Outbox(const Outbox &) = delete;
+    Outbox &operator=(const Outbox &) = delete;
+
+    /**
+     * @brief Queue a record for delivery.
+     *
+     * @return false if the log has no room left for it.
+     */
+    bool append(std::string_view record);
+
+    /// The number of records not delivered yet.
+    size_t size() const;
+
+  private:
+    struct Header;
+
+    void run();
+    /// Where the record at offset starts, past the end of the area if it
+    /// was moved to the beginning.
+    uint64_t start(uint64_t offset) const;
+    /// The length of the record at start, with the delivered flag.
+    uint32_t lengthAt(uint64_t start) const;
+    /// The offset after the record at start.
+    uint64_t next(uint64_t start) const;
+    /// Append record if it leaves reserve bytes free, return where it starts.
+    std::optional<uint64_t> appendLocked(std::string_view record,
+                                         uint64_t reserve);
+    /// Flag the record at start as delivered.
+    void markDelivered(uint64_t start);
+    /// Count the records not delivered yet, false if the log is corrupt.
+    bool countPending();
+
+    const size_t batchSize_;
+    const std::chrono::milliseconds retryInterval_;
+    const Deliver deliver_;
+
+    int fd_{-1};
+    size_t mappedSize_{0};
+    Header *header_{nullptr};
+    char *data_{nullptr};
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    /// The records not delivered yet, only kept in memory.
+    size_t pending_{0};
+    /// When the records that failed, by offset, are tried again.
+    std::unordered_map<uint64_t, std::chrono::steady_clock::time_point>
+        retryAt_;
+    bool stop_{false};
+    std::thread thread_;
+};
+
+}  // namespace tl::rest
@@ -0,0 +1,345 @@
+/**
+ * @file StaticRoute.h
+ * @brief Functions whose url and http method are declared in code.
+ *
+ * A route declared with REST_ROUTE is parsed and checked by the compiler: a
+ * malformed url does not compile, and neither does a REST_CALL_* whose
+ * PATH_PARAMs do not match the placeholders of the url. The routes are
+ * constant data, only their hosts can be changed by the configuration.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <drogon/DrObject.h>
+#include <drogon/HttpTypes.h>
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Declare the url and http method of the functor func_name.
+ *
+ * It must come before the REST_FUNC_* that defines the functor, in the same
+ * namespace. Placeholders may name the kind of their PATH_PARAM, `{id:int}`
+ * or `{name:string}`.
+ *
+ * @code
+ * REST_ROUTE(getUserById, Get, "http://localhost:10000/user/{id:int}");
+ * REST_FUNC_SYNC(User, getUserById, int id)
+ * {
+ *     REST_CALL_SYNC(User, PATH_PARAM(id));
+ * }
+ * @endcode
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+#define REST_ROUTE(func_name, http_method, url)                             \
+    struct func_name;                                                       \
+    constexpr tl::rest::StaticRoute restRouteOf(const struct func_name *)   \
+    {                                                                       \
+        return {url, drogon::http_method};                                  \
+    }
+
+/**
+ * @brief Normal functions have no route declared in code, REST_FUNC_* shadow
+ * this with the type of their functor.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+using RestFuncType = void;
+
+/// Check the arguments of REST_CALL_* against the route of the functor, it
+/// is skipped in normal functions.
+#define REST_CHECK_ROUTE(...)               \
+    tl::rest::checkRouteArgs<RestFuncType>( \
+        decltype(tl::rest::argTypes(__VA_ARGS__)){})
+
+namespace tl::rest
+{
+
+/**
+ * @brief The kinds a placeholder of a url can require of its PATH_PARAM.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+enum class PlaceholderKind
+{
+    Any,
+    Int,
+    String
+};
+
+/**
+ * @brief Called when a url template is malformed. It is not constexpr, so
+ * the compiler reports the call together with the reason.
+ */
+inline void invalidUrlTemplate(const char * /* reason */)
+{
+}
+
+/**
+ * @brief A url with `{}` placeholders, parsed at compile time.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct UrlTemplate
+{
+    static constexpr size_t kMaxPlaceholders = 16;
+
+    consteval UrlTemplate(const char *text) : url(text)
+    {
+        size_t pos = 0;
+        bool unixSocket = false;
+        if (url.starts_with("http://"))
+        {
+            pos = 7;
+        }
+        else if (url.starts_with("https://"))
+        {
+            pos = 8;
+        }
+        else if (url.starts_with("inproc://"))
+        {
+            pos = 9;
+        }
+        else if (url.starts_with("unix://"))
+        {
+            pos = 7;
+            unixSocket = true;
+        }
+        else if (url.find("://") != std::string_view::npos)
+        {
+            invalidUrlTemplate(
+                "only http, https, inproc and unix are supported");
+        }
+        if (unixSocket)
+        {
+            // unix:///path/to.sock:/request/path
+            if (pos >= url.size() || url[pos] != '/')
+            {
+                invalidUrlTemplate("the socket path must be absolute");
+            }
+            auto colon = url.find(":/", pos);
+            hostEnd = std::min(colon, url.size());
+            pathStart = colon == std::string_view::npos ? url.size()
+                                                        : colon + 1;
+        }
+        else
+        {
+            if (pos >= url.size() || url[pos] == '/')
+            {
+                invalidUrlTemplate("the host is missing");
+            }
+            pathStart = std::min(url.find('/', pos), url.size());
+            hostEnd = pathStart;
+        }
+
+        size_t open = std::string_view::npos;
+        for (size_t i = pos; i < url.size(); ++i)
+        {
+            char c = url[i];
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                invalidUrlTemplate("urls cannot contain whitespace");
+            }
+            else if (c == '{')
+            {
+                if (open != std::string_view::npos)
+                {
+                    invalidUrlTemplate("placeholders cannot be nested");
+                }
+                open = i;
+            }
+            else if (c == '}')
+            {
+                if (open == std::string_view::npos)
+                {
+                    invalidUrlTemplate("'}' without '{'");
+                }
+                if (placeholderCount == kMaxPlaceholders)
+                {
+                    invalidUrlTemplate("too many placeholders");
+                }
+                starts[placeholderCount] = open;
+                ends[placeholderCount] = i + 1;
+                kinds[placeholderCount++] =
+                    kindOf(url.substr(open + 1, i - open - 1));
+                open = std::string_view::npos;
+            }
+        }
+        if (open != std::string_view::npos)
+        {
+            invalidUrlTemplate("'{' without '}'");
+        }
+    }
+
+    /// The url as it was written.
+    std::string_view url;
+    /// Where the host ends, it is followed by a colon for unix urls.
+    size_t hostEnd{0};
+    /// Where the path starts, the size of url if it has none.
+    size_t pathStart{0};
+    size_t placeholderCount{0};
+    /// Where each placeholder starts, and where it ends after its brace.
+    std::array<size_t, kMaxPlaceholders> starts{};
+    std::array<size_t, kMaxPlaceholders> ends{};
+    std::array<PlaceholderKind, kMaxPlaceholders> kinds{};
+
+  private:
+    static consteval PlaceholderKind kindOf(std::string_view placeholder)
+    {
+        auto colon = placeholder.find(':');
+        if (colon == std::string_view::npos)
+        {
+            return PlaceholderKind::Any;
+        }
+        auto kind = placeholder.substr(colon + 1);
+        if (kind == "int")
+        {
+            return PlaceholderKind::Int;
+        }
+        if (kind == "string")
+        {
+            return PlaceholderKind::String;
+        }
+        invalidUrlTemplate("the kind of a placeholder is int or string");
+        return PlaceholderKind::Any;
+    }
+};
+
+/**
+ * @brief The url and http method of a function, declared with REST_ROUTE.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+struct StaticRoute
+{
+    consteval StaticRoute(const char *url, drogon::HttpMethod method)
+        : url(url), method(method)
+    {
+    }
+
+    UrlTemplate url;
+    drogon::HttpMethod method;
+};
+
+/**
+ * @brief All the routes declared in code, by function name.
+ *
+ * Filled before main, when the functors are instantiated.
+ */
+inline std::vector<std::pair<std::string, const StaticRoute *>> &staticRoutes()
+{
+    static std::vector<std::pair<std::string, const StaticRoute *>> routes;
+    return routes;
+}
+
+/// Concept to check if a route is declared for the functor F
+template <typename F>
+concept HasStaticRoute = requires {
+    restRouteOf(static_cast<const F *>(nullptr));
+};
+
+/// Holds the route of F and adds it to staticRoutes()
+template <typename F>
+struct StaticRouteRegistrar
+{
+    static constexpr StaticRoute route =
+        restRouteOf(static_cast<const F *>(nullptr));
+
+    inline static const bool registered = []() {
+        staticRoutes().emplace_back(drogon::DrObject<F>::classTypeName(),
+                                    &route);
+        return true;
+    }();
+};
+
+/**
+ * @brief Marks the next argument of REST_CALL_* as a path parameter.
+ *
+ * @see PATH_PARAM
+ */
+struct PathParamTag
+{
+};
+
+inline constexpr PathParamTag pathParam{};
+
+/// The types of the arguments of REST_CALL_*, without evaluating them.
+template <typename... Args>
+struct ArgTypes
+{
+};
+
+template <typename... Args>
+ArgTypes<std::remove_cvref_t<Args>...> argTypes(const Args &...);
+
+template <typename T>
+constexpr bool matchesKind(PlaceholderKind kind)
+{
+    switch (kind)
+    {
+        case PlaceholderKind::Int:
+            return std::is_integral_v<T> && !std::is_same_v<T, bool>;
+        case PlaceholderKind::String:
+            return std::is_convertible_v<const T &, std::string_view>;
+        default:
+            return true;
+    }
+}
+
+template <typename... Args>
+consteval bool pathParamKindsMatch(const UrlTemplate &url)
+{
+    constexpr bool isTag[] = {std::is_same_v<Args, PathParamTag>..., false};
+    constexpr bool (*matches[])(PlaceholderKind) = {&matchesKind<Args>...,
+                                                     nullptr};
+    size_t placeholder = 0;
+    for (size_t i = 0; i + 1 < sizeof...(Args); ++i)
+    {
+        if (isTag[i] && !matches[i + 1](url.kinds[placeholder++]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Fail to compile if the PATH_PARAMs of a call do not match the
+ * placeholders of the route of F, does nothing at run time.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+template <typename F, typename... Args>
+inline void checkRouteArgs(ArgTypes<Args...>)
+{
+    if constexpr (!std::is_void_v<F> && HasStaticRoute<F>)
+    {
+        constexpr const auto &url = StaticRouteRegistrar<F>::route.url;
+        static_assert((0 + ... + std::is_same_v<Args, PathParamTag>) ==
+                          url.placeholderCount,
+                      "The number of PATH_PARAM does not match the "
+                      "placeholders of the REST_ROUTE.");
+        static_assert(pathParamKindsMatch<Args...>(url),
+                      "A PATH_PARAM does not match the kind of its "
+                      "placeholder in the REST_ROUTE.");
+        (void)StaticRouteRegistrar<F>::registered;
+    }
+}
+
+}  // namespace tl::rest
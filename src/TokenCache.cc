@@ -0,0 +1,302 @@
+#include "TokenCache.h"
+
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using namespace tl::rest;
+
+namespace
+{
+
+/// A callback of get() with what it is called with.
+using Ready = tuple<TokenCache::Callback, string, string>;
+
+/// Call the callbacks, without holding the lock of the cache.
+void callReady(vector<Ready> &ready)
+{
+    for (auto &[callback, token, error] : ready)
+    {
+        callback(std::move(token), std::move(error));
+    }
+    ready.clear();
+}
+
+}  // namespace
+
+TokenCache::TokenCache() = default;
+
+TokenCache::~TokenCache()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void TokenCache::add(const string &key, Fetch fetch, double skew)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto &entry = entries_[key];
+        entry.fetch = std::move(fetch);
+        entry.skew = milliseconds(static_cast<int64_t>(skew * 1000));
+        entry.generation = ++nextGeneration_;
+        // A token of the previous fetch is not for this one
+        entry.value.clear();
+        entry.error.clear();
+        entry.failures = 0;
+        // Due at once
+        entry.refreshAt = {};
+        if (!thread_.joinable())
+        {
+            thread_ = std::thread([this]() { run(); });
+        }
+    }
+    cv_.notify_all();
+}
+
+void TokenCache::remove(const string &key)
+{
+    vector<Ready> ready;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto iter = entries_.find(key);
+        if (iter == entries_.end())
+        {
+            return;
+        }
+        for (auto &[deadline, callback] : iter->second.waiters)
+        {
+            ready.emplace_back(
+                std::move(callback), "", "no token is configured for " + key);
+        }
+        entries_.erase(iter);
+    }
+    callReady(ready);
+}
+
+string TokenCache::noToken(const string &key, const Entry &entry)
+{
+    return "no valid token for " + key +
+           (entry.error.empty() ? "" : ": " + entry.error);
+}
+
+string TokenCache::get(const string &key, milliseconds wait)
+{
+    unique_lock<mutex> lock(mutex_);
+    // Looked up again after each wait, key may be removed meanwhile
+    auto find = [this, &key]() {
+        auto iter = entries_.find(key);
+        if (iter == entries_.end())
+        {
+            throw runtime_error("no token is configured for " + key);
+        }
+        return iter;
+    };
+    find();
+    cv_.wait_for(lock, wait, [this, &find]() {
+        return stop_ || find()->second.valid();
+    });
+    const auto &entry = find()->second;
+    if (!entry.valid())
+    {
+        throw runtime_error(noToken(key, entry));
+    }
+    return entry.value;
+}
+
+void TokenCache::get(const string &key,
+                     milliseconds wait,
+                     Callback &&callback)
+{
+    string token;
+    string error;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto iter = entries_.find(key);
+        if (iter == entries_.end())
+        {
+            error = "no token is configured for " + key;
+        }
+        else if (iter->second.valid())
+        {
+            token = iter->second.value;
+        }
+        else if (wait.count() > 0 && !stop_)
+        {
+            iter->second.waiters.emplace_back(steady_clock::now() + wait,
+                                              std::move(callback));
+            // The thread wakes up for the deadline
+            cv_.notify_all();
+            return;
+        }
+        else
+        {
+            error = noToken(key, iter->second);
+        }
+    }
+    callback(std::move(token), std::move(error));
+}
+
+optional<string> TokenCache::tryGet(const string &key)
+{
+    lock_guard<mutex> lock(mutex_);
+    auto iter = entries_.find(key);
+    if (iter == entries_.end())
+    {
+        throw runtime_error("no token is configured for " + key);
+    }
+    if (!iter->second.valid())
+    {
+        return nullopt;
+    }
+    return iter->second.value;
+}
+
+void TokenCache::run()
+{
+    struct Due
+    {
+        string key;
+        uint64_t generation;
+        Fetch fetch;
+    };
+    vector<Ready> ready;
+    unique_lock<mutex> lock(mutex_);
+    while (!stop_)
+    {
+        auto now = steady_clock::now();
+        auto wakeUp = now + hours(1);
+        vector<Due> due;
+        for (auto &[key, entry] : entries_)
+        {
+            auto &waiters = entry.waiters;
+            auto expired = std::partition(
+                waiters.begin(), waiters.end(), [now](const Waiter &waiter) {
+                    return now < waiter.first;
+                });
+            for (auto iter = expired; iter != waiters.end(); ++iter)
+            {
+                ready.emplace_back(
+                    std::move(iter->second), "", noToken(key, entry));
+            }
+            waiters.erase(expired, waiters.end());
+            for (const auto &[deadline, callback] : waiters)
+            {
+                wakeUp = std::min(wakeUp, deadline);
+            }
+            if (entry.refreshAt <= now)
+            {
+                due.push_back({key, entry.generation, entry.fetch});
+            }
+            else
+            {
+                wakeUp = std::min(wakeUp, entry.refreshAt);
+            }
+        }
+        if (!ready.empty())
+        {
+            lock.unlock();
+            callReady(ready);
+            lock.lock();
+        }
+        if (due.empty())
+        {
+            cv_.wait_until(lock, wakeUp);
+            continue;
+        }
+
+        lock.unlock();
+        vector<pair<Token, string>> results;
+        for (const auto &item : due)
+        {
+            auto &[token, error] = results.emplace_back();
+            try
+            {
+                token = item.fetch();
+                if (token.value.empty())
+                {
+                    error = "the token is empty";
+                }
+            }
+            catch (const std::exception &e)
+            {
+                error = e.what();
+            }
+        }
+        lock.lock();
+
+        now = steady_clock::now();
+        for (size_t i = 0; i < due.size(); ++i)
+        {
+            // Removed or added again while fetching
+            auto iter = entries_.find(due[i].key);
+            if (iter == entries_.end() ||
+                iter->second.generation != due[i].generation)
+            {
+                continue;
+            }
+            auto &entry = iter->second;
+            const auto &[token, error] = results[i];
+            if (!error.empty())
+            {
+                LOG_WARN << "failed to fetch a token for " << due[i].key
+                         << ": " << error;
+                entry.error = error;
+                auto backoff = seconds(1 << std::min(entry.failures, 5u));
+                entry.refreshAt = now + std::min<seconds>(backoff, seconds(30));
+                ++entry.failures;
+                continue;
+            }
+            entry.value = token.value;
+            entry.error.clear();
+            entry.failures = 0;
+            for (auto &[deadline, callback] : entry.waiters)
+            {
+                ready.emplace_back(std::move(callback), entry.value, "");
+            }
+            entry.waiters.clear();
+            if (token.expiresIn <= 0)
+            {
+                entry.expiresAt = steady_clock::time_point::max();
+                entry.refreshAt = steady_clock::time_point::max();
+                continue;
+            }
+            auto lifetime = duration_cast<steady_clock::duration>(
+                duration<double>(token.expiresIn));
+            entry.expiresAt = now + lifetime;
+            entry.refreshAt =
+                entry.expiresAt -
+                std::min<steady_clock::duration>(entry.skew, lifetime / 2);
+        }
+        cv_.notify_all();
+        if (!ready.empty())
+        {
+            lock.unlock();
+            callReady(ready);
+            lock.lock();
+        }
+    }
+    // Nothing is fetched any more
+    for (auto &[key, entry] : entries_)
+    {
+        for (auto &[deadline, callback] : entry.waiters)
+        {
+            ready.emplace_back(std::move(callback), "", noToken(key, entry));
+        }
+        entry.waiters.clear();
+    }
+    lock.unlock();
+    callReady(ready);
+}
@@ -0,0 +1,146 @@
+/**
+ * @file TokenCache.h
+ * @brief Keep the access tokens of upstream hosts fresh, off the request path.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tl::rest
+{
+
+/**
+ * @brief A cache of access tokens, refreshed by a background thread before
+ * they expire.
+ *
+ * Only the background thread fetches tokens, so a token is fetched once
+ * however many calls need it. A token is refreshed when skew seconds are left
+ * before it expires, or half of its lifetime if that is shorter. A failed
+ * fetch keeps the current token while it is valid, and is retried after 1s,
+ * then 2s, up to 30s.
+ *
+ * The background thread starts with the first key.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class TokenCache
+{
+  public:
+    /// What a token endpoint returned.
+    struct Token
+    {
+        std::string value;
+        /// Seconds before the token expires, 0 if it does not.
+        double expiresIn{0};
+    };
+
+    /// Fetch a new token, throws on failure.
+    using Fetch = std::function<Token()>;
+
+    /// Called with a valid token, or with an empty one and the reason there
+    /// is none.
+    using Callback = std::function<void(std::string token, std::string error)>;
+
+    TokenCache();
+    ~TokenCache();
+
+    TokenCache(const TokenCache &) = delete;
+    TokenCache &operator=(const TokenCache &) = delete;
+
+    /**
+     * @brief Start fetching the tokens of key, and keep them fresh.
+     *
+     * Adding key again drops its token, the next one comes from fetch.
+     *
+     * @param skew How long before expiry the token is refreshed, in seconds.
+     */
+    void add(const std::string &key, Fetch fetch, double skew);
+
+    /**
+     * @brief Stop refreshing the tokens of key and drop its token; the
+     * callbacks waiting for it are called with an error.
+     */
+    void remove(const std::string &key);
+
+    /**
+     * @brief Get the token of key, waiting for the first one if it is not
+     * fetched yet.
+     *
+     * @throw std::runtime_error If key was not added, or there is no valid
+     * token within wait.
+     */
+    std::string get(const std::string &key, std::chrono::milliseconds wait);
+
+    /**
+     * @brief Same as above, without blocking.
+     *
+     * callback is called at once when the token is valid, otherwise on the
+     * background thread as soon as a token is fetched, or once wait has
+     * passed without one.
+     */
+    void get(const std::string &key,
+             std::chrono::milliseconds wait,
+             Callback &&callback);
+
+    /**
+     * @brief The token of key if it is valid now, without waiting.
+     *
+     * @throw std::runtime_error If key was not added.
+     */
+    std::optional<std::string> tryGet(const std::string &key);
+
+  private:
+    using Waiter =
+        std::pair<std::chrono::steady_clock::time_point, Callback>;
+
+    struct Entry
+    {
+        Fetch fetch;
+        std::chrono::milliseconds skew;
+        std::string value;
+        std::chrono::steady_clock::time_point expiresAt;
+        std::chrono::steady_clock::time_point refreshAt;
+        unsigned failures{0};
+        std::string error;
+        /// Changed by add(), a fetch started before does not count.
+        uint64_t generation{0};
+        /// The callbacks of get() waiting for a token.
+        std::vector<Waiter> waiters;
+
+        bool valid() const
+        {
+            return !value.empty() &&
+                   std::chrono::steady_clock::now() < expiresAt;
+        }
+    };
+
+    void run();
+
+    /// Why key has no valid token.
+    static std::string noToken(const std::string &key, const Entry &entry);
+
+    std::mutex mutex_;
+    /// Wakes the background thread and the callers of get().
+    std::condition_variable cv_;
+    std::unordered_map<std::string, Entry> entries_;
+    bool stop_{false};
+    uint64_t nextGeneration_{0};
+    std::thread thread_;
+};
+
+}  // namespace tl::rest
@@ -0,0 +1,305 @@
+#include "UnixClient.h"
+
+#include "HttpStream.h"
+
+#include <drogon/utils/Utilities.h>
+#include <trantor/net/EventLoopThread.h>
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace drogon;
+using namespace tl::rest;
+
+namespace
+{
+
+/**
+ * @brief A thread that runs the blocking exchanges of some clients, one after
+ * the other, so that they never hold up an event loop.
+ */
+class Worker
+{
+  public:
+    Worker() : thread_([this]() { run(); })
+    {
+    }
+
+    ~Worker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        ready_.notify_one();
+        thread_.join();
+    }
+
+    void post(std::function<void()> &&task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        ready_.notify_one();
+    }
+
+  private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            ready_.wait(lock, [this]() { return stopped_ || !tasks_.empty(); });
+            if (tasks_.empty())
+            {
+                return;
+            }
+            auto task = std::move(tasks_.front());
+            tasks_.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopped_{false};
+    std::thread thread_;
+};
+
+/// The workers, started on first use and handed out to the clients in turn.
+Worker &nextWorker()
+{
+    static std::vector<unique_ptr<Worker>> workers;
+    static std::once_flag started;
+    static std::atomic<size_t> next{0};
+    std::call_once(started, []() {
+        auto count = std::max(2u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < count; ++i)
+        {
+            workers.push_back(make_unique<Worker>());
+        }
+    });
+    return *workers[next++ % workers.size()];
+}
+
+/**
+ * @brief The threads the callbacks are called on, started on first use and
+ * handed out to the clients in turn. Nothing blocks on them.
+ */
+trantor::EventLoop *nextLoop()
+{
+    static std::vector<unique_ptr<trantor::EventLoopThread>> threads;
+    static std::once_flag started;
+    static std::atomic<size_t> next{0};
+    std::call_once(started, []() {
+        auto count = std::max(2u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < count; ++i)
+        {
+            threads.push_back(make_unique<trantor::EventLoopThread>("unix"));
+            threads.back()->run();
+        }
+    });
+    return threads[next++ % threads.size()]->getLoop();
+}
+
+/// The request line and the headers of req.
+string requestHead(const HttpRequest &req)
+{
+    string head = req.methodString();
+    // Encoded like drogon's client does
+    head.append(" ").append(utils::urlEncode(req.path()));
+    if (!req.query().empty())
+    {
+        head.append("?").append(req.query());
+    }
+    head.append(" HTTP/1.1\r\n");
+    auto headers = req.headers();
+    headers.try_emplace("host", "localhost");
+    if (headers.find("content-type") == headers.end() &&
+        req.contentType() == CT_APPLICATION_JSON)
+    {
+        headers["content-type"] = "application/json";
+    }
+    headers["content-length"] = std::to_string(req.body().size());
+    for (const auto &[field, value] : headers)
+    {
+        head.append(field).append(": ").append(value).append("\r\n");
+    }
+    head.append("\r\n");
+    return head;
+}
+
+/// Build a response from what was read, as drogon's client would.
+HttpResponsePtr toResponse(const StreamResponse &head, string &&body)
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(static_cast<HttpStatusCode>(head.status));
+    for (const auto &[field, value] : head.headers)
+    {
+        // Describe the framing, which is gone
+        if (field == "content-length" || field == "transfer-encoding" ||
+            field == "connection")
+        {
+            continue;
+        }
+        resp->addHeader(field, value);
+    }
+    resp->setBody(std::move(body));
+    return resp;
+}
+
+}  // namespace
+
+struct UnixClient::State
+{
+    string path;
+    /// Where the exchanges run, so the kept-alive connection is only used
+    /// there.
+    Worker *worker{nullptr};
+    /// Where the callbacks are called.
+    trantor::EventLoop *loop{nullptr};
+    function<void(int)> sockOptCallback;
+    std::optional<HttpStream> stream;
+    std::atomic<size_t> bytesSent{0};
+    std::atomic<size_t> bytesReceived{0};
+};
+
+UnixClient::UnixClient(string path) : state_(make_shared<State>())
+{
+    state_->path = std::move(path);
+    state_->worker = &nextWorker();
+    state_->loop = nextLoop();
+}
+
+trantor::EventLoop *UnixClient::getLoop()
+{
+    return state_->loop;
+}
+
+size_t UnixClient::bytesSent() const
+{
+    return state_->bytesSent;
+}
+
+size_t UnixClient::bytesReceived() const
+{
+    return state_->bytesReceived;
+}
+
+string UnixClient::host() const
+{
+    return state_->path;
+}
+
+void UnixClient::setSockOptCallback(function<void(int)> callback)
+{
+    state_->sockOptCallback = std::move(callback);
+}
+
+void UnixClient::sendRequest(const HttpRequestPtr &req,
+                             const HttpReqCallback &callback,
+                             double timeout)
+{
+    sendRequest(req, HttpReqCallback(callback), timeout);
+}
+
+void UnixClient::sendRequest(const HttpRequestPtr &req,
+                             HttpReqCallback &&callback,
+                             double timeout)
+{
+    state_->worker->post([state = state_,
+                          req,
+                          callback = std::move(callback),
+                          timeout]() mutable {
+        exchange(*state, req, std::move(callback), timeout);
+    });
+}
+
+void UnixClient::exchange(State &state,
+                          const HttpRequestPtr &req,
+                          HttpReqCallback &&callback,
+                          double timeout)
+{
+    StreamOptions options;
+    if (timeout > 0)
+    {
+        options.timeout = timeout;
+    }
+    auto head = requestHead(*req);
+    auto body = req->body();
+    ReqResult result = ReqResult::Ok;
+    HttpResponsePtr resp;
+    while (true)
+    {
+        bool reused = state.stream.has_value();
+        // Past this point the server may have the request
+        bool sent = false;
+        try
+        {
+            if (reused)
+            {
+                state.stream->setTimeout(options.timeout);
+            }
+            else
+            {
+                state.stream.emplace(
+                    HttpStream::connectUnix(state.path, options));
+                if (state.sockOptCallback)
+                {
+                    state.sockOptCallback(state.stream->fd());
+                }
+            }
+            state.stream->send(head, body);
+            sent = true;
+            state.bytesSent += head.size() + body.size();
+            auto response = state.stream->readHead(req->method() == Head);
+            string content;
+            state.stream->readBody(response, [&content](string_view chunk) {
+                content.append(chunk);
+                return true;
+            });
+            state.bytesReceived += content.size();
+            if (!state.stream->keepAlive(response))
+            {
+                state.stream.reset();
+            }
+            resp = toResponse(response, std::move(content));
+        }
+        catch (const StreamTimeout &e)
+        {
+            state.stream.reset();
+            result = ReqResult::Timeout;
+        }
+        catch (const std::exception &e)
+        {
+            state.stream.reset();
+            // The server closed the idle connection, and cannot have
+            // processed the request: it did not take it, or ended the
+            // connection without starting a response
+            if (reused && (!sent || dynamic_cast<const StreamClosed *>(&e)))
+            {
+                continue;
+            }
+            LOG_DEBUG << "request to unix://" << state.path
+                      << " failed: " << e.what();
+            result = ReqResult::NetworkFailure;
+        }
+        break;
+    }
+    state.loop->queueInLoop(
+        [callback = std::move(callback), result, resp = std::move(resp)]() {
+            callback(result, resp);
+        });
+}
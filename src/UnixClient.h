@@ -0,0 +1,126 @@
+/**
+ * @file UnixClient.h
+ * @brief Call hosts listening on a Unix domain socket, through urls like
+ * `unix:///path/to.sock:/request/path`.
+ *
+ * Sidecars and services on the same machine can be reached without the
+ * loopback TCP stack, and without using up ephemeral ports.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+
+#pragma once
+
+#include <drogon/HttpClient.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace tl::rest
+{
+
+/**
+ * @brief An HttpClient that speaks HTTP/1.1 over one kept-alive connection to
+ * a Unix domain socket.
+ *
+ * Requests are sent one after the other, like a TCP client without
+ * pipelining. Several clients of the same socket give several connections,
+ * see connections_per_host.
+ *
+ * The exchanges are blocking and run on a small set of worker threads shared
+ * by all the clients, never on an event loop. The callbacks are called on
+ * getLoop(). The timeout limits each wait on the socket rather than the whole
+ * call. A request on a reused connection that the server has closed in the
+ * meantime is sent again on a new one, but only when it cannot have been
+ * processed: writing it failed, or the connection ended before the first byte
+ * of the response. The request path is percent-encoded like drogon's client
+ * does. TLS and cookie settings do not apply and are ignored.
+ *
+ * The Content-Type sent is the Content-Type header of the request if it has
+ * one, otherwise application/json for JSON bodies.
+ *
+ * @date 2026-10-19
+ * @since v0.5.0
+ */
+class UnixClient : public drogon::HttpClient
+{
+  public:
+    explicit UnixClient(std::string path);
+
+    void sendRequest(const drogon::HttpRequestPtr &req,
+                     const drogon::HttpReqCallback &callback,
+                     double timeout = 0) override;
+    void sendRequest(const drogon::HttpRequestPtr &req,
+                     drogon::HttpReqCallback &&callback,
+                     double timeout = 0) override;
+
+    void setPipeliningDepth(size_t) override
+    {
+    }
+
+    void enableCookies(bool = true) override
+    {
+    }
+
+    void addCookie(const std::string &, const std::string &) override
+    {
+    }
+
+    void addCookie(const drogon::Cookie &) override
+    {
+    }
+
+    void setUserAgent(const std::string &) override
+    {
+    }
+
+    trantor::EventLoop *getLoop() override;
+
+    size_t bytesSent() const override;
+    size_t bytesReceived() const override;
+
+    /// The path of the socket.
+    std::string host() const override;
+
+    uint16_t port() const override
+    {
+        return 0;
+    }
+
+    bool secure() const override
+    {
+        return false;
+    }
+
+    void setCertPath(const std::string &, const std::string &) override
+    {
+    }
+
+    void addSSLConfigs(
+        const std::vector<std::pair<std::string, std::string>> &) override
+    {
+    }
+
+    /// Called with each new socket, set it before the first request.
+    void setSockOptCallback(std::function<void(int)> callback) override;
+
+  private:
+    struct State;
+
+    /**
+     * @brief Send req on the kept-alive connection of state, or on a new one,
+     * and read the whole response. Runs on the worker of state, the callback
+     * is queued to its loop.
+     */
+    static void exchange(State &state,
+                         const drogon::HttpRequestPtr &req,
+                         drogon::HttpReqCallback &&callback,
+                         double timeout);
+
+    /// Shared with the queued requests, which may outlive the client.
+    std::shared_ptr<State> state_;
+};
+
+}  // namespace tl::rest
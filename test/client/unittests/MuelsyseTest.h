@@ -1,8 +1,21 @@
 
 #include <gtest/gtest.h>
+#include <trantor/net/EventLoopThread.h>
+#ifdef MUELSYSE_WITH_BROTLI
+#include <brotli/decode.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
 // FRIEND_TEST
 #include "../../../src/Muelsyse.h"
 
+#include "../../../src/DeadlineFilter.h"
+
 drogon::HttpMethod fromString(const std::string &method);
 
 TEST(HttpMethodFromStringTest, All)
@@ -38,6 +51,14 @@ class MuelsyseTest : public tl::rest::Muelsyse
     {
         return tl::rest::Muelsyse::prepare(url, std::move(args));
     }
+
+    tl::rest::PreparedCall prepareCall(const std::string &funcName) const
+    {
+        return tl::rest::Muelsyse::prepareCall(funcName);
+    }
+
+    using Registration = tl::rest::Muelsyse::Registration;
+    using tl::rest::Muelsyse::registerRest;
 };
 
 TEST(JsonToStringInPathTest, All)
@@ -187,6 +208,1430 @@ TEST(PrepareTest, All)
                  std::invalid_argument);
 }
 
+TEST(PrepareTest, Compression)
+{
+    using namespace tl::rest;
+    MuelsyseTest muelsyse;
+    muelsyse.initAndStart(drogon::app().getCustomConfig());
+
+    auto [smallClient, smallRequest] =
+        muelsyse.prepare("testCompression", {"name", "Muelsyse"});
+    EXPECT_TRUE(smallRequest->getHeader("content-encoding").empty());
+    EXPECT_STREQ("gzip", smallRequest->getHeader("accept-encoding").c_str());
+
+    std::string text(1024, 'a');
+    auto [largeClient, largeRequest] =
+        muelsyse.prepare("testCompression", {"text", text});
+    EXPECT_STREQ("gzip", largeRequest->getHeader("content-encoding").c_str());
+    auto compressed = largeRequest->body();
+    auto body =
+        drogon::utils::gzipDecompress(compressed.data(), compressed.size());
+    Json::Value json;
+    Json::Reader reader;
+    ASSERT_TRUE(reader.parse(body, json));
+    EXPECT_EQ(text, json["text"].asString());
+
+    auto stats = muelsyse.getStats("testCompression");
+    EXPECT_EQ(body.size() + smallRequest->body().size(),
+              stats["request_bytes"].asUInt64());
+    EXPECT_EQ(compressed.size() + smallRequest->body().size(),
+              stats["request_bytes_sent"].asUInt64());
+    EXPECT_TRUE(muelsyse.getStats("inexistent").isNull());
+}
+
+TEST(BodyCodecTest, RoundTrip)
+{
+    using namespace tl::rest;
+    Json::Value json;
+    json["int"] = -1000;
+    json["uint"] = Json::UInt64(18446744073709551615ull);
+    json["real"] = 1.5;
+    json["null"] = Json::nullValue;
+    json["bool"] = true;
+    json["string"] = std::string(300, 'a');
+    json["array"].append(1);
+    json["array"].append("Muelsyse");
+    json["object"]["name"] = "Muelsyse";
+    for (auto name : {"json", "msgpack", "cbor"})
+    {
+        auto codec = BodyCodec::get(name);
+        ASSERT_NE(nullptr, codec);
+        std::string body;
+        codec->encode(json, body);
+        Json::Value result;
+        ASSERT_TRUE(codec->decode(body, result));
+        EXPECT_EQ(json, result);
+        body.resize(body.size() / 2);
+        EXPECT_FALSE(codec->decode(body, result));
+    }
+    EXPECT_EQ(nullptr, BodyCodec::get("inexistent"));
+}
+
+TEST(BodyCodecTest, KnownEncodings)
+{
+    using namespace tl::rest;
+    Json::Value json;
+    // {"a": -1000} in MessagePack
+    ASSERT_TRUE(BodyCodec::get("msgpack")->decode(
+        std::string_view("\x81\xa1\x61\xd1\xfc\x18", 6), json));
+    EXPECT_EQ(-1000, json["a"].asInt());
+    // [1, [2, 3]] in CBOR, with indefinite length
+    ASSERT_TRUE(BodyCodec::get("cbor")->decode(
+        std::string_view("\x9f\x01\x82\x02\x03\xff", 6), json));
+    EXPECT_EQ(3, json[1][1].asInt());
+    // 1.0 as half-precision float in CBOR
+    ASSERT_TRUE(BodyCodec::get("cbor")->decode(
+        std::string_view("\xf9\x3c\x00", 3), json));
+    EXPECT_EQ(1.0, json.asDouble());
+}
+
+TEST(BodyCodecTest, JsonLikeJsoncpp)
+{
+    // Whichever parser is built in, the values are those of jsoncpp
+    std::string body =
+        R"({"a": 1, "b": -2, "c": 1.5, "d": "\u00e9\n", "e": [true, null],)"
+        R"( "f": 18446744073709551615, "g": {}, "a": 3})";
+    Json::Value expected;
+    std::unique_ptr<Json::CharReader> reader(
+        Json::CharReaderBuilder().newCharReader());
+    ASSERT_TRUE(reader->parse(
+        body.data(), body.data() + body.size(), &expected, nullptr));
+    Json::Value json;
+    ASSERT_TRUE(tl::rest::BodyCodec::get("json")->decode(body, json));
+    EXPECT_EQ(expected, json);
+    EXPECT_EQ(Json::intValue, json["a"].type());
+    EXPECT_EQ(Json::uintValue, json["f"].type());
+    EXPECT_FALSE(tl::rest::BodyCodec::get("json")->decode("[1, ]", json));
+}
+
+TEST(PrepareTest, BodyHint)
+{
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["function_list"][0]["name"] = "upload";
+    config["function_list"][0]["url"] = "http://localhost:8000/test";
+    config["function_list"][0]["http_method"] = "post";
+    muelsyse.initAndStart(config);
+
+    auto [client, large] =
+        muelsyse.prepare("upload", {"data", std::string(100000, 'x')});
+    auto hint = muelsyse.getStats("upload")["request_body_hint"].asUInt64();
+    EXPECT_EQ(large->body().size(), hint);
+    // Without a compression item, large bodies are sent as they are
+    EXPECT_TRUE(large->getHeader("content-encoding").empty());
+    EXPECT_EQ(100000, (*large->jsonObject())["data"].asString().size());
+    EXPECT_EQ(hint,
+              muelsyse.getStats("upload")["request_bytes_sent"].asUInt64());
+
+    // Small bodies lower the mark slowly
+    auto [sameClient, small] = muelsyse.prepare("upload", {"data", 1});
+    auto lowered = muelsyse.getStats("upload")["request_body_hint"].asUInt64();
+    EXPECT_LT(lowered, hint);
+    EXPECT_GT(lowered, hint / 2);
+    EXPECT_EQ(1, (*small->jsonObject())["data"].asInt());
+}
+
+TEST(PrepareTest, Codec)
+{
+    using namespace tl::rest;
+    MuelsyseTest muelsyse;
+    muelsyse.initAndStart(drogon::app().getCustomConfig());
+
+    auto [client, request] =
+        muelsyse.prepare("testMsgPack", {"name", "Muelsyse"});
+    EXPECT_NE(drogon::CT_APPLICATION_JSON, request->contentType());
+    EXPECT_STREQ("application/msgpack", request->getHeader("accept").c_str());
+    Json::Value json;
+    ASSERT_TRUE(BodyCodec::get("msgpack")->decode(request->body(), json));
+    EXPECT_STREQ("Muelsyse", json["name"].asCString());
+
+    // A codec alone does not compress, however large the body
+    auto [sameClient, large] =
+        muelsyse.prepare("testMsgPack", {"name", std::string(10000, 'a')});
+    EXPECT_TRUE(large->getHeader("content-encoding").empty());
+    ASSERT_TRUE(BodyCodec::get("msgpack")->decode(large->body(), json));
+    EXPECT_EQ(10000, json["name"].asString().size());
+}
+
+#ifdef MUELSYSE_WITH_BROTLI
+TEST(PrepareTest, Brotli)
+{
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["function_list"][0]["name"] = "upload";
+    config["function_list"][0]["url"] = "http://localhost:8000/test";
+    config["function_list"][0]["http_method"] = "post";
+    config["function_list"][0]["compression"]["algorithm"] = "br";
+    config["function_list"][0]["compression"]["min_size"] = 64;
+    muelsyse.initAndStart(config);
+
+    auto [client, request] =
+        muelsyse.prepare("upload", {"data", std::string(10000, 'x')});
+    EXPECT_STREQ("br", request->getHeader("content-encoding").c_str());
+    EXPECT_NE(std::string::npos,
+              request->getHeader("accept-encoding").find("br"));
+    EXPECT_LT(request->body().size(), 10000);
+
+    std::string decoded(20000, '\0');
+    auto size = decoded.size();
+    ASSERT_EQ(BROTLI_DECODER_RESULT_SUCCESS,
+              BrotliDecoderDecompress(
+                  request->body().size(),
+                  reinterpret_cast<const uint8_t *>(request->body().data()),
+                  &size,
+                  reinterpret_cast<uint8_t *>(decoded.data())));
+    decoded.resize(size);
+    Json::Value json;
+    ASSERT_TRUE(tl::rest::BodyCodec::get("json")->decode(decoded, json));
+    EXPECT_EQ(std::string(10000, 'x'), json["data"].asString());
+}
+#endif
+
+TEST(ReloadTest, All)
+{
+    using namespace tl::rest;
+    MuelsyseTest muelsyse;
+    muelsyse.initAndStart(drogon::app().getCustomConfig());
+    muelsyse.prepare("testCompression", {"text", std::string(1024, 'a')});
+    auto requestBytes =
+        muelsyse.getStats("testCompression")["request_bytes"].asUInt64();
+
+    Json::Value config;
+    config["function_list"][0]["name"] = "testCompression";
+    config["function_list"][0]["url"] = "http://localhost:8001/moved";
+    config["function_list"][0]["http_method"] = "put";
+    muelsyse.reload(config);
+
+    auto [client, request] = muelsyse.prepare("testCompression");
+    EXPECT_STREQ("/moved", request->path().c_str());
+    EXPECT_EQ(drogon::Put, request->method());
+    EXPECT_EQ(8001, client->port());
+    EXPECT_THROW(muelsyse.prepare("test"), std::invalid_argument);
+    // Counters survive the reload
+    EXPECT_EQ(requestBytes,
+              muelsyse.getStats("testCompression")["request_bytes"].asUInt64());
+
+    // Registered at once, and kept by a reload without function_list
+    std::vector<MuelsyseTest::Registration> functions;
+    functions.push_back({"registered1", "http://localhost:8000/one", {}});
+    functions.push_back({"registered2", "http://localhost:8000/two", {}});
+    muelsyse.registerRest(std::move(functions));
+    muelsyse.reload(Json::Value(Json::objectValue));
+    EXPECT_STREQ("/moved",
+                 std::get<1>(muelsyse.prepare("testCompression"))->path()
+                     .c_str());
+    EXPECT_STREQ("/two",
+                 std::get<1>(muelsyse.prepare("registered2"))->path().c_str());
+
+    // An invalid item leaves the current functions untouched
+    config["function_list"][1]["name"] = "invalid";
+    config["function_list"][1]["url"] = "http://localhost:8000/";
+    config["function_list"][1]["http_method"] = "head";
+    EXPECT_THROW(muelsyse.reload(config), std::invalid_argument);
+    EXPECT_NO_THROW(muelsyse.prepare("testCompression"));
+}
+
+TEST(ReloadTest, Instances)
+{
+    // Instances used in turn on one thread each see their own functions
+    auto configOf = [](const std::string &path) {
+        Json::Value config;
+        config["function_list"][0]["name"] = "shared";
+        config["function_list"][0]["url"] = "http://localhost:8000" + path;
+        config["function_list"][0]["http_method"] = "get";
+        return config;
+    };
+    MuelsyseTest first;
+    first.initAndStart(configOf("/first"));
+    MuelsyseTest second;
+    second.initAndStart(configOf("/second"));
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_STREQ("/first",
+                     std::get<1>(first.prepare("shared"))->path().c_str());
+        EXPECT_STREQ("/second",
+                     std::get<1>(second.prepare("shared"))->path().c_str());
+    }
+    second.reload(configOf("/reloaded"));
+    EXPECT_STREQ("/first",
+                 std::get<1>(first.prepare("shared"))->path().c_str());
+    EXPECT_STREQ("/reloaded",
+                 std::get<1>(second.prepare("shared"))->path().c_str());
+}
+
+TEST(ReloadTest, WatchFile)
+{
+    using namespace std::chrono_literals;
+    auto path = std::filesystem::temp_directory_path() / "muelsyse_watch.json";
+    auto writeFunctions = [&path](const std::string &url) {
+        std::ofstream out(path);
+        out << R"({"function_list": [{"name": "watched", "url": ")" << url
+            << R"(", "http_method": "get"}]})";
+    };
+    writeFunctions("http://localhost:8000/before");
+
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["function_list"][0]["name"] = "watched";
+    config["function_list"][0]["url"] = "http://localhost:8000/before";
+    config["function_list"][0]["http_method"] = "get";
+    config["watch_file"] = path.string();
+    config["watch_interval"] = 0.1;
+    muelsyse.initAndStart(config);
+
+    std::this_thread::sleep_for(50ms);
+    writeFunctions("http://localhost:8000/after");
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now() + 1s);
+    std::string requestPath;
+    for (int i = 0; i < 50 && requestPath != "/after"; ++i)
+    {
+        std::this_thread::sleep_for(100ms);
+        requestPath = std::get<1>(muelsyse.prepare("watched"))->path();
+    }
+    EXPECT_EQ("/after", requestPath);
+    muelsyse.shutdown();
+
+    // Not reloaded any more
+    writeFunctions("http://localhost:8000/late");
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now() + 2s);
+    std::this_thread::sleep_for(300ms);
+    EXPECT_EQ("/after", std::get<1>(muelsyse.prepare("watched"))->path());
+    std::filesystem::remove(path);
+}
+
+TEST(PrewarmTest, All)
+{
+    using namespace std::chrono_literals;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["connections_per_host"] = 2;
+    config["prewarm"]["timeout"] = 3;
+    config["function_list"][0]["name"] = "warm";
+    config["function_list"][0]["url"] = "http://localhost:8000/test";
+    config["function_list"][0]["http_method"] = "post";
+    muelsyse.initAndStart(config);
+
+    std::promise<void> ready;
+    muelsyse.onReady([&ready]() { ready.set_value(); });
+    ASSERT_EQ(std::future_status::ready, ready.get_future().wait_for(5s));
+    EXPECT_TRUE(muelsyse.isReady());
+
+    // Calls take turns on the warmed connections
+    auto first = std::get<0>(muelsyse.prepare("warm"));
+    auto second = std::get<0>(muelsyse.prepare("warm"));
+    EXPECT_NE(first, second);
+    EXPECT_EQ(first, std::get<0>(muelsyse.prepare("warm")));
+}
+
+TEST(PriorityTest, All)
+{
+    using namespace std::chrono_literals;
+    using tl::rest::CallScope;
+    using tl::rest::Priority;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["max_concurrency_per_host"] = 1;
+    config["function_list"][0]["name"] = "batch";
+    config["function_list"][0]["url"] = "http://localhost:8000/test";
+    config["function_list"][0]["http_method"] = "post";
+    config["function_list"][0]["priority"] = "low";
+    config["function_list"][1]["name"] = "lookup";
+    config["function_list"][1]["url"] = "http://localhost:8000/test";
+    config["function_list"][1]["http_method"] = "post";
+    muelsyse.initAndStart(config);
+
+    auto call = muelsyse.prepareCall("batch");
+    ASSERT_NE(nullptr, call.scheduler);
+    EXPECT_EQ(Priority::Low, call.priority);
+    EXPECT_EQ(Priority::Normal, muelsyse.prepareCall("lookup").priority);
+    {
+        CallScope outer({.priority = Priority::High});
+        CallScope inner({});
+        EXPECT_EQ(Priority::High, muelsyse.prepareCall("batch").priority);
+    }
+    EXPECT_EQ(Priority::Low, muelsyse.prepareCall("batch").priority);
+
+    // The calls beyond the limit wait their turn
+    std::vector<std::future<Json::Value>> futures;
+    for (auto name : {"batch", "batch", "lookup"})
+    {
+        futures.push_back(muelsyse.restCallFuture<Json::Value>(name, {}));
+    }
+    for (auto &future : futures)
+    {
+        ASSERT_EQ(std::future_status::ready, future.wait_for(5s));
+        // The response of /test is not json
+        EXPECT_ANY_THROW(future.get());
+    }
+    EXPECT_EQ(0, muelsyse.getStats("lookup")["in_flight"].asUInt64());
+
+    config["function_list"][0]["priority"] = "urgent";
+    EXPECT_THROW(muelsyse.reload(config), std::invalid_argument);
+}
+
+TEST(PriorityTest, Order)
+{
+    using namespace std::chrono_literals;
+    using tl::rest::CallScheduler;
+    using tl::rest::Priority;
+    std::vector<std::string> started;
+    auto record = [&started](std::string name) {
+        return [&started, name]() { started.push_back(name); };
+    };
+
+    // One slot, taken by the first call, the others are ordered by priority
+    CallScheduler scheduler(1, 10s);
+    scheduler.submit(Priority::Low, record("running"));
+    scheduler.submit(Priority::Low, record("low1"));
+    scheduler.submit(Priority::Normal, record("normal"));
+    scheduler.submit(Priority::Low, record("low2"));
+    scheduler.submit(Priority::High, record("high"));
+    EXPECT_EQ(4, scheduler.queued());
+    while (scheduler.queued() > 0)
+    {
+        scheduler.release();
+    }
+    scheduler.release();
+    EXPECT_EQ(
+        (std::vector<std::string>{"running", "high", "normal", "low1", "low2"}),
+        started);
+    EXPECT_EQ(0, scheduler.inFlight());
+
+    // A call that has waited for maxWait goes ahead of higher priorities
+    started.clear();
+    CallScheduler fair(1, 50ms);
+    fair.submit(Priority::High, record("running"));
+    fair.submit(Priority::Low, record("low"));
+    std::this_thread::sleep_for(100ms);
+    fair.submit(Priority::High, record("high"));
+    fair.release();
+    fair.release();
+    EXPECT_EQ((std::vector<std::string>{"running", "low", "high"}), started);
+}
+
+TEST(DeadlineTest, All)
+{
+    using namespace std::chrono_literals;
+    using tl::rest::CallScope;
+    using Clock = std::chrono::steady_clock;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["function_list"][0]["name"] = "headers";
+    config["function_list"][0]["url"] = "http://localhost:8000/headers";
+    config["function_list"][0]["http_method"] = "get";
+    muelsyse.initAndStart(config);
+
+    {
+        CallScope scope({.deadline = Clock::now() + 5s});
+        auto headers = muelsyse.restCallSync<Json::Value>("headers", {});
+        auto left = std::stoll(headers["x-request-timeout-ms"].asString());
+        EXPECT_GT(left, 0);
+        EXPECT_LE(left, 5000);
+
+        // A nested scope cannot extend the deadline
+        CallScope inner({.deadline = Clock::now() + 1h});
+        EXPECT_LE(*CallScope::current()->deadline, Clock::now() + 5s);
+    }
+    EXPECT_EQ(nullptr, CallScope::current());
+
+    CallScope expired({.deadline = Clock::now() - 1ms});
+    EXPECT_THROW(muelsyse.prepareCall("headers"), tl::rest::DeadlineExceeded);
+    auto result = muelsyse.restCallExpected<Json::Value>("headers", {});
+    ASSERT_FALSE(result);
+    EXPECT_EQ(drogon::ReqResult::Timeout, result.error().result);
+}
+
+TEST(DeadlineTest, Filter)
+{
+    using tl::rest::CallScope;
+    tl::rest::DeadlineFilter filter;
+    auto req = drogon::HttpRequest::newHttpRequest();
+    req->addHeader("X-Request-Timeout-Ms", "200");
+    bool handled = false;
+    filter.doFilter(
+        req,
+        [](const drogon::HttpResponsePtr &) { FAIL(); },
+        [&handled, &req]() {
+            handled = true;
+            ASSERT_NE(nullptr, CallScope::current());
+            auto left = *CallScope::current()->deadline -
+                        std::chrono::steady_clock::now();
+            EXPECT_LE(left, std::chrono::milliseconds(200));
+            EXPECT_TRUE(tl::rest::DeadlineFilter::optionsOf(req).deadline);
+        });
+    EXPECT_TRUE(handled);
+    EXPECT_EQ(nullptr, CallScope::current());
+
+    // No time left
+    req->addHeader("X-Request-Timeout-Ms", "0");
+    drogon::HttpStatusCode status = drogon::kUnknown;
+    filter.doFilter(
+        req,
+        [&status](const drogon::HttpResponsePtr &resp) {
+            status = resp->statusCode();
+        },
+        []() { FAIL(); });
+    EXPECT_EQ(drogon::k504GatewayTimeout, status);
+}
+
+TEST(CancelTest, All)
+{
+    using namespace std::chrono_literals;
+    using tl::rest::CallCancelled;
+    using tl::rest::CallScope;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["max_concurrency_per_host"] = 1;
+    config["function_list"][0]["name"] = "slow";
+    config["function_list"][0]["url"] = "http://localhost:8000/slow";
+    config["function_list"][0]["http_method"] = "get";
+    muelsyse.initAndStart(config);
+
+    // One call in flight and one queued behind it, both are abandoned
+    tl::rest::CancelToken token;
+    std::vector<std::future<Json::Value>> futures;
+    {
+        CallScope scope({.cancelToken = token});
+        futures.push_back(muelsyse.restCallFuture<Json::Value>("slow", {}));
+        futures.push_back(muelsyse.restCallFuture<Json::Value>("slow", {}));
+    }
+    EXPECT_EQ(1, muelsyse.getStats("slow")["queued"].asUInt64());
+    token.cancel();
+    for (auto &future : futures)
+    {
+        ASSERT_EQ(std::future_status::ready, future.wait_for(100ms));
+        EXPECT_THROW(future.get(), CallCancelled);
+    }
+
+    CallScope scope({.cancelToken = token});
+    EXPECT_THROW(muelsyse.restCallSync<Json::Value>("slow", {}),
+                 CallCancelled);
+    auto result = muelsyse.restCallExpected<Json::Value>("slow", {});
+    ASSERT_FALSE(result);
+    EXPECT_TRUE(result.error().cancelled);
+    EXPECT_EQ(drogon::ReqResult::NetworkFailure, result.error().result);
+}
+
+TEST(InprocTest, All)
+{
+    using namespace drogon;
+    tl::rest::registerInprocHandler(
+        "echo",
+        [](const HttpRequestPtr &req,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            Json::Value json;
+            json["path"] = req->path();
+            json["body"] = *req->getJsonObject();
+            callback(HttpResponse::newHttpJsonResponse(json));
+        });
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["connections_per_host"] = 4;
+    config["function_list"][0]["name"] = "echo";
+    config["function_list"][0]["url"] = "inproc://echo/items/{id}";
+    config["function_list"][0]["http_method"] = "post";
+    config["function_list"][1]["name"] = "missing";
+    config["function_list"][1]["url"] = "inproc://missing/items";
+    config["function_list"][1]["http_method"] = "get";
+    muelsyse.initAndStart(config);
+
+    auto [client, request] = muelsyse.prepare("echo", {"_", 1});
+    EXPECT_STREQ("echo", client->host().c_str());
+    auto json = muelsyse.restCallSync<Json::Value>(
+        "echo", {"_", 1, "name", "Muelsyse"});
+    EXPECT_STREQ("/items/1", json["path"].asCString());
+    EXPECT_STREQ("Muelsyse", json["body"]["name"].asCString());
+
+    auto missing = muelsyse.restCallExpected<Json::Value>("missing", {});
+    ASSERT_FALSE(missing);
+    EXPECT_EQ(ReqResult::BadServerAddress, missing.error().result);
+    EXPECT_THROW(
+        muelsyse.restCallStream("echo", {"_", 1}, tl::rest::fdSink(1)),
+        std::invalid_argument);
+    tl::rest::removeInprocHandler("echo");
+}
+
+TEST(HostOptionsTest, All)
+{
+    using namespace std::chrono_literals;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["connections_per_host"] = 4;
+    config["hosts"]["localhost:8000"]["connections"] = 2;
+    config["function_list"][0]["name"] = "user";
+    config["function_list"][0]["url"] = "http://localhost:8000/user/{id}";
+    config["function_list"][0]["http_method"] = "get";
+    muelsyse.initAndStart(config);
+
+    std::vector<std::future<Json::Value>> futures;
+    for (int i = 0; i < 32; ++i)
+    {
+        futures.push_back(
+            muelsyse.restCallFuture<Json::Value>("user", {"_", 1}));
+    }
+    for (auto &future : futures)
+    {
+        ASSERT_EQ(std::future_status::ready, future.wait_for(5s));
+        EXPECT_EQ(1, future.get()["id"].asInt());
+    }
+
+    // 32 concurrent calls over the 2 connections of the host
+    auto stats = muelsyse.getStats("user");
+    EXPECT_STREQ("http/1.1", stats["protocol"].asCString());
+    EXPECT_LE(stats["connections"].asUInt64(), 2);
+    EXPECT_EQ(32, stats["calls"].asUInt64());
+    EXPECT_EQ(0, stats["failed_calls"].asUInt64());
+    EXPECT_GE(stats["latency_us_max"].asUInt64(),
+              stats["latency_us_avg"].asUInt64());
+
+    MuelsyseTest unsupported;
+    config["hosts"]["localhost:8000"]["protocol"] = "spdy";
+    EXPECT_THROW(unsupported.initAndStart(config), std::invalid_argument);
+}
+
+#ifdef MUELSYSE_WITH_NGHTTP2
+TEST(Http2Test, All)
+{
+    using namespace std::chrono_literals;
+    // The h2c server of the test server
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["hosts"]["localhost:8002"]["protocol"] = "h2";
+    config["function_list"][0]["name"] = "echo";
+    config["function_list"][0]["url"] = "http://localhost:8002/items/{id}";
+    config["function_list"][0]["http_method"] = "post";
+    muelsyse.initAndStart(config);
+
+    std::vector<std::future<Json::Value>> futures;
+    for (int i = 0; i < 32; ++i)
+    {
+        futures.push_back(muelsyse.restCallFuture<Json::Value>(
+            "echo", {"_", i, "name", "Muelsyse"}));
+    }
+    for (int i = 0; i < 32; ++i)
+    {
+        ASSERT_EQ(std::future_status::ready, futures[i].wait_for(5s));
+        auto json = futures[i].get();
+        EXPECT_STREQ("POST", json["method"].asCString());
+        EXPECT_EQ("/items/" + std::to_string(i), json["path"].asString());
+        EXPECT_STREQ("application/json", json["content_type"].asCString());
+        Json::Value body;
+        ASSERT_TRUE(Json::Reader().parse(json["body"].asString(), body));
+        EXPECT_STREQ("Muelsyse", body["name"].asCString());
+    }
+
+    // All of them multiplexed over the one connection of the host
+    auto stats = muelsyse.getStats("echo");
+    EXPECT_STREQ("h2", stats["protocol"].asCString());
+    EXPECT_EQ(1, stats["connections"].asUInt64());
+    EXPECT_EQ(32, stats["calls"].asUInt64());
+    EXPECT_EQ(0, stats["failed_calls"].asUInt64());
+
+    // The test server on 8000 only speaks HTTP/1.1
+    MuelsyseTest http1;
+    config["hosts"]["localhost:8000"]["protocol"] = "h2";
+    config["function_list"][0]["url"] = "http://localhost:8000/user/{id}";
+    config["function_list"][0]["http_method"] = "get";
+    http1.initAndStart(config);
+    auto failed = http1.restCallExpected<Json::Value>("echo", {"_", 1});
+    ASSERT_FALSE(failed);
+    EXPECT_EQ(drogon::ReqResult::NetworkFailure, failed.error().result);
+}
+
+TEST(Http2Test, SessionResumption)
+{
+    // The h2 server of the test server, over TLS
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["hosts"]["https://localhost:8444"]["protocol"] = "h2";
+    config["hosts"]["https://localhost:8444"]["connections"] = 2;
+    config["function_list"][0]["name"] = "echo";
+    config["function_list"][0]["url"] = "https://localhost:8444/items/{id}";
+    config["function_list"][0]["http_method"] = "get";
+    config["function_list"][0]["tls"]["validate_cert"] = false;
+    muelsyse.initAndStart(config);
+
+    // One after the other, on both connections: the second one resumes the
+    // session the first one was handed
+    for (int i = 0; i < 4; ++i)
+    {
+        auto json = muelsyse.restCallSync<Json::Value>("echo", {"_", i});
+        EXPECT_EQ("/items/" + std::to_string(i), json["path"].asString());
+    }
+    auto stats = muelsyse.getStats("echo");
+    EXPECT_EQ(2, stats["connections"].asUInt64());
+    EXPECT_EQ(1, stats["tls_handshakes"]["full"].asUInt64());
+    EXPECT_EQ(1, stats["tls_handshakes"]["resumed"].asUInt64());
+}
+#else
+TEST(Http2Test, NeedsBuildOption)
+{
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["hosts"]["localhost:8002"]["protocol"] = "h2";
+    EXPECT_THROW(muelsyse.initAndStart(config), std::invalid_argument);
+}
+#endif
+
+TEST(UnixSocketTest, All)
+{
+    using namespace std::chrono_literals;
+    const std::string host = "unix:///tmp/muelsyse-test.sock";
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["hosts"][host]["connections"] = 2;
+    config["function_list"][0]["name"] = "user";
+    config["function_list"][0]["url"] = host + ":/user/{id}";
+    config["function_list"][0]["http_method"] = "get";
+    config["function_list"][1]["name"] = "export";
+    config["function_list"][1]["url"] = host + ":/export?rows={rows}";
+    config["function_list"][1]["http_method"] = "get";
+    config["function_list"][2]["name"] = "missing";
+    config["function_list"][2]["url"] =
+        "unix:///tmp/muelsyse-missing.sock:/test";
+    config["function_list"][2]["http_method"] = "post";
+    muelsyse.initAndStart(config);
+
+    auto [client, request] = muelsyse.prepare("user", {"_", 1});
+    EXPECT_STREQ("/tmp/muelsyse-test.sock", client->host().c_str());
+    EXPECT_STREQ("/user/1", request->path().c_str());
+
+    auto json = muelsyse.restCallSync<Json::Value>("user", {"_", 1});
+    EXPECT_EQ(1, json["id"].asInt());
+    std::vector<std::future<Json::Value>> futures;
+    for (int i = 0; i < 16; ++i)
+    {
+        futures.push_back(
+            muelsyse.restCallFuture<Json::Value>("user", {"_", 1}));
+    }
+    for (auto &future : futures)
+    {
+        ASSERT_EQ(std::future_status::ready, future.wait_for(5s));
+        EXPECT_EQ(1, future.get()["id"].asInt());
+    }
+    // The connections are kept alive between the calls
+    EXPECT_LE(muelsyse.getStats("user")["connections"].asUInt64(), 2);
+
+    // The exchanges block worker threads, not the loops of the callbacks
+    std::promise<bool> onLoop;
+    auto loop = client->getLoop();
+    client->sendRequest(
+        request,
+        [&onLoop, loop](drogon::ReqResult, const drogon::HttpResponsePtr &) {
+            onLoop.set_value(loop->isInLoopThread());
+        });
+    EXPECT_TRUE(onLoop.get_future().get());
+
+    // Only a connection that ends before the response is sent to again
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    tl::rest::HttpStream closed(fds[0], {});
+    close(fds[1]);
+    EXPECT_THROW(closed.readHead(), tl::rest::StreamClosed);
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    tl::rest::HttpStream cut(fds[0], {});
+    ASSERT_EQ(4, write(fds[1], "HTTP", 4));
+    close(fds[1]);
+    bool closedEarly = false;
+    try
+    {
+        cut.readHead();
+    }
+    catch (const tl::rest::StreamClosed &)
+    {
+        closedEarly = true;
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+    EXPECT_FALSE(closedEarly);
+
+    int rows = 0;
+    muelsyse.restCallStream("export",
+                            {"_", 100},
+                            tl::rest::jsonArraySink([&rows](Json::Value &&) {
+                                ++rows;
+                                return true;
+                            }));
+    EXPECT_EQ(100, rows);
+
+    auto missing = muelsyse.restCallExpected<Json::Value>("missing", {});
+    ASSERT_FALSE(missing);
+    EXPECT_EQ(drogon::ReqResult::NetworkFailure, missing.error().result);
+}
+
+TEST(PrepareTest, Template)
+{
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["function_list"][0]["name"] = "item";
+    config["function_list"][0]["url"] =
+        "http://localhost:8000/users/{user}/items/{item}";
+    config["function_list"][0]["http_method"] = "get";
+    config["function_list"][0]["codec"] = "msgpack";
+    config["function_list"][1]["name"] = "anyHost";
+    config["function_list"][1]["url"] = "http://{host}/test";
+    config["function_list"][1]["http_method"] = "post";
+    muelsyse.initAndStart(config);
+
+    auto [client, request] = muelsyse.prepare("item", {"_", 1, "_", "a"});
+    EXPECT_STREQ("/users/1/items/a", request->path().c_str());
+    EXPECT_STREQ("application/msgpack", request->getHeader("accept").c_str());
+    // Placeholders without an argument are kept
+    auto [sameClient, partial] = muelsyse.prepare("item", {"_", 1});
+    EXPECT_STREQ("/users/1/items/{item}", partial->path().c_str());
+    EXPECT_THROW(muelsyse.prepare("item", {"_", 1, "_", 2, "_", 3}),
+                 std::invalid_argument);
+
+    auto [hostClient, hostRequest] =
+        muelsyse.prepare("anyHost", {"_", "localhost:8000"});
+    EXPECT_EQ(8000, hostClient->port());
+    EXPECT_STREQ("/test", hostRequest->path().c_str());
+}
+
+TEST(OutboxTest, All)
+{
+    using namespace std::chrono_literals;
+    const std::string path = "/tmp/muelsyse-test.outbox";
+    std::filesystem::remove(path);
+    Json::Value config;
+    config["outbox"]["path"] = path;
+    config["outbox"]["retry_interval"] = 0.1;
+    config["function_list"][0]["name"] = "notify";
+    config["function_list"][0]["url"] = "http://localhost:8000/test";
+    config["function_list"][0]["http_method"] = "post";
+    config["function_list"][0]["delivery"] = "outbox";
+    config["function_list"][1]["name"] = "notifyDown";
+    config["function_list"][1]["url"] = "http://localhost:1/test";
+    config["function_list"][1]["http_method"] = "post";
+    config["function_list"][1]["delivery"] = "outbox";
+    // The shadow host has no token yet, a prepared shadow would be dropped
+    config["function_list"][0]["shadow"]["url"] = "http://127.0.0.1:8000/test";
+    config["function_list"][0]["shadow"]["sample_rate"] = 1;
+    config["function_list"][2]["name"] = "slow";
+    config["function_list"][2]["url"] = "http://localhost:8000/slow";
+    config["function_list"][2]["http_method"] = "get";
+    auto &auth = config["hosts"]["http://127.0.0.1:8000"]["auth"];
+    auth["token_function"] = "slow";
+    auth["timeout"] = 0.2;
+    {
+        MuelsyseTest muelsyse;
+        muelsyse.initAndStart(config);
+        // Completed as soon as the request is queued
+        auto future =
+            muelsyse.restCallFuture<void>("notify", {"name", "Muelsyse"});
+        ASSERT_EQ(std::future_status::ready, future.wait_for(0s));
+        EXPECT_NO_THROW(future.get());
+        // Queued calls are not shadowed
+        auto shadow = muelsyse.getStats("notify")["shadow"];
+        EXPECT_EQ(0, shadow["calls"].asUInt64());
+        EXPECT_EQ(0, shadow["dropped"].asUInt64());
+        for (int i = 0; i < 50 && muelsyse.outboxSize() > 0; ++i)
+        {
+            std::this_thread::sleep_for(100ms);
+        }
+        EXPECT_EQ(0, muelsyse.outboxSize());
+
+        muelsyse.restCallFuture<void>("notifyDown", {"name", "Muelsyse"})
+            .get();
+        // A host that is down does not hold back the others
+        muelsyse.restCallFuture<void>("notify", {"name", "Muelsyse"}).get();
+        for (int i = 0; i < 50 && muelsyse.outboxSize() > 1; ++i)
+        {
+            std::this_thread::sleep_for(100ms);
+        }
+        std::this_thread::sleep_for(300ms);
+        EXPECT_EQ(1, muelsyse.outboxSize());
+        muelsyse.shutdown();
+    }
+    {
+        // Still there after a restart
+        MuelsyseTest muelsyse;
+        muelsyse.initAndStart(config);
+        EXPECT_EQ(1, muelsyse.outboxSize());
+        muelsyse.shutdown();
+    }
+    config.removeMember("outbox");
+    MuelsyseTest muelsyse;
+    EXPECT_THROW(muelsyse.initAndStart(config), std::invalid_argument);
+    std::filesystem::remove(path);
+}
+
+TEST(TokenCacheTest, All)
+{
+    using namespace std::chrono_literals;
+    using Token = tl::rest::TokenCache::Token;
+    tl::rest::TokenCache cache;
+    EXPECT_THROW(cache.get("missing", 0ms), std::runtime_error);
+
+    // Waiting callbacks are called once the fetch completes
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    cache.add(
+        "host",
+        [released]() {
+            released.wait();
+            return Token{"token-1", 0};
+        },
+        30);
+    EXPECT_EQ(std::nullopt, cache.tryGet("host"));
+    std::promise<std::string> waited;
+    cache.get("host", 5s, [&waited](std::string token, std::string error) {
+        waited.set_value(token);
+    });
+    std::string error;
+    cache.get("host", 0ms, [&error](std::string token, std::string e) {
+        error = e;
+    });
+    EXPECT_EQ("no valid token for host", error);
+    auto waitedFuture = waited.get_future();
+    EXPECT_EQ(std::future_status::timeout, waitedFuture.wait_for(0ms));
+    release.set_value();
+    ASSERT_EQ(std::future_status::ready, waitedFuture.wait_for(5s));
+    EXPECT_EQ("token-1", waitedFuture.get());
+    EXPECT_EQ("token-1", cache.get("host", 0ms));
+
+    // Refreshed before it expires, after half of its lifetime when that is
+    // shorter than skew
+    std::promise<void> refreshed;
+    std::atomic<int> fetches{0};
+    cache.add(
+        "short",
+        [&refreshed, &fetches]() {
+            if (++fetches == 1)
+            {
+                return Token{"short-1", 0.2};
+            }
+            refreshed.set_value();
+            return Token{"short-2", 0};
+        },
+        30);
+    EXPECT_EQ(std::future_status::ready,
+              refreshed.get_future().wait_for(5s));
+
+    // A removed key fails its waiting callbacks
+    std::promise<void> never;
+    auto gate = never.get_future().share();
+    cache.add(
+        "removed",
+        [gate]() {
+            gate.wait();
+            return Token{"late", 0};
+        },
+        30);
+    std::string removedError;
+    cache.get("removed",
+              5s,
+              [&removedError](std::string token, std::string error) {
+                  removedError = error;
+              });
+    cache.remove("removed");
+    EXPECT_EQ("no token is configured for removed", removedError);
+    never.set_value();
+}
+
+TEST(AuthTest, All)
+{
+    using namespace std::chrono_literals;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    auto &auth = config["hosts"]["http://127.0.0.1:8000"]["auth"];
+    auth["token_function"] = "token";
+    auth["args"]["client_id"] = "muelsyse";
+    auth["skew"] = 1;
+    config["function_list"][0]["name"] = "token";
+    config["function_list"][0]["url"] = "http://localhost:8000/token";
+    config["function_list"][0]["http_method"] = "post";
+    config["function_list"][1]["name"] = "headers";
+    config["function_list"][1]["url"] = "http://127.0.0.1:8000/headers";
+    config["function_list"][1]["http_method"] = "get";
+    config["function_list"][2]["name"] = "slow";
+    config["function_list"][2]["url"] = "http://localhost:8000/slow";
+    config["function_list"][2]["http_method"] = "get";
+    muelsyse.initAndStart(config);
+
+    // The calls share one token, fetched once
+    std::vector<std::future<Json::Value>> futures;
+    for (int i = 0; i < 8; ++i)
+    {
+        futures.push_back(muelsyse.restCallFuture<Json::Value>("headers", {}));
+    }
+    std::string token;
+    for (auto &future : futures)
+    {
+        ASSERT_EQ(std::future_status::ready, future.wait_for(5s));
+        auto authorization = future.get()["authorization"].asString();
+        EXPECT_TRUE(authorization.starts_with("Bearer token-"));
+        if (token.empty())
+        {
+            token = authorization;
+        }
+        EXPECT_EQ(token, authorization);
+    }
+
+    // A changed auth item gets a token of its own
+    auth["args"]["scope"] = "orders";
+    muelsyse.reload(config);
+    auto headers = muelsyse.restCallSync<Json::Value>("headers", {});
+    EXPECT_TRUE(headers["authorization"].asString().starts_with("Bearer "));
+    EXPECT_NE(token, headers["authorization"].asString());
+    // Without hosts the auth items are kept, a host without auth drops its
+    // own
+    auto withoutHosts = config;
+    withoutHosts.removeMember("hosts");
+    muelsyse.reload(withoutHosts);
+    headers = muelsyse.restCallSync<Json::Value>("headers", {});
+    EXPECT_TRUE(headers.isMember("authorization"));
+    auto withoutAuth = config;
+    withoutAuth["hosts"] = Json::objectValue;
+    muelsyse.reload(withoutAuth);
+    headers = muelsyse.restCallSync<Json::Value>("headers", {});
+    EXPECT_FALSE(headers.isMember("authorization"));
+    // Rejected as a whole
+    auto unknown = config;
+    unknown["hosts"]["http://127.0.0.1:8000"]["auth"]["token_function"] =
+        "missing";
+    EXPECT_THROW(muelsyse.reload(unknown), std::invalid_argument);
+    headers = muelsyse.restCallSync<Json::Value>("headers", {});
+    EXPECT_FALSE(headers.isMember("authorization"));
+    muelsyse.shutdown();
+
+    // An asynchronous call returns at once and fails once no token came in
+    // time, even on a loop
+    auth["token_function"] = "slow";
+    auth["timeout"] = 0.2;
+    MuelsyseTest noToken;
+    noToken.initAndStart(config);
+    trantor::EventLoopThread caller("caller");
+    caller.run();
+    std::atomic<bool> returned{false};
+    std::promise<bool> failed;
+    caller.getLoop()->queueInLoop([&noToken, &returned, &failed]() {
+        noToken.restCallAsync<Json::Value>(
+            "headers",
+            {},
+            [&failed](Json::Value) { failed.set_value(false); },
+            [&returned, &failed](const std::exception &) {
+                failed.set_value(returned);
+            });
+        returned = true;
+    });
+    auto failedFuture = failed.get_future();
+    ASSERT_EQ(std::future_status::ready, failedFuture.wait_for(5s));
+    EXPECT_TRUE(failedFuture.get());
+    noToken.shutdown();
+
+    // Its calls would wait for their own token
+    auth["token_function"] = "token";
+    config["function_list"][0]["url"] = "http://127.0.0.1:8000/token";
+    MuelsyseTest sameHost;
+    EXPECT_THROW(sameHost.initAndStart(config), std::invalid_argument);
+    auth["token_function"] = "missing";
+    MuelsyseTest missing;
+    EXPECT_THROW(missing.initAndStart(config), std::invalid_argument);
+}
+
+TEST(CallbackExecutorTest, All)
+{
+    using namespace std::chrono_literals;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["callback_executor"] = "caller";
+    config["function_list"][0]["name"] = "user";
+    config["function_list"][0]["url"] = "http://localhost:8000/user/{id}";
+    config["function_list"][0]["http_method"] = "get";
+    config["function_list"][1]["name"] = "slow";
+    config["function_list"][1]["url"] = "http://localhost:8000/slow";
+    config["function_list"][1]["http_method"] = "get";
+    muelsyse.initAndStart(config);
+
+    // Back on the loop that made the call
+    trantor::EventLoopThread caller("caller");
+    caller.run();
+    auto loop = caller.getLoop();
+    std::promise<bool> inCaller;
+    loop->queueInLoop([&muelsyse, &inCaller, loop]() {
+        muelsyse.restCallAsync<Json::Value>(
+            "user", {"_", 1}, [&inCaller, loop](Json::Value) {
+                inCaller.set_value(loop->isInLoopThread());
+            });
+    });
+    auto inCallerFuture = inCaller.get_future();
+    ASSERT_EQ(std::future_status::ready, inCallerFuture.wait_for(5s));
+    EXPECT_TRUE(inCallerFuture.get());
+
+    // A loop that has quit does not get the callback, it runs where the
+    // response arrives
+    std::promise<void> afterQuit;
+    {
+        trantor::EventLoopThread quitting("quitting");
+        quitting.run();
+        std::promise<void> sent;
+        quitting.getLoop()->queueInLoop([&muelsyse, &afterQuit, &sent]() {
+            muelsyse.restCallAsync<Json::Value>(
+                "slow", {}, [&afterQuit](Json::Value) {
+                    afterQuit.set_value();
+                });
+            sent.set_value();
+        });
+        sent.get_future().wait();
+    }
+    EXPECT_EQ(std::future_status::ready,
+              afterQuit.get_future().wait_for(5s));
+
+    std::atomic<int> executed{0};
+    tl::rest::CallScope scope({.executor = tl::rest::CallbackExecutor::custom(
+                                   [&executed](std::function<void()> &&task) {
+                                       ++executed;
+                                       task();
+                                   })});
+    std::promise<int> user;
+    muelsyse.restCallAsync<Json::Value>(
+        "user", {"_", 1}, [&user](Json::Value json) {
+            user.set_value(json["id"].asInt());
+        });
+    auto userFuture = user.get_future();
+    ASSERT_EQ(std::future_status::ready, userFuture.wait_for(5s));
+    EXPECT_EQ(1, userFuture.get());
+    EXPECT_EQ(1, executed);
+    // Futures are completed where the response arrives
+    EXPECT_EQ(1,
+              muelsyse.restCallFuture<Json::Value>("user", {"_", 1})
+                  .get()["id"]
+                  .asInt());
+    EXPECT_EQ(1, executed);
+
+    // An executor may drop a task, the callback is then freed unrun
+    std::promise<void> dropped;
+    auto callbackState = std::make_shared<int>(0);
+    {
+        tl::rest::CallScope dropping(
+            {.executor = tl::rest::CallbackExecutor::custom(
+                 [&dropped](std::function<void()> &&task) {
+                     task = nullptr;
+                     dropped.set_value();
+                 })});
+        muelsyse.restCallAsync<Json::Value>(
+            "user", {"_", 1}, [callbackState](Json::Value) {
+                ++*callbackState;
+            });
+    }
+    auto droppedFuture = dropped.get_future();
+    ASSERT_EQ(std::future_status::ready, droppedFuture.wait_for(5s));
+    EXPECT_EQ(0, *callbackState);
+    EXPECT_EQ(1, callbackState.use_count());
+
+    config["callback_executor"] = "anywhere";
+    MuelsyseTest invalid;
+    EXPECT_THROW(invalid.initAndStart(config), std::invalid_argument);
+}
+
+TEST(NameTableTest, All)
+{
+    std::vector<std::pair<std::string, int>> items;
+    for (int i = 0; i < 1000; ++i)
+    {
+        items.emplace_back("function" + std::to_string(i), i);
+    }
+    items.emplace_back("function7", -7);
+    tl::rest::NameTable<int> table(std::move(items));
+    EXPECT_EQ(1000, table.size());
+    ASSERT_NE(nullptr, table.find("function999"));
+    EXPECT_EQ(999, *table.find("function999"));
+    // The last one wins, in the place of the first one
+    EXPECT_EQ(-7, *table.find("function7"));
+    EXPECT_EQ("function7", (table.begin() + 7)->name);
+    EXPECT_EQ(nullptr, table.find("function1000"));
+    EXPECT_EQ(nullptr, tl::rest::NameTable<int>().find("function0"));
+}
+
+TEST(ShadowTest, All)
+{
+    using namespace std::chrono_literals;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    auto addFunction = [&config](const std::string &name,
+                                 const std::string &shadowUrl) {
+        auto &function = config["function_list"].append(Json::objectValue);
+        function["name"] = name;
+        function["url"] = "http://localhost:8000/user/{id}";
+        function["http_method"] = "get";
+        function["shadow"]["url"] = shadowUrl;
+        function["shadow"]["sample_rate"] = 1;
+    };
+    addFunction("same", "http://127.0.0.1:8000/user/{id}");
+    addFunction("moved", "http://127.0.0.1:8000/users/{id}");
+    addFunction("changed", "http://127.0.0.1:8000/export?rows={id}");
+    addFunction("full", "http://127.0.0.1:8000/user/{id}");
+    config["function_list"][3]["shadow"]["max_in_flight"] = 0;
+    muelsyse.initAndStart(config);
+
+    // The call is answered by its own upstream whatever the shadow returns
+    for (const auto &name : {"same", "moved", "changed", "full"})
+    {
+        auto user = muelsyse.restCallSync<Json::Value>(name, {"_", 1});
+        EXPECT_EQ(1, user["id"].asInt());
+    }
+    muelsyse.restCallFuture<Json::Value>("same", {"_", 1}).wait();
+
+    // The shadow calls and their comparisons finish after the calls
+    auto shadowOf = [&muelsyse](const std::string &name) {
+        for (int i = 0; i < 50; ++i)
+        {
+            auto shadow = muelsyse.getStats(name)["shadow"];
+            if (shadow["calls"].asUInt64() > 0 &&
+                shadow["in_flight"].asUInt64() == 0)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(100ms);
+        }
+        std::this_thread::sleep_for(100ms);
+        return muelsyse.getStats(name)["shadow"];
+    };
+    auto same = shadowOf("same");
+    EXPECT_EQ(2, same["calls"].asUInt64());
+    EXPECT_EQ(0, same["failed_calls"].asUInt64());
+    EXPECT_EQ(0, same["status_diffs"].asUInt64());
+    EXPECT_EQ(0, same["body_diffs"].asUInt64());
+    auto moved = shadowOf("moved");
+    EXPECT_EQ(1, moved["calls"].asUInt64());
+    EXPECT_EQ(1, moved["status_diffs"].asUInt64());
+    auto changed = shadowOf("changed");
+    EXPECT_EQ(1, changed["calls"].asUInt64());
+    EXPECT_EQ(0, changed["status_diffs"].asUInt64());
+    EXPECT_EQ(1, changed["body_diffs"].asUInt64());
+    auto full = muelsyse.getStats("full")["shadow"];
+    EXPECT_EQ(0, full["calls"].asUInt64());
+    EXPECT_EQ(1, full["dropped"].asUInt64());
+
+    config["function_list"][0]["shadow"]["sample_rate"] = 2;
+    MuelsyseTest badRate;
+    EXPECT_THROW(badRate.initAndStart(config), std::invalid_argument);
+}
+
+TEST(PaginationTest, All)
+{
+    using namespace std::chrono_literals;
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    Json::Value pagination;
+    pagination["cursor"] = "cursor";
+    pagination["next_cursor"] = "meta.next_cursor";
+    pagination["items"] = "data";
+    auto &query = config["function_list"][0];
+    query["name"] = "listUsers";
+    query["url"] =
+        "http://localhost:8000/users/page?size={size}&cursor={cursor}";
+    query["http_method"] = "get";
+    query["pagination"] = pagination;
+    query["pagination"]["prefetch"] = 2;
+    auto &body = config["function_list"][1];
+    body["name"] = "postUsers";
+    body["url"] = "http://localhost:8000/users/page";
+    body["http_method"] = "post";
+    body["pagination"] = pagination;
+    body["pagination"]["prefetch"] = 0;
+    auto &broken = config["function_list"][2];
+    broken["name"] = "headers";
+    broken["url"] = "http://localhost:8000/headers";
+    broken["http_method"] = "get";
+    broken["pagination"] = pagination;
+    config["function_list"][3]["name"] = "user";
+    config["function_list"][3]["url"] = "http://localhost:8000/user/{id}";
+    config["function_list"][3]["http_method"] = "get";
+    muelsyse.initAndStart(config);
+
+    auto collect = [](tl::rest::PageStream &pages) {
+        std::vector<std::vector<int>> ids;
+        while (auto page = pages.next().get())
+        {
+            auto &last = ids.emplace_back();
+            for (const auto &user : *page)
+            {
+                last.push_back(user["id"].asInt());
+            }
+        }
+        return ids;
+    };
+    const std::vector<std::vector<int>> expected{{0, 1}, {2, 3}, {4}};
+
+    // The cursor fills its placeholder in the url, the pages come in order
+    {
+        auto pages = muelsyse.restCallPages("listUsers", {"_", 2});
+        auto first = pages.next().get();
+        ASSERT_TRUE(first.has_value());
+        EXPECT_EQ(2, first->size());
+        // The rest is fetched meanwhile
+        std::this_thread::sleep_for(500ms);
+        EXPECT_EQ(3, muelsyse.getStats("listUsers")["calls"].asUInt64());
+        auto rest = collect(pages);
+        EXPECT_EQ(std::vector<std::vector<int>>(expected.begin() + 1,
+                                                expected.end()),
+                  rest);
+        EXPECT_FALSE(pages.next().get().has_value());
+    }
+
+    // Or goes in the body, a page at a time without prefetch
+    {
+        auto pages = muelsyse.restCallPages("postUsers", {"size", 2});
+        ASSERT_TRUE(pages.next().get().has_value());
+        std::this_thread::sleep_for(200ms);
+        EXPECT_EQ(1, muelsyse.getStats("postUsers")["calls"].asUInt64());
+    }
+    auto pages = muelsyse.restCallPages("postUsers", {"size", 2});
+    EXPECT_EQ(expected, collect(pages));
+
+    auto noPages = muelsyse.restCallPages("headers");
+    EXPECT_THROW(noPages.next().get(), std::runtime_error);
+    EXPECT_THROW(muelsyse.restCallPages("user", {"_", 1}),
+                 std::invalid_argument);
+    EXPECT_THROW(muelsyse.restCallPages("missing"), std::invalid_argument);
+}
+
+TEST(DnsTest, Resolve)
+{
+    using tl::rest::DnsCache;
+    EXPECT_FALSE(DnsCache::resolve("localhost", 8000, true).empty());
+    EXPECT_TRUE(DnsCache::resolve("muelsyse.invalid", 8000, true).empty());
+
+    // The server only listens on IPv4, ::1 if localhost has it loses the
+    // race and goes last in the next one
+    DnsCache::Rtts rtts;
+    EXPECT_EQ("127.0.0.1", DnsCache::resolve("localhost", 8000, true, &rtts));
+    if (rtts.count("::1") > 0)
+    {
+        EXPECT_EQ(std::chrono::microseconds::max(), rtts["::1"]);
+        EXPECT_LT(rtts["127.0.0.1"], std::chrono::microseconds::max());
+    }
+    EXPECT_EQ("127.0.0.1", DnsCache::resolve("localhost", 8000, true, &rtts));
+}
+
+TEST(DnsTest, StaticHosts)
+{
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["dns"]["ttl"] = 30;
+    config["dns"]["hosts"]["muelsyse.test"] = "127.0.0.1";
+    config["function_list"][0]["name"] = "pinned";
+    config["function_list"][0]["url"] = "http://muelsyse.test:8000/test";
+    config["function_list"][0]["http_method"] = "post";
+    muelsyse.initAndStart(config);
+
+    // The connection goes to the pinned address, the host name is kept
+    auto [client, request] = muelsyse.prepare("pinned");
+    EXPECT_STREQ("127.0.0.1", client->host().c_str());
+    EXPECT_STREQ("muelsyse.test:8000", request->getHeader("host").c_str());
+    EXPECT_NO_THROW(muelsyse.restCallSync<Json::Value>("pinned", {}));
+    muelsyse.shutdown();
+}
+
+TEST(TlsTest, All)
+{
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    auto &trusted = config["function_list"][0];
+    trusted["name"] = "trusted";
+    trusted["url"] = "https://localhost:8443/test";
+    trusted["http_method"] = "post";
+    trusted["tls"]["ca_file"] = MUELSYSE_TEST_CERT_DIR "/cert.pem";
+    trusted["tls"]["ssl_conf"]["MinProtocol"] = "TLSv1.2";
+    // Shares the host, and therefore the settings, of trusted
+    auto &sibling = config["function_list"][1];
+    sibling["name"] = "sibling";
+    sibling["url"] = "https://localhost:8443/user/{user_id}";
+    sibling["http_method"] = "get";
+    auto &untrusted = config["function_list"][2];
+    untrusted["name"] = "untrusted";
+    untrusted["url"] = "https://127.0.0.1:8443/test";
+    untrusted["http_method"] = "post";
+    untrusted["tls"]["validate_cert"] = false;
+    muelsyse.initAndStart(config);
+
+    EXPECT_NO_THROW(muelsyse.restCallSync<void>("trusted", {}));
+    EXPECT_NO_THROW(muelsyse.restCallSync<void>("sibling", {"_", 1}));
+    EXPECT_NO_THROW(muelsyse.restCallSync<void>("untrusted", {}));
+    EXPECT_EQ(std::get<0>(muelsyse.prepare("trusted")),
+              std::get<0>(muelsyse.prepare("sibling", {"_", 1})));
+
+    // The connection is kept, later calls do not pay a handshake again
+    EXPECT_NO_THROW(muelsyse.restCallSync<void>("trusted", {}));
+    EXPECT_EQ(1, muelsyse.getStats("trusted")["connections"].asInt());
+
+    auto conflicting = config;
+    conflicting["function_list"][1]["tls"]["validate_cert"] = false;
+    EXPECT_THROW(muelsyse.reload(conflicting), std::invalid_argument);
+    auto plain = config;
+    plain["function_list"][1]["url"] = "http://localhost:8000/test";
+    plain["function_list"][1]["tls"]["validate_cert"] = false;
+    EXPECT_THROW(muelsyse.reload(plain), std::invalid_argument);
+}
+
+TEST(StreamTest, All)
+{
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["function_list"][0]["name"] = "export";
+    config["function_list"][0]["url"] = "http://localhost:8000/export?rows={}";
+    config["function_list"][0]["http_method"] = "get";
+    config["function_list"][1]["name"] = "secure";
+    config["function_list"][1]["url"] = "https://localhost:8443/test";
+    config["function_list"][1]["http_method"] = "post";
+    muelsyse.initAndStart(config);
+
+    tl::rest::StreamOptions options;
+    options.bufferSize = 1024;
+    int next = 0;
+    size_t largestChunk = 0;
+    auto visitor = tl::rest::jsonArraySink([&next](Json::Value &&user) {
+        EXPECT_EQ(next++, user["id"].asInt());
+        return true;
+    });
+    auto response = muelsyse.restCallStream(
+        "export",
+        {"_", 10000},
+        [&](std::string_view chunk) {
+            largestChunk = std::max(largestChunk, chunk.size());
+            return visitor(chunk);
+        },
+        options);
+    EXPECT_EQ(200, response.status);
+    EXPECT_TRUE(response.complete);
+    EXPECT_EQ(10000, next);
+    // The body never sits in memory as a whole
+    EXPECT_GT(response.bodyBytes, 100 * options.bufferSize);
+    EXPECT_LE(largestChunk, options.bufferSize);
+
+    // Stopping early
+    int seen = 0;
+    response = muelsyse.restCallStream(
+        "export", {"_", 10000}, tl::rest::jsonArraySink([&seen](auto &&) {
+            return ++seen < 10;
+        }));
+    EXPECT_FALSE(response.complete);
+    EXPECT_EQ(10, seen);
+
+    auto file = std::filesystem::temp_directory_path() / "muelsyse_export";
+    {
+        auto fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        response =
+            muelsyse.restCallStream("export", {"_", 100}, tl::rest::fdSink(fd));
+        close(fd);
+    }
+    EXPECT_EQ(response.bodyBytes, std::filesystem::file_size(file));
+    std::filesystem::remove(file);
+
+    EXPECT_THROW(muelsyse.restCallStream("secure", {}, tl::rest::fdSink(1)),
+                 std::invalid_argument);
+
+    // A body cut short is an error, not a shorter array
+    auto truncated = tl::rest::jsonArraySink([](auto &&) { return true; });
+    EXPECT_TRUE(truncated("[1, 2"));
+    EXPECT_THROW(truncated(""), std::runtime_error);
+}
+
 namespace test::sync
 {
 
@@ -224,11 +1669,84 @@ REST_FUNC_SYNC(User, getUserById, int id)
     REST_CALL_SYNC(User, PATH_PARAM(id));
 }
 
+REST_ROUTE(getDeclaredUser, Get, "http://localhost:8000/user/{id:int}");
+REST_FUNC_SYNC(User, getDeclaredUser, int id)
+{
+    REST_CALL_SYNC(User, PATH_PARAM(id));
+}
+
 TEST(SyncTest, Void)
 {
     EXPECT_NO_THROW(test("tanglong3bf"));
 }
 
+TEST(SyncTest, StaticRoute)
+{
+    static_assert(tl::rest::UrlTemplate("https://h:8/a/{x}").pathStart == 11);
+    static_assert(
+        tl::rest::UrlTemplate("h/{x}/{y:string}").placeholderCount == 2);
+
+    auto user = getDeclaredUser(1);
+    EXPECT_EQ(1, user.id);
+
+    // Only the host can be configured
+    std::string name = decltype(getDeclaredUser)::classTypeName();
+    MuelsyseTest muelsyse;
+    Json::Value config;
+    config["route_hosts"][name] = "http://127.0.0.1:8000";
+    muelsyse.initAndStart(config);
+    auto [client, request] = muelsyse.prepare(name, {"_", 1});
+    EXPECT_STREQ("127.0.0.1", client->host().c_str());
+    EXPECT_STREQ("/user/1", request->path().c_str());
+
+    config["function_list"][0]["name"] = name;
+    config["function_list"][0]["url"] = "http://localhost:8000/test";
+    config["function_list"][0]["http_method"] = "post";
+    EXPECT_THROW(muelsyse.reload(config), std::invalid_argument);
+}
+
+REST_ROUTE(getUserExpected, Get, "http://localhost:8000/user/{id:int}");
+REST_FUNC_EXPECTED(User, getUserExpected, int id)
+{
+    REST_CALL_EXPECTED(User, PATH_PARAM(id));
+}
+
+REST_ROUTE(missingExpected, Get, "http://localhost:8000/missing/{id}");
+REST_FUNC_EXPECTED(Json::Value, missingExpected, int id)
+{
+    REST_CALL_EXPECTED(Json::Value, PATH_PARAM(id));
+}
+
+REST_ROUTE(notJsonExpected, Post, "http://localhost:8000/test");
+REST_FUNC_EXPECTED(Json::Value, notJsonExpected)
+{
+    REST_CALL_EXPECTED(Json::Value);
+}
+
+TEST(SyncTest, Expected)
+{
+    using drogon::ReqResult;
+
+    auto user = getUserExpected(1);
+    ASSERT_TRUE(user.has_value());
+    EXPECT_EQ(1, user->id);
+
+    auto missing = missingExpected(1);
+    ASSERT_FALSE(missing);
+    EXPECT_EQ(ReqResult::Ok, missing.error().result);
+    EXPECT_EQ(404, missing.error().status);
+
+    auto notJson = notJsonExpected();
+    ASSERT_FALSE(notJson);
+    EXPECT_EQ(200, notJson.error().status);
+    EXPECT_FALSE(notJson.error().message.empty());
+
+    auto muelsyse = drogon::app().getPlugin<tl::rest::Muelsyse>();
+    auto unknown = muelsyse->restCallExpected<void>("inexistent", {});
+    ASSERT_FALSE(unknown);
+    EXPECT_EQ(ReqResult::BadServerAddress, unknown.error().result);
+}
+
 TEST(SyncTest, NotJson)
 {
     EXPECT_THROW(respIsNotJson(), std::runtime_error);
@@ -252,6 +1770,24 @@ TEST(SyncTest, SetByJson)
 
 }  // namespace test::sync
 
+namespace test::normal
+{
+
+// Normal functions are named by __FUNCTION__ and skip the route check
+test::sync::User getUserById(int id)
+{
+    REST_CALL_SYNC(test::sync::User, PATH_PARAM(id));
+}
+
+TEST(SyncTest, NormalFunction)
+{
+    auto user = getUserById(1);
+    EXPECT_EQ(1, user.id);
+    EXPECT_STREQ("tanglong3bf", user.username.c_str());
+}
+
+}  // namespace test::normal
+
 namespace test::async
 {
 
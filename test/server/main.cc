@@ -1,7 +1,310 @@
 #include <drogon/drogon.h>
+#include <netinet/in.h>
+#ifdef MUELSYSE_WITH_NGHTTP2
+#include <nghttp2/nghttp2.h>
+#include <openssl/ssl.h>
+#endif
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <thread>
 
 using namespace drogon;
 
+// drogon only listens on TCP, the unix socket tests go through this relay to
+// the plain listener
+static void relay(int client)
+{
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(8000);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+    {
+        pollfd fds[2]{{client, POLLIN, 0}, {server, POLLIN, 0}};
+        char buffer[16384];
+        bool open = true;
+        while (open && poll(fds, 2, -1) > 0)
+        {
+            for (int i = 0; i < 2 && open; ++i)
+            {
+                if (fds[i].revents != 0)
+                {
+                    auto n = read(fds[i].fd, buffer, sizeof(buffer));
+                    open = n > 0 && write(fds[1 - i].fd, buffer, n) == n;
+                }
+            }
+        }
+    }
+    close(server);
+    close(client);
+}
+
+static void listenUnix(const char* path)
+{
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(fd, 64) != 0)
+    {
+        LOG_FATAL << "failed to listen on " << path;
+        return;
+    }
+    std::thread([fd]() {
+        for (int client; (client = accept(fd, nullptr, nullptr)) >= 0;)
+        {
+            std::thread(relay, client).detach();
+        }
+    }).detach();
+}
+
+#ifdef MUELSYSE_WITH_NGHTTP2
+// drogon only speaks HTTP/1.1, the h2 tests call this server instead, as h2c
+// or as h2 over TLS. It answers every request with its method, path, content
+// type and body.
+struct Http2Exchange
+{
+    std::string method;
+    std::string path;
+    std::string contentType;
+    std::string body;
+    std::string response;
+    size_t sent{0};
+};
+
+struct Http2Peer
+{
+    int fd;
+    // nullptr for h2c
+    SSL* ssl;
+    std::map<int32_t, Http2Exchange> exchanges;
+};
+
+static ssize_t sendHttp2(nghttp2_session*,
+                         const uint8_t* data,
+                         size_t length,
+                         int,
+                         void* peer)
+{
+    auto& to = *static_cast<Http2Peer*>(peer);
+    auto n = to.ssl ? SSL_write(to.ssl, data, static_cast<int>(length))
+                    : write(to.fd, data, length);
+    return n <= 0 ? NGHTTP2_ERR_CALLBACK_FAILURE : n;
+}
+
+static int onHttp2Header(nghttp2_session*,
+                         const nghttp2_frame* frame,
+                         const uint8_t* name,
+                         size_t nameLength,
+                         const uint8_t* value,
+                         size_t valueLength,
+                         uint8_t,
+                         void* peer)
+{
+    auto& exchange =
+        static_cast<Http2Peer*>(peer)->exchanges[frame->hd.stream_id];
+    std::string_view field(reinterpret_cast<const char*>(name), nameLength);
+    std::string text(reinterpret_cast<const char*>(value), valueLength);
+    if (field == ":method")
+    {
+        exchange.method = std::move(text);
+    }
+    else if (field == ":path")
+    {
+        exchange.path = std::move(text);
+    }
+    else if (field == "content-type")
+    {
+        exchange.contentType = std::move(text);
+    }
+    return 0;
+}
+
+static int onHttp2Data(nghttp2_session*,
+                       uint8_t,
+                       int32_t id,
+                       const uint8_t* data,
+                       size_t length,
+                       void* peer)
+{
+    static_cast<Http2Peer*>(peer)->exchanges[id].body.append(
+        reinterpret_cast<const char*>(data), length);
+    return 0;
+}
+
+static ssize_t readHttp2Response(nghttp2_session*,
+                                 int32_t,
+                                 uint8_t* buffer,
+                                 size_t length,
+                                 uint32_t* flags,
+                                 nghttp2_data_source* source,
+                                 void*)
+{
+    auto& exchange = *static_cast<Http2Exchange*>(source->ptr);
+    auto size = std::min(length, exchange.response.size() - exchange.sent);
+    memcpy(buffer, exchange.response.data() + exchange.sent, size);
+    exchange.sent += size;
+    if (exchange.sent == exchange.response.size())
+    {
+        *flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return size;
+}
+
+static int onHttp2Frame(nghttp2_session* session,
+                        const nghttp2_frame* frame,
+                        void* peer)
+{
+    if ((frame->hd.type != NGHTTP2_HEADERS &&
+         frame->hd.type != NGHTTP2_DATA) ||
+        (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) == 0)
+    {
+        return 0;
+    }
+    auto& exchange =
+        static_cast<Http2Peer*>(peer)->exchanges[frame->hd.stream_id];
+    Json::Value json;
+    json["method"] = exchange.method;
+    json["path"] = exchange.path;
+    json["content_type"] = exchange.contentType;
+    json["body"] = exchange.body;
+    exchange.response = json.toStyledString();
+    nghttp2_nv headers[] = {
+        {(uint8_t*)":status", (uint8_t*)"200", 7, 3, NGHTTP2_NV_FLAG_NONE},
+        {(uint8_t*)"content-type",
+         (uint8_t*)"application/json",
+         12,
+         16,
+         NGHTTP2_NV_FLAG_NONE},
+    };
+    nghttp2_data_provider body;
+    body.source.ptr = &exchange;
+    body.read_callback = readHttp2Response;
+    nghttp2_submit_response(
+        session, frame->hd.stream_id, headers, std::size(headers), &body);
+    return 0;
+}
+
+static int onHttp2Close(nghttp2_session*, int32_t id, uint32_t, void* peer)
+{
+    static_cast<Http2Peer*>(peer)->exchanges.erase(id);
+    return 0;
+}
+
+static void serveHttp2(int client, SSL_CTX* context)
+{
+    Http2Peer peer{client, nullptr, {}};
+    if (context)
+    {
+        peer.ssl = SSL_new(context);
+        SSL_set_fd(peer.ssl, client);
+        if (SSL_accept(peer.ssl) != 1)
+        {
+            SSL_free(peer.ssl);
+            close(client);
+            return;
+        }
+    }
+    nghttp2_session_callbacks* callbacks;
+    nghttp2_session_callbacks_new(&callbacks);
+    nghttp2_session_callbacks_set_send_callback(callbacks, sendHttp2);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks,
+                                                     onHttp2Header);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks,
+                                                              onHttp2Data);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks,
+                                                         onHttp2Frame);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks,
+                                                           onHttp2Close);
+    nghttp2_session* session;
+    nghttp2_session_server_new(&session, callbacks, &peer);
+    nghttp2_session_callbacks_del(callbacks);
+    nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, nullptr, 0);
+    uint8_t buffer[16384];
+    auto receive = [&peer, &buffer]() -> ssize_t {
+        return peer.ssl ? SSL_read(peer.ssl, buffer, sizeof(buffer))
+                        : read(peer.fd, buffer, sizeof(buffer));
+    };
+    for (ssize_t n; nghttp2_session_send(session) == 0 &&
+                    (n = receive()) > 0 &&
+                    nghttp2_session_mem_recv(session, buffer, n) >= 0;)
+    {
+    }
+    nghttp2_session_del(session);
+    if (peer.ssl)
+    {
+        SSL_free(peer.ssl);
+    }
+    close(client);
+}
+
+// Offers h2 only, and hands out session tickets so clients can resume
+static SSL_CTX* newHttp2SslContext()
+{
+    auto context = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate_chain_file(context,
+                                       MUELSYSE_TEST_CERT_DIR "/cert.pem");
+    SSL_CTX_use_PrivateKey_file(context,
+                                MUELSYSE_TEST_CERT_DIR "/key.pem",
+                                SSL_FILETYPE_PEM);
+    SSL_CTX_set_alpn_select_cb(
+        context,
+        [](SSL*,
+           const unsigned char** out,
+           unsigned char* outLength,
+           const unsigned char* in,
+           unsigned inLength,
+           void*) {
+            for (unsigned i = 0; i < inLength; i += in[i] + 1)
+            {
+                if (in[i] == 2 && i + 3 <= inLength &&
+                    memcmp(in + i + 1, "h2", 2) == 0)
+                {
+                    *out = in + i + 1;
+                    *outLength = 2;
+                    return SSL_TLSEXT_ERR_OK;
+                }
+            }
+            return SSL_TLSEXT_ERR_ALERT_FATAL;
+        },
+        nullptr);
+    return context;
+}
+
+static void listenHttp2(uint16_t port, SSL_CTX* context = nullptr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(fd, 64) != 0)
+    {
+        LOG_FATAL << "failed to listen on " << port;
+        return;
+    }
+    std::thread([fd, context]() {
+        for (int client; (client = accept(fd, nullptr, nullptr)) >= 0;)
+        {
+            std::thread(serveHttp2, client, context).detach();
+        }
+    }).detach();
+}
+#endif
+
 int main(int argc, char* argv[])
 {
     app().registerHandler(
@@ -29,6 +332,117 @@ int main(int argc, char* argv[])
         },
         {Get});
 
+    app().registerHandler(
+        "/export?rows={rows}",
+        [](const HttpRequestPtr& req,
+           std::function<void(const HttpResponsePtr&)>&& callback,
+           int rows) {
+            Json::Value json(Json::arrayValue);
+            for (int i = 0; i < rows; ++i)
+            {
+                json[i]["id"] = i;
+                json[i]["username"] = "tanglong3bf";
+            }
+            callback(drogon::HttpResponse::newHttpJsonResponse(json));
+        },
+        {Get});
+
+    // Five users, size at a time, after the cursor
+    auto page = [](int size, const std::string& cursor) {
+        constexpr int kUsers = 5;
+        int first = cursor.empty() ? 0 : std::stoi(cursor);
+        int end = std::min(first + size, kUsers);
+        Json::Value json;
+        json["data"] = Json::Value(Json::arrayValue);
+        for (int i = first; i < end; ++i)
+        {
+            json["data"][i - first]["id"] = i;
+        }
+        json["meta"]["next_cursor"] =
+            end < kUsers ? Json::Value(std::to_string(end)) : Json::Value();
+        return drogon::HttpResponse::newHttpJsonResponse(json);
+    };
+    app().registerHandler(
+        "/users/page?size={size}&cursor={cursor}",
+        [page](const HttpRequestPtr& req,
+               std::function<void(const HttpResponsePtr&)>&& callback,
+               int size,
+               const std::string& cursor) { callback(page(size, cursor)); },
+        {Get});
+    app().registerHandler(
+        "/users/page",
+        [page](const HttpRequestPtr& req,
+               std::function<void(const HttpResponsePtr&)>&& callback) {
+            auto body = req->getJsonObject();
+            if (body == nullptr)
+            {
+                auto resp = HttpResponse::newHttpResponse();
+                resp->setStatusCode(k400BadRequest);
+                callback(resp);
+                return;
+            }
+            callback(page((*body)["size"].asInt(),
+                          (*body).get("cursor", "").asString()));
+        },
+        {Post});
+
+    app().registerHandler(
+        "/headers",
+        [](const HttpRequestPtr& req,
+           std::function<void(const HttpResponsePtr&)>&& callback) {
+            Json::Value json(Json::objectValue);
+            for (const auto& [field, value] : req->headers())
+            {
+                json[field] = value;
+            }
+            callback(drogon::HttpResponse::newHttpJsonResponse(json));
+        },
+        {Get});
+
+    app().registerHandler(
+        "/slow",
+        [](const HttpRequestPtr& req,
+           std::function<void(const HttpResponsePtr&)>&& callback) {
+            app().getLoop()->runAfter(1.0, [callback = std::move(callback)]() {
+                Json::Value json(Json::objectValue);
+                callback(drogon::HttpResponse::newHttpJsonResponse(json));
+            });
+        },
+        {Get});
+
+    // A stand-in OAuth token endpoint, each token is new and lives 2s
+    app().registerHandler(
+        "/token",
+        [](const HttpRequestPtr& req,
+           std::function<void(const HttpResponsePtr&)>&& callback) {
+            static std::atomic<int> issued{0};
+            auto body = req->getJsonObject();
+            if (body == nullptr || (*body)["client_id"] != "muelsyse")
+            {
+                auto resp = HttpResponse::newHttpResponse();
+                resp->setStatusCode(k401Unauthorized);
+                callback(resp);
+                return;
+            }
+            Json::Value json;
+            json["access_token"] = "token-" + std::to_string(++issued);
+            json["token_type"] = "Bearer";
+            json["expires_in"] = 2;
+            callback(drogon::HttpResponse::newHttpJsonResponse(json));
+        },
+        {Post});
+
     app().addListener("0.0.0.0", 8000);
+    // Self-signed, for the tls tests of the client
+    app().addListener("0.0.0.0",
+                      8443,
+                      true,
+                      MUELSYSE_TEST_CERT_DIR "/cert.pem",
+                      MUELSYSE_TEST_CERT_DIR "/key.pem");
+    listenUnix("/tmp/muelsyse-test.sock");
+#ifdef MUELSYSE_WITH_NGHTTP2
+    listenHttp2(8002);
+    listenHttp2(8444, newHttp2SslContext());
+#endif
     app().run();
 }